@@ -847,40 +847,27 @@ static int fsck_device(struct libmnt_fs *fs, int interactive)
 
 
 /*
- * Deal with the fsck -t argument.
+ * Deal with the fsck -t argument. The filesystem types and the "opts="
+ * items are compiled to libmount patterns, see mnt_new_pattern().
  */
-struct fs_type_compile {
-	char **list;
-	int *type;
-	int  negate;
-} fs_type_compiled;
+static struct libmnt_pattern *fs_type_pattern;
+static struct libmnt_pattern *fs_opts_pattern;
 
-#define FS_TYPE_NORMAL	0
-#define FS_TYPE_OPT	1
-#define FS_TYPE_NEGOPT	2
-
-static void compile_fs_type(char *fs_type, struct fs_type_compile *cmp)
+static void compile_fs_type(char *fs_type)
 {
-	char	*cp, *list, *s;
-	int	num = 2;
-	int	negate, first_negate = 1;
-
-	if (fs_type) {
-		for (cp=fs_type; *cp; cp++) {
-			if (*cp == ',')
-				num++;
-		}
-	}
-
-	cmp->list = xcalloc(num, sizeof(char *));
-	cmp->type = xcalloc(num, sizeof(int));
-	cmp->negate = 0;
+	char	*list, *s, *types, *opts;
+	int	negate, first_negate = 1, types_negate = 0;
+	size_t	sz;
 
 	if (!fs_type)
 		return;
 
+	/* "loop" -> "+loop", "!foo" -> "nofoo" */
+	sz = 2 * strlen(fs_type) + 3;
+	types = xcalloc(1, sz);
+	opts = xcalloc(1, sz);
+
 	list = xstrdup(fs_type);
-	num = 0;
 	s = strtok(list, ",");
 	while(s) {
 		negate = 0;
@@ -897,24 +884,39 @@ static void compile_fs_type(char *fs_type, struct fs_type_compile *cmp)
 		else if (strncmp(s, "opts=", 5) == 0) {
 			s += 5;
 		loop_special_case:
-			cmp->type[num] = negate ? FS_TYPE_NEGOPT : FS_TYPE_OPT;
+			/* "+" disables "no" prefix interpretation */
+			if (*opts)
+				strcat(opts, ",");
+			strcat(opts, negate ? "no" : "+");
+			strcat(opts, s);
 		} else {
 			if (first_negate) {
-				cmp->negate = negate;
+				types_negate = negate;
 				first_negate = 0;
 			}
-			if ((negate && !cmp->negate) ||
-			    (!negate && cmp->negate)) {
+			if ((negate && !types_negate) ||
+			    (!negate && types_negate)) {
 				errx(FSCK_EX_USAGE,
 					_("Either all or none of the filesystem types passed to -t must be prefixed\n"
 					  "with 'no' or '!'."));
 			}
+			/* the global "no" prefix negates the whole list */
+			if (!*types && types_negate)
+				strcat(types, "no");
+			else if (*types)
+				strcat(types, ",");
+			strcat(types, s);
 		}
-
-		cmp->list[num++] = xstrdup(s);
 		s = strtok(NULL, ",");
 	}
 	free(list);
+
+	if (*types && !(fs_type_pattern = mnt_new_pattern(MNT_PATTERN_FSTYPE, types)))
+		err(FSCK_EX_ERROR, _("failed to compile -t pattern"));
+	if (*opts && !(fs_opts_pattern = mnt_new_pattern(MNT_PATTERN_OPTIONS, opts)))
+		err(FSCK_EX_ERROR, _("failed to compile -t pattern"));
+	free(types);
+	free(opts);
 }
 
 /*
@@ -942,38 +944,13 @@ static int opt_in_list(const char *opt, const char *optlist)
 }
 
 /* See if the filesystem matches the criteria given by the -t option */
-static int fs_match(struct libmnt_fs *fs, struct fs_type_compile *cmp)
+static int fs_match(struct libmnt_fs *fs)
 {
-	int n, ret = 0, checked_type = 0;
-	char *cp;
-
-	if (cmp->list == 0 || cmp->list[0] == 0)
-		return 1;
-
-	for (n=0; (cp = cmp->list[n]); n++) {
-		switch (cmp->type[n]) {
-		case FS_TYPE_NORMAL:
-		{
-			const char *type = mnt_fs_get_fstype(fs);
-
-			checked_type++;
-			if (type && strcmp(cp, type) == 0)
-				ret = 1;
-			break;
-		}
-		case FS_TYPE_NEGOPT:
-			if (opt_in_list(cp, mnt_fs_get_options(fs)))
-				return 0;
-			break;
-		case FS_TYPE_OPT:
-			if (!opt_in_list(cp, mnt_fs_get_options(fs)))
-				return 0;
-			break;
-		}
-	}
-	if (checked_type == 0)
-		return 1;
-	return (cmp->negate ? !ret : ret);
+	if (fs_opts_pattern && !mnt_fs_match_pattern(fs, fs_opts_pattern))
+		return 0;
+	if (fs_type_pattern && !mnt_fs_match_pattern(fs, fs_type_pattern))
+		return 0;
+	return 1;
 }
 
 /*
@@ -1051,7 +1028,7 @@ static int ignore(struct libmnt_fs *fs)
 	 * If a specific fstype is specified, and it doesn't match,
 	 * ignore it.
 	 */
-	if (!fs_match(fs, &fs_type_compiled))
+	if (!fs_match(fs))
 		return 1;
 
 	type = mnt_fs_get_fstype(fs);
@@ -1453,7 +1430,7 @@ static void parse_argv(int argc, char *argv[])
 				else
 					usage();
 				fstype = xstrdup(tmp);
-				compile_fs_type(fstype, &fs_type_compiled);
+				compile_fs_type(fstype);
 				goto next_arg;
 			case '-':
 				opts_for_fsck++;
@@ -28,5 +28,8 @@ extern FILE *fopen_at(int dir, const char *dirname, const char *filename,
 extern ssize_t readlink_at(int dir, const char *dirname, const char *pathname,
                     char *buf, size_t bufsiz);
 
+extern ssize_t read_attr_at(int dir, const char *dirname, const char *filename,
+		    char *buf, size_t bufsiz);
+
 
 #endif /* UTIL_LINUX_AT_H */
@@ -15,3 +15,16 @@ extern cpu_set_t *path_cpuset(int, const char *path, ...)
 extern cpu_set_t *path_cpulist(int, const char *path, ...)
 			       __attribute__ ((__format__ (__printf__, 2, 3)));
 extern void path_setprefix(const char *);
+
+extern int path_opendir(const char *path, ...)
+		      __attribute__ ((__format__ (__printf__, 1, 2)));
+extern ssize_t path_read_at(int dir, char *buf, size_t len, const char *attr, ...)
+			    __attribute__ ((__format__ (__printf__, 4, 5)));
+extern int path_exist_at(int dir, const char *attr, ...)
+			 __attribute__ ((__format__ (__printf__, 2, 3)));
+extern void path_getstr_at(char *result, size_t len, int dir, const char *attr, ...)
+			   __attribute__ ((__format__ (__printf__, 4, 5)));
+extern int path_getnum_at(int dir, const char *attr, ...)
+			  __attribute__ ((__format__ (__printf__, 2, 3)));
+extern cpu_set_t *path_cpuset_at(int, int dir, const char *attr, ...)
+				 __attribute__ ((__format__ (__printf__, 3, 4)));
@@ -16,6 +16,14 @@
 #include <inttypes.h>
 #include <dirent.h>
 
+/* memoized attribute, see sysfs_set_memoize() */
+struct sysfs_attr {
+	struct sysfs_attr *next;
+	char	*value;		/* NULL if read failed */
+	int	errsv;		/* errno of the failed read */
+	char	name[];
+};
+
 struct sysfs_cxt {
 	dev_t	devno;
 	int	dir_fd;		/* /sys/block/<name> */
@@ -27,7 +35,10 @@ struct sysfs_cxt {
 			scsi_target,
 			scsi_lun;
 
-	unsigned int	has_hctl : 1;
+	struct sysfs_attr *attrs;	/* memoized attributes */
+
+	unsigned int	has_hctl : 1,
+			memoize : 1;
 };
 
 #define UL_SYSFSCXT_EMPTY { 0, -1, NULL, NULL }
@@ -42,6 +53,7 @@ extern dev_t sysfs_devname_to_devno(const char *name, const char *parent);
 extern int sysfs_init(struct sysfs_cxt *cxt, dev_t devno, struct sysfs_cxt *parent)
 					__attribute__ ((warn_unused_result));
 extern void sysfs_deinit(struct sysfs_cxt *cxt);
+extern void sysfs_set_memoize(struct sysfs_cxt *cxt, int enable);
 
 extern DIR *sysfs_opendir(struct sysfs_cxt *cxt, const char *attr);
 
@@ -49,6 +61,8 @@ extern int sysfs_stat(struct sysfs_cxt *cxt, const char *attr, struct stat *st);
 extern ssize_t sysfs_readlink(struct sysfs_cxt *cxt, const char *attr,
 	                   char *buf, size_t bufsiz);
 extern int sysfs_has_attribute(struct sysfs_cxt *cxt, const char *attr);
+extern ssize_t sysfs_read_attr(struct sysfs_cxt *cxt, const char *attr,
+			       char *buf, size_t bufsz);
 
 extern int sysfs_scanf(struct sysfs_cxt *cxt,  const char *attr,
 		       const char *fmt, ...)
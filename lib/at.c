@@ -6,6 +6,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <fcntl.h>
+#include <errno.h>
 #include <sys/stat.h>
 
 #include "at.h"
@@ -96,6 +97,56 @@ ssize_t readlink_at(int dir, const char *dirname, const char *pathname,
 }
 #endif
 
+/*
+ * Reads whole small file (e.g. sysfs or procfs attribute) into @buf by
+ * read() without stdio. The result is terminated by zero and the trailing
+ * newline is removed. Returns the size of the result or -1 on error.
+ */
+ssize_t read_attr_at(int dir, const char *dirname, const char *filename,
+		     char *buf, size_t bufsiz)
+{
+	ssize_t sz = 0, ret;
+	int fd, errsv;
+
+	if (!bufsiz) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	fd = open_at(dir, dirname, filename, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -1;
+
+	while ((size_t) sz < bufsiz - 1) {
+		size_t count = bufsiz - 1 - sz;
+
+		ret = read(fd, buf + sz, count);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret < 0)
+			sz = -1;
+		if (ret <= 0)
+			break;
+		sz += ret;
+
+		/* sysfs and procfs return whole attribute by the first
+		 * read(), don't waste another syscall to get EOF */
+		if ((size_t) ret < count)
+			break;
+	}
+	errsv = errno;
+	close(fd);
+	errno = errsv;
+
+	if (sz < 0)
+		return -1;
+
+	buf[sz] = '\0';
+	if (sz && buf[sz - 1] == '\n')
+		buf[--sz] = '\0';
+	return sz;
+}
+
 #ifdef TEST_PROGRAM_AT
 #include <errno.h>
 #include <sys/types.h>
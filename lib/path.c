@@ -26,8 +26,10 @@
 #include <unistd.h>
 #include <stdio.h>
 #include <errno.h>
+#include <fcntl.h>
 
 #include "all-io.h"
+#include "at.h"
 #include "cpuset.h"
 #include "path.h"
 #include "nls.h"
@@ -84,44 +86,72 @@ path_fopen(const char *mode, int exit_on_error, const char *path, ...)
 	return fd;
 }
 
+/*
+ * Reads the file to @buf, exits on error.
+ */
+static void
+path_vread(char *buf, size_t len, const char *path, va_list ap)
+{
+	const char *p = path_vcreate(path, ap);
+
+	if (read_attr_at(AT_FDCWD, NULL, p, buf, len) < 0)
+		err(EXIT_FAILURE, _("failed to read: %s"), p);
+}
+
+static int
+path_parse_int(const char *buf, const char *name)
+{
+	char *end = NULL;
+	long num;
+
+	errno = 0;
+	num = strtol(buf, &end, 10);
+	if (errno || end == buf || num < INT_MIN || num > INT_MAX)
+		errx(EXIT_FAILURE, _("parse error: %s"), name);
+	return num;
+}
+
+static cpu_set_t *
+path_parse_cpuset(int maxcpus, int islist, const char *buf)
+{
+	cpu_set_t *set;
+	size_t setsize;
+
+	set = cpuset_alloc(maxcpus, &setsize, NULL);
+	if (!set)
+		err(EXIT_FAILURE, _("failed to callocate cpu set"));
+
+	if (islist) {
+		if (cpulist_parse(buf, set, setsize, 0))
+			errx(EXIT_FAILURE, _("failed to parse CPU list %s"), buf);
+	} else {
+		if (cpumask_parse(buf, set, setsize))
+			errx(EXIT_FAILURE, _("failed to parse CPU mask %s"), buf);
+	}
+	return set;
+}
+
 void
 path_getstr(char *result, size_t len, const char *path, ...)
 {
-	FILE *fd;
 	va_list ap;
 
 	va_start(ap, path);
-	fd = path_vfopen("r", 1, path, ap);
+	path_vread(result, len, path, ap);
 	va_end(ap);
-
-	if (!fgets(result, len, fd))
-		err(EXIT_FAILURE, _("failed to read: %s"), pathbuf);
-	fclose(fd);
-
-	len = strlen(result);
-	if (result[len - 1] == '\n')
-		result[len - 1] = '\0';
 }
 
 int
 path_getnum(const char *path, ...)
 {
-	FILE *fd;
+	char buf[64];
 	va_list ap;
-	int result;
 
 	va_start(ap, path);
-	fd = path_vfopen("r", 1, path, ap);
+	path_vread(buf, sizeof(buf), path, ap);
 	va_end(ap);
 
-	if (fscanf(fd, "%d", &result) != 1) {
-		if (ferror(fd))
-			err(EXIT_FAILURE, _("failed to read: %s"), pathbuf);
-		else
-			errx(EXIT_FAILURE, _("parse error: %s"), pathbuf);
-	}
-	fclose(fd);
-	return result;
+	return path_parse_int(buf, pathbuf);
 }
 
 int
@@ -154,33 +184,11 @@ path_exist(const char *path, ...)
 static cpu_set_t *
 path_cpuparse(int maxcpus, int islist, const char *path, va_list ap)
 {
-	FILE *fd;
-	cpu_set_t *set;
-	size_t setsize, len = maxcpus * 7;
+	size_t len = maxcpus * 7;
 	char buf[len];
 
-	fd = path_vfopen("r", 1, path, ap);
-
-	if (!fgets(buf, len, fd))
-		err(EXIT_FAILURE, _("failed to read: %s"), pathbuf);
-	fclose(fd);
-
-	len = strlen(buf);
-	if (buf[len - 1] == '\n')
-		buf[len - 1] = '\0';
-
-	set = cpuset_alloc(maxcpus, &setsize, NULL);
-	if (!set)
-		err(EXIT_FAILURE, _("failed to callocate cpu set"));
-
-	if (islist) {
-		if (cpulist_parse(buf, set, setsize, 0))
-			errx(EXIT_FAILURE, _("failed to parse CPU list %s"), buf);
-	} else {
-		if (cpumask_parse(buf, set, setsize))
-			errx(EXIT_FAILURE, _("failed to parse CPU mask %s"), buf);
-	}
-	return set;
+	path_vread(buf, len, path, ap);
+	return path_parse_cpuset(maxcpus, islist, buf);
 }
 
 cpu_set_t *
@@ -209,6 +217,136 @@ path_cpulist(int maxcpus, const char *path, ...)
 	return set;
 }
 
+/*
+ * Directory based API -- the directory (relative to the prefix) is opened
+ * only once and the attributes are read by openat() and read() into the
+ * caller's buffers.
+ */
+int
+path_opendir(const char *path, ...)
+{
+	va_list ap;
+	const char *p;
+
+	va_start(ap, path);
+	p = path_vcreate(path, ap);
+	va_end(ap);
+
+	return open(p, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+}
+
+/* for error messages only */
+static const char *
+path_at_name(char *buf, size_t bufsz, int dir, const char *attr)
+{
+	char link[sizeof("/proc/self/fd/") + 11];
+	ssize_t sz;
+
+	snprintf(link, sizeof(link), "/proc/self/fd/%d", dir);
+	sz = readlink(link, buf, bufsz - 1);
+	if (sz < 0)
+		sz = 0;
+	snprintf(buf + sz, bufsz - sz, "%s%s", sz ? "/" : "", attr);
+	return buf;
+}
+
+static ssize_t
+path_vread_at(int dir, char *buf, size_t len, const char *attr, va_list ap)
+{
+	char name[PATH_MAX];
+
+	vsnprintf(name, sizeof(name), attr, ap);
+
+	/* the directory API is openat() based, so no dirname */
+	return read_attr_at(dir, NULL, name, buf, len);
+}
+
+/* like path_vread_at(), but exits on error */
+static void
+path_vread_at_or_err(int dir, char *buf, size_t len, char *name, size_t namesz,
+		     const char *attr, va_list ap)
+{
+	va_list cp;
+
+	va_copy(cp, ap);
+	vsnprintf(name, namesz, attr, cp);
+	va_end(cp);
+
+	if (path_vread_at(dir, buf, len, attr, ap) < 0) {
+		char x[PATH_MAX];
+		err(EXIT_FAILURE, _("failed to read: %s"),
+				path_at_name(x, sizeof(x), dir, name));
+	}
+}
+
+/*
+ * Reads @attr from @dir to @buf, the trailing newline is removed. Returns
+ * the size of the string or -1 on error.
+ */
+ssize_t
+path_read_at(int dir, char *buf, size_t len, const char *attr, ...)
+{
+	va_list ap;
+	ssize_t sz;
+
+	va_start(ap, attr);
+	sz = path_vread_at(dir, buf, len, attr, ap);
+	va_end(ap);
+
+	return sz;
+}
+
+int
+path_exist_at(int dir, const char *attr, ...)
+{
+	char name[PATH_MAX];
+	va_list ap;
+
+	va_start(ap, attr);
+	vsnprintf(name, sizeof(name), attr, ap);
+	va_end(ap);
+
+	return faccessat(dir, name, F_OK, 0) == 0;
+}
+
+void
+path_getstr_at(char *result, size_t len, int dir, const char *attr, ...)
+{
+	char name[PATH_MAX];
+	va_list ap;
+
+	va_start(ap, attr);
+	path_vread_at_or_err(dir, result, len, name, sizeof(name), attr, ap);
+	va_end(ap);
+}
+
+int
+path_getnum_at(int dir, const char *attr, ...)
+{
+	char buf[64], name[PATH_MAX];
+	va_list ap;
+
+	va_start(ap, attr);
+	path_vread_at_or_err(dir, buf, sizeof(buf), name, sizeof(name), attr, ap);
+	va_end(ap);
+
+	return path_parse_int(buf, name);
+}
+
+cpu_set_t *
+path_cpuset_at(int maxcpus, int dir, const char *attr, ...)
+{
+	size_t len = maxcpus * 7;
+	char buf[len], name[PATH_MAX];
+	va_list ap;
+
+	va_start(ap, attr);
+	path_vread_at_or_err(dir, buf, len, name, sizeof(name), attr, ap);
+	va_end(ap);
+
+	return path_parse_cpuset(maxcpus, 0, buf);
+}
+
 void
 path_setprefix(const char *prefix)
 {
@@ -6,6 +6,7 @@
 
 #include "c.h"
 #include "at.h"
+#include "strutils.h"
 #include "pathnames.h"
 #include "sysfs.h"
 
@@ -83,16 +84,14 @@ dev_t sysfs_devname_to_devno(const char *name, const char *parent)
 		/*
 		 * read devno from sysfs
 		 */
-		FILE *f;
+		char num[64];
 		int maj = 0, min = 0;
 
-		f = fopen(path, "r");
-		if (!f)
+		if (read_attr_at(AT_FDCWD, NULL, path, num, sizeof(num)) < 0)
 			return 0;
 
-		if (fscanf(f, "%d:%d", &maj, &min) == 2)
+		if (sscanf(num, "%d:%d", &maj, &min) == 2)
 			dev = makedev(maj, min);
-		fclose(f);
 	}
 	return dev;
 }
@@ -164,6 +163,28 @@ err:
 	return rc;
 }
 
+/*
+ * Enables (or disables) memoization of the attributes read by
+ * sysfs_read_attr(). It's useful for contexts used as parent for many
+ * others (e.g. whole-disk with partitions), the queue/ attributes are
+ * then read only once.
+ */
+void sysfs_set_memoize(struct sysfs_cxt *cxt, int enable)
+{
+	cxt->memoize = enable ? 1 : 0;
+}
+
+static void sysfs_free_attrs(struct sysfs_cxt *cxt)
+{
+	while (cxt->attrs) {
+		struct sysfs_attr *a = cxt->attrs;
+
+		cxt->attrs = a->next;
+		free(a->value);
+		free(a);
+	}
+}
+
 void sysfs_deinit(struct sysfs_cxt *cxt)
 {
 	if (!cxt)
@@ -172,6 +193,7 @@ void sysfs_deinit(struct sysfs_cxt *cxt)
 	if (cxt->dir_fd >= 0)
 	       close(cxt->dir_fd);
 	free(cxt->dir_path);
+	sysfs_free_attrs(cxt);
 
 	memset(cxt, 0, sizeof(*cxt));
 
@@ -211,11 +233,87 @@ static int sysfs_open(struct sysfs_cxt *cxt, const char *attr)
 		/* Exception for "queue/<attr>". These attributes are available
 		 * for parental devices only
 		 */
-		fd = open_at(cxt->parent->dir_fd, cxt->dir_path, attr, O_RDONLY);
+		fd = open_at(cxt->parent->dir_fd, cxt->parent->dir_path,
+				attr, O_RDONLY);
 	}
 	return fd;
 }
 
+static struct sysfs_attr *sysfs_find_attr(struct sysfs_cxt *cxt,
+					  const char *attr)
+{
+	struct sysfs_attr *a;
+
+	for (a = cxt->attrs; a; a = a->next) {
+		if (strcmp(a->name, attr) == 0)
+			return a;
+	}
+	return NULL;
+}
+
+static void sysfs_add_attr(struct sysfs_cxt *cxt, const char *attr,
+			   const char *value, int errsv)
+{
+	size_t namesz = strlen(attr) + 1;
+	struct sysfs_attr *a = malloc(sizeof(*a) + namesz);
+
+	if (!a)
+		return;
+	a->value = value ? strdup(value) : NULL;
+	if (value && !a->value) {
+		free(a);
+		return;
+	}
+	a->errsv = errsv;
+	memcpy(a->name, attr, namesz);
+	a->next = cxt->attrs;
+	cxt->attrs = a;
+}
+
+/*
+ * Reads @attr to @buf by openat() and read(), the trailing newline is
+ * removed. Returns the size of the result or -1 on error (errno is set).
+ */
+ssize_t sysfs_read_attr(struct sysfs_cxt *cxt, const char *attr,
+			char *buf, size_t bufsz)
+{
+	ssize_t sz;
+
+	if (!bufsz) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (cxt->memoize) {
+		struct sysfs_attr *a = sysfs_find_attr(cxt, attr);
+
+		if (a && !a->value) {
+			errno = a->errsv;
+			return -1;
+		}
+		if (a) {
+			xstrncpy(buf, a->value, bufsz);
+			return strlen(buf);
+		}
+	}
+
+	sz = read_attr_at(cxt->dir_fd, cxt->dir_path, attr, buf, bufsz);
+
+	if (sz < 0 && errno == ENOENT &&
+	    strncmp(attr, "queue/", 6) == 0 && cxt->parent) {
+
+		/* Exception for "queue/<attr>", see sysfs_open() */
+		sz = sysfs_read_attr(cxt->parent, attr, buf, bufsz);
+	}
+
+	if (cxt->memoize) {
+		int errsv = errno;
+
+		sysfs_add_attr(cxt, attr, sz < 0 ? NULL : buf, errsv);
+		errno = errsv;
+	}
+	return sz;
+}
+
 ssize_t sysfs_readlink(struct sysfs_cxt *cxt, const char *attr,
 		   char *buf, size_t bufsiz)
 {
@@ -258,14 +356,6 @@ DIR *sysfs_opendir(struct sysfs_cxt *cxt, const char *attr)
 }
 
 
-static FILE *sysfs_fopen(struct sysfs_cxt *cxt, const char *attr)
-{
-	int fd = sysfs_open(cxt, attr);
-
-	return fd < 0 ? NULL : fdopen(fd, "r");
-}
-
-
 static struct dirent *xreaddir(DIR *dp)
 {
 	struct dirent *d;
@@ -363,26 +453,42 @@ dev_t sysfs_partno_to_devno(struct sysfs_cxt *cxt, int partno)
 
 int sysfs_scanf(struct sysfs_cxt *cxt,  const char *attr, const char *fmt, ...)
 {
-	FILE *f = sysfs_fopen(cxt, attr);
+	char buf[BUFSIZ];
 	va_list ap;
 	int rc;
 
-	if (!f)
+	if (sysfs_read_attr(cxt, attr, buf, sizeof(buf)) < 0)
 		return -EINVAL;
 	va_start(ap, fmt);
-	rc = vfscanf(f, fmt, ap);
+	rc = vsscanf(buf, fmt, ap);
 	va_end(ap);
 
-	fclose(f);
 	return rc;
 }
 
+/* strto{ll,ull}() based replacement for "%d" and "%u" scanf() conversions */
+static int sysfs_read_number(struct sysfs_cxt *cxt, const char *attr,
+			     int64_t *s, uint64_t *u)
+{
+	char buf[64], *end = NULL;
+
+	if (sysfs_read_attr(cxt, attr, buf, sizeof(buf)) < 0)
+		return -1;
+
+	errno = 0;
+	if (s)
+		*s = strtoll(buf, &end, 10);
+	else
+		*u = strtoull(buf, &end, 10);
+
+	return errno || end == buf ? -1 : 0;
+}
 
 int sysfs_read_s64(struct sysfs_cxt *cxt, const char *attr, int64_t *res)
 {
 	int64_t x = 0;
 
-	if (sysfs_scanf(cxt, attr, "%"SCNd64, &x) == 1) {
+	if (sysfs_read_number(cxt, attr, &x, NULL) == 0) {
 		if (res)
 			*res = x;
 		return 0;
@@ -394,7 +500,7 @@ int sysfs_read_u64(struct sysfs_cxt *cxt, const char *attr, uint64_t *res)
 {
 	uint64_t x = 0;
 
-	if (sysfs_scanf(cxt, attr, "%"SCNu64, &x) == 1) {
+	if (sysfs_read_number(cxt, attr, NULL, &x) == 0) {
 		if (res)
 			*res = x;
 		return 0;
@@ -404,9 +510,10 @@ int sysfs_read_u64(struct sysfs_cxt *cxt, const char *attr, uint64_t *res)
 
 int sysfs_read_int(struct sysfs_cxt *cxt, const char *attr, int *res)
 {
-	int x = 0;
+	int64_t x = 0;
 
-	if (sysfs_scanf(cxt, attr, "%d", &x) == 1) {
+	if (sysfs_read_number(cxt, attr, &x, NULL) == 0 &&
+	    x >= INT_MIN && x <= INT_MAX) {
 		if (res)
 			*res = x;
 		return 0;
@@ -414,11 +521,20 @@ int sysfs_read_int(struct sysfs_cxt *cxt, const char *attr, int *res)
 	return -1;
 }
 
+/* returns the first line of the attribute */
+static char *strdup_first_line(char *buf)
+{
+	buf[strcspn(buf, "\n")] = '\0';
+	return *buf ? strdup(buf) : NULL;
+}
+
 char *sysfs_strdup(struct sysfs_cxt *cxt, const char *attr)
 {
 	char buf[1024];
-	return sysfs_scanf(cxt, attr, "%1023[^\n]", buf) == 1 ?
-						strdup(buf) : NULL;
+
+	if (sysfs_read_attr(cxt, attr, buf, sizeof(buf)) < 0)
+		return NULL;
+	return strdup_first_line(buf);
 }
 
 int sysfs_count_dirents(struct sysfs_cxt *cxt, const char *attr)
@@ -695,21 +811,16 @@ static char *sysfs_scsi_host_attribute_path(struct sysfs_cxt *cxt,
 char *sysfs_scsi_host_strdup_attribute(struct sysfs_cxt *cxt,
 		const char *type, const char *attr)
 {
-	char buf[1024];
-	int rc;
-	FILE *f;
+	char path[PATH_MAX], buf[1024];
 
 	if (!attr || !type ||
-	    !sysfs_scsi_host_attribute_path(cxt, type, buf, sizeof(buf), attr))
+	    !sysfs_scsi_host_attribute_path(cxt, type, path, sizeof(path), attr))
 		return NULL;
 
-	if (!(f = fopen(buf, "r")))
-                return NULL;
-
-	rc = fscanf(f, "%1023[^\n]", buf);
-	fclose(f);
+	if (read_attr_at(AT_FDCWD, NULL, path, buf, sizeof(buf)) < 0)
+		return NULL;
 
-	return rc == 1 ? strdup(buf) : NULL;
+	return strdup_first_line(buf);
 }
 
 int sysfs_scsi_host_is(struct sysfs_cxt *cxt, const char *type)
@@ -776,6 +887,72 @@ int sysfs_scsi_path_contains(struct sysfs_cxt *cxt, const char *pattern)
 #include <errno.h>
 #include <err.h>
 #include <stdlib.h>
+#include <sys/time.h>
+
+static const char *bench_attrs[] = {
+	"size", "ro", "removable", "alignment_offset", "queue/rotational",
+	"queue/hw_sector_size", "queue/logical_block_size",
+	"queue/minimum_io_size", "queue/optimal_io_size",
+	"queue/discard_granularity", "queue/read_ahead_kb"
+};
+
+/* number of read syscalls, see Documentation/filesystems/proc.txt */
+static uint64_t get_syscr(void)
+{
+	char buf[BUFSIZ], *p;
+
+	if (read_attr_at(AT_FDCWD, NULL, "/proc/self/io", buf, sizeof(buf)) < 0)
+		return 0;
+	p = strstr(buf, "syscr:");
+	return p ? strtoull(p + 6, NULL, 10) : 0;
+}
+
+/* the way how sysfs_scanf() used to read attributes */
+static int stdio_read_int(struct sysfs_cxt *cxt, const char *attr, int64_t *x)
+{
+	int fd = open_at(cxt->dir_fd, cxt->dir_path, attr, O_RDONLY);
+	FILE *f;
+	int rc;
+
+	if (fd < 0 && errno == ENOENT && cxt->parent)
+		fd = open_at(cxt->parent->dir_fd, cxt->parent->dir_path,
+				attr, O_RDONLY);
+	if (fd < 0 || !(f = fdopen(fd, "r")))
+		return -1;
+	rc = fscanf(f, "%"SCNd64, x);
+	fclose(f);
+	return rc == 1 ? 0 : -1;
+}
+
+static void bench(struct sysfs_cxt *cxt, int loops, int method)
+{
+	static const char *names[] = { "stdio", "read", "memoize" };
+	struct timeval start, end;
+	uint64_t syscr = get_syscr();
+	int64_t x = 0, sum = 0;
+	size_t i;
+	int n;
+
+	sysfs_set_memoize(cxt, method == 2);
+	gettimeofday(&start, NULL);
+
+	for (n = 0; n < loops; n++) {
+		for (i = 0; i < ARRAY_SIZE(bench_attrs); i++) {
+			int rc = method == 0 ?
+				stdio_read_int(cxt, bench_attrs[i], &x) :
+				sysfs_read_s64(cxt, bench_attrs[i], &x);
+			if (rc == 0)
+				sum += x;
+		}
+	}
+
+	gettimeofday(&end, NULL);
+	/* don't count read() of /proc/self/io itself */
+	printf("%-8s %8d loops: %10ju read() calls, %8.3f sec (sum=%jd)\n",
+		names[method], loops, (uintmax_t) (get_syscr() - syscr - 1),
+		(end.tv_sec - start.tv_sec) +
+		(end.tv_usec - start.tv_usec) / 1000000.0, (intmax_t) sum);
+}
 
 int main(int argc, char *argv[])
 {
@@ -783,12 +960,14 @@ int main(int argc, char *argv[])
 	char *devname;
 	dev_t devno;
 	char path[PATH_MAX];
-	int i, is_part;
+	int i, is_part, loops = 0;
 	uint64_t u64;
 	ssize_t len;
 
-	if (argc != 2)
-		errx(EXIT_FAILURE, "usage: %s <devname>", argv[0]);
+	if (argc != 2 && argc != 3)
+		errx(EXIT_FAILURE, "usage: %s <devname> [<loops>]", argv[0]);
+	if (argc == 3)
+		loops = atoi(argv[2]);
 
 	devname = argv[1];
 	devno = sysfs_devname_to_devno(devname, NULL);
@@ -836,6 +1015,11 @@ int main(int argc, char *argv[])
 
 	printf("DEVNAME: %s\n", sysfs_get_devname(&cxt, path, sizeof(path)));
 
+	if (loops > 0) {
+		for (i = 0; i < 3; i++)
+			bench(&cxt, loops, i);
+	}
+
 	sysfs_deinit(&cxt);
 	return EXIT_SUCCESS;
 }
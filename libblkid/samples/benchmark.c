@@ -0,0 +1,273 @@
+/*
+ * This file may be redistributed under the terms of the
+ * GNU Lesser General Public License.
+ *
+ * Probes the given devices or images more times and reports time and I/O
+ * statistics, optionally compares the number of read() calls and bytes with
+ * a baseline file. The baseline file contains lines
+ *
+ *	<name> <reads> <bytes>
+ *
+ * where <name> is the image basename without ".img" suffix; see --raw. All
+ * the images have to be in the baseline and all the baseline names have to
+ * match an image, otherwise the baseline is out of date. The number of reads
+ * has to be the same for all iterations.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+
+#include <blkid.h>
+
+#include "c.h"
+
+struct bench_result {
+	char		*name;
+	uint64_t	reads;		/* per probing */
+	uint64_t	bytes;		/* per probing */
+	uint64_t	hits;		/* per probing */
+	uint64_t	usec;		/* all iterations */
+	int		unstable;	/* I/O differs between iterations */
+	int		matched;	/* found in the baseline */
+};
+
+static uint64_t now_usec(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (uint64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static char *image_name(const char *path)
+{
+	const char *p = strrchr(path, '/');
+	char *name, *sfx;
+
+	name = strdup(p ? p + 1 : path);
+	if (!name)
+		err(EXIT_FAILURE, "cannot allocate image name");
+	sfx = strstr(name, ".img");
+	if (sfx && *(sfx + 4) == '\0')
+		*sfx = '\0';
+	return name;
+}
+
+static int probe_once(const char *devname, uint64_t *reads,
+		      uint64_t *bytes, uint64_t *hits)
+{
+	blkid_probe pr;
+	int rc;
+
+	pr = blkid_new_probe_from_filename(devname);
+	if (!pr)
+		err(EXIT_FAILURE, "%s: failed to create a new libblkid probe",
+				devname);
+
+	/* the same setting as "blkid -p" */
+	blkid_probe_enable_superblocks(pr, TRUE);
+	blkid_probe_set_superblocks_flags(pr,
+			BLKID_SUBLKS_LABEL | BLKID_SUBLKS_LABELRAW |
+			BLKID_SUBLKS_UUID | BLKID_SUBLKS_UUIDRAW |
+			BLKID_SUBLKS_TYPE | BLKID_SUBLKS_SECTYPE |
+			BLKID_SUBLKS_USAGE | BLKID_SUBLKS_VERSION |
+			BLKID_SUBLKS_MAGIC);
+	blkid_probe_enable_partitions(pr, TRUE);
+	blkid_probe_set_partitions_flags(pr, BLKID_PARTS_ENTRY_DETAILS);
+
+	rc = blkid_do_safeprobe(pr);
+	blkid_probe_get_iostats(pr, reads, bytes, hits);
+	blkid_free_probe(pr);
+
+	return rc;
+}
+
+static void bench_image(const char *devname, int iterations,
+			struct bench_result *res)
+{
+	uint64_t start;
+	int i;
+
+	res->name = image_name(devname);
+	start = now_usec();
+
+	for (i = 0; i < iterations; i++) {
+		uint64_t reads, bytes, hits;
+
+		if (probe_once(devname, &reads, &bytes, &hits) == -1)
+			errx(EXIT_FAILURE, "%s: blkid_do_safeprobe() failed",
+					devname);
+		if (i > 0 && (reads != res->reads || bytes != res->bytes) &&
+		    !res->unstable) {
+			warnx("%s: I/O is not the same for all iterations",
+					devname);
+			res->unstable = 1;
+		}
+		res->reads = reads;
+		res->bytes = bytes;
+		res->hits = hits;
+	}
+
+	res->usec = now_usec() - start;
+}
+
+static int check_baseline(const char *filename, struct bench_result *res,
+			  size_t nres)
+{
+	FILE *f;
+	char buf[BUFSIZ];
+	size_t i;
+	int nfails = 0, line = 0;
+
+	f = fopen(filename, "r");
+	if (!f)
+		err(EXIT_FAILURE, "%s: cannot open", filename);
+
+	while (fgets(buf, sizeof(buf), f)) {
+		char name[256];
+		uintmax_t reads, bytes;
+
+		line++;
+		if (*buf == '#' || *buf == '\n')
+			continue;
+		if (sscanf(buf, "%255s %ju %ju", name, &reads, &bytes) != 3) {
+			warnx("%s:%d: parse error", filename, line);
+			nfails++;
+			continue;
+		}
+		for (i = 0; i < nres; i++) {
+			if (strcmp(res[i].name, name) != 0)
+				continue;
+			res[i].matched = 1;
+			if (res[i].reads > reads) {
+				warnx("%s: %" PRIu64 " read() calls, baseline %ju",
+						name, res[i].reads, reads);
+				nfails++;
+			}
+			if (res[i].bytes > bytes) {
+				warnx("%s: %" PRIu64 " bytes read, baseline %ju",
+						name, res[i].bytes, bytes);
+				nfails++;
+			}
+			break;
+		}
+		if (i == nres) {
+			warnx("%s:%d: %s: no such image", filename, line, name);
+			nfails++;
+		}
+	}
+
+	fclose(f);
+
+	for (i = 0; i < nres; i++) {
+		if (res[i].matched)
+			continue;
+		warnx("%s: not in the baseline %s", res[i].name, filename);
+		nfails++;
+	}
+	return nfails;
+}
+
+static void __attribute__((__noreturn__)) usage(FILE *out)
+{
+	fprintf(out, "usage: %s [options] <device|file> ...  "
+			"-- benchmarks low-level probing\n\n"
+			" -b, --baseline <file>   fail if reads exceed or do not match the baseline\n"
+			" -n, --iterations <num>  number of probings per device (default 1)\n"
+			" -r, --raw               print results in the baseline format\n"
+			" -h, --help              display this help and exit\n",
+			program_invocation_short_name);
+	exit(out == stderr ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+int main(int argc, char *argv[])
+{
+	struct bench_result *res, total = { .name = "total" };
+	const char *baseline = NULL;
+	int c, iterations = 1, raw = 0;
+	size_t i, nres;
+
+	static const struct option longopts[] = {
+		{ "baseline",   1, 0, 'b' },
+		{ "iterations", 1, 0, 'n' },
+		{ "raw",        0, 0, 'r' },
+		{ "help",       0, 0, 'h' },
+		{ NULL, 0, 0, 0 }
+	};
+
+	while ((c = getopt_long(argc, argv, "b:n:rh", longopts, NULL)) != -1) {
+		switch (c) {
+		case 'b':
+			baseline = optarg;
+			break;
+		case 'n':
+			iterations = atoi(optarg);
+			if (iterations <= 0)
+				errx(EXIT_FAILURE, "invalid number of iterations: %s",
+						optarg);
+			break;
+		case 'r':
+			raw = 1;
+			break;
+		case 'h':
+			usage(stdout);
+		default:
+			usage(stderr);
+		}
+	}
+
+	if (optind >= argc)
+		usage(stderr);
+
+	nres = argc - optind;
+	res = calloc(nres, sizeof(*res));
+	if (!res)
+		err(EXIT_FAILURE, "cannot allocate results");
+
+	if (!raw)
+		printf("%-24s %8s %10s %8s %12s\n",
+			"NAME", "READS", "BYTES", "HITS", "USEC/PROBE");
+
+	for (i = 0; i < nres; i++) {
+		struct bench_result *r = &res[i];
+
+		bench_image(argv[optind + i], iterations, r);
+
+		total.reads += r->reads;
+		total.bytes += r->bytes;
+		total.hits += r->hits;
+		total.usec += r->usec;
+
+		if (raw)
+			printf("%s %" PRIu64 " %" PRIu64 "\n",
+				r->name, r->reads, r->bytes);
+		else
+			printf("%-24s %8" PRIu64 " %10" PRIu64 " %8" PRIu64 " %12" PRIu64 "\n",
+				r->name, r->reads, r->bytes, r->hits,
+				r->usec / iterations);
+	}
+
+	if (!raw)
+		printf("%-24s %8" PRIu64 " %10" PRIu64 " %8" PRIu64 " %12" PRIu64 "\n",
+			total.name, total.reads, total.bytes, total.hits,
+			total.usec / iterations);
+
+	c = baseline ? check_baseline(baseline, res, nres) : 0;
+
+	for (i = 0; i < nres; i++) {
+		if (res[i].unstable)
+			c++;
+		free(res[i].name);
+	}
+	free(res);
+
+	return c ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -207,6 +207,10 @@ struct blkid_struct_probe
 
 	struct list_head	buffers;	/* list of buffers */
 
+	uint64_t		io_reads;	/* read() calls, see blkid_probe_get_iostats() */
+	uint64_t		io_bytes;	/* bytes read */
+	uint64_t		io_hits;	/* requests satisfied from buffers */
+
 	struct blkid_chain	chains[BLKID_NCHAINS];	/* array of chains */
 	struct blkid_chain	*cur_chain;		/* current chain */
 
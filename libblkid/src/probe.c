@@ -518,11 +518,23 @@ int __blkid_probe_filter_types(blkid_probe pr, int chain, int flag, char *names[
 	return 0;
 }
 
+/*
+ * The I/O statistics of cloned probers are accounted to the original
+ * prober, so the caller gets numbers for the whole probing.
+ */
+static blkid_probe probe_iostats_root(blkid_probe pr)
+{
+	while (pr->parent)
+		pr = pr->parent;
+	return pr;
+}
+
 unsigned char *blkid_probe_get_buffer(blkid_probe pr,
 				blkid_loff_t off, blkid_loff_t len)
 {
 	struct list_head *p;
 	struct blkid_bufinfo *bf = NULL;
+	blkid_probe root;
 
 	if (pr->size <= 0)
 		return NULL;
@@ -551,6 +563,7 @@ unsigned char *blkid_probe_get_buffer(blkid_probe pr,
 				printf("\treuse buffer: off=%jd len=%jd pr=%p\n",
 							x->off, x->len, pr));
 			bf = x;
+			probe_iostats_root(pr)->io_hits++;
 			break;
 		}
 	}
@@ -575,6 +588,12 @@ unsigned char *blkid_probe_get_buffer(blkid_probe pr,
 				off, len, pr));
 
 		ret = read(pr->fd, bf->data, len);
+
+		root = probe_iostats_root(pr);
+		root->io_reads++;
+		if (ret > 0)
+			root->io_bytes += ret;
+
 		if (ret != (ssize_t) len) {
 			free(bf);
 			return NULL;
@@ -668,6 +687,7 @@ int blkid_probe_set_device(blkid_probe pr, int fd,
 	pr->wipe_off = 0;
 	pr->wipe_size = 0;
 	pr->wipe_chain = NULL;
+	blkid_probe_reset_iostats(pr);
 
 #if defined(POSIX_FADV_RANDOM) && defined(HAVE_POSIX_FADVISE)
 	/* Disable read-ahead */
@@ -1404,6 +1424,47 @@ int blkid_probe_get_fd(blkid_probe pr)
 	return pr ? pr->fd : -1;
 }
 
+/**
+ * blkid_probe_get_iostats:
+ * @pr: probe
+ * @reads: returns number of read() calls or NULL
+ * @bytes: returns number of bytes read from the device or NULL
+ * @hits: returns number of requests satisfied from already read buffers or NULL
+ *
+ * The statistics are accumulated since blkid_probe_set_device() (or
+ * blkid_probe_reset_iostats()) and they are not affected by blkid_reset_probe().
+ *
+ * Returns: 0 on success, or -1 in case of error.
+ */
+int blkid_probe_get_iostats(blkid_probe pr, uint64_t *reads,
+			    uint64_t *bytes, uint64_t *hits)
+{
+	if (!pr)
+		return -1;
+	if (reads)
+		*reads = pr->io_reads;
+	if (bytes)
+		*bytes = pr->io_bytes;
+	if (hits)
+		*hits = pr->io_hits;
+	return 0;
+}
+
+/**
+ * blkid_probe_reset_iostats:
+ * @pr: probe
+ *
+ * Zeroize I/O statistics, see blkid_probe_get_iostats().
+ */
+void blkid_probe_reset_iostats(blkid_probe pr)
+{
+	if (!pr)
+		return;
+	pr->io_reads = 0;
+	pr->io_bytes = 0;
+	pr->io_hits = 0;
+}
+
 /**
  * blkid_probe_get_sectorsize:
  * @pr: probe or NULL (for NULL returns 512)
@@ -22,11 +22,13 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/wait.h>
 #include <blkid.h>
 
 #include "canonicalize.h"
 #include "mountP.h"
 #include "loopdev.h"
+#include "all-io.h"
 
 /*
  * Canonicalized (resolved) paths & tags cache
@@ -36,12 +38,16 @@
 #define MNT_CACHE_ISTAG		(1 << 1) /* entry is TAG */
 #define MNT_CACHE_ISPATH	(1 << 2) /* entry is path */
 #define MNT_CACHE_TAGREAD	(1 << 3) /* tag read by mnt_cache_read_tags() */
+#define MNT_CACHE_AMBI		(1 << 4) /* ambivalent probing result */
 
 /* path cache entry */
 struct mnt_cache_entry {
 	char			*key;	/* search key (e.g. uncanonicalized path) */
 	char			*value;	/* value (e.g. canonicalized path) */
 	int			flag;
+
+	size_t			knext;	/* next entry (+1) in the key chain */
+	size_t			dnext;	/* next entry (+1) in the device chain */
 };
 
 struct libmnt_cache {
@@ -49,6 +55,12 @@ struct libmnt_cache {
 	size_t			nents;
 	size_t			nallocs;
 
+	/* hash chains (entry index + 1, 0 is end of chain); paths and tags
+	 * are hashed by key, tags and probed devices by device name */
+	size_t			*khash;
+	size_t			*dhash;
+	size_t			nbuckets;
+
 	/* blkid_evaluate_tag() works in two ways:
 	 *
 	 * 1/ all tags are evaluated by udev /dev/disk/by-* symlinks,
@@ -97,11 +109,71 @@ void mnt_free_cache(struct libmnt_cache *cache)
 		free(e->key);
 	}
 	free(cache->ents);
+	free(cache->khash);
+	free(cache->dhash);
 	if (cache->bc)
 		blkid_put_cache(cache->bc);
 	free(cache);
 }
 
+static unsigned int cache_hash(unsigned int h, const char *str)
+{
+	while (*str)
+		h = (h * 33) ^ (unsigned char) *str++;
+	return h;
+}
+
+/* tag key is "TAG_NAME\0TAG_VALUE\0" */
+static unsigned int cache_hash_key(const char *key, int flag)
+{
+	unsigned int h = cache_hash(5381, key);
+
+	if (flag & MNT_CACHE_ISTAG)
+		h = cache_hash(h * 33, key + strlen(key) + 1);
+	return h;
+}
+
+static void cache_hash_entry(struct libmnt_cache *cache, size_t i)
+{
+	struct mnt_cache_entry *e = &cache->ents[i];
+	size_t b;
+
+	e->knext = e->dnext = 0;
+
+	if (e->flag & (MNT_CACHE_ISPATH | MNT_CACHE_ISTAG)) {
+		b = cache_hash_key(e->key, e->flag) % cache->nbuckets;
+		e->knext = cache->khash[b];
+		cache->khash[b] = i + 1;
+	}
+	if (e->flag & (MNT_CACHE_ISTAG | MNT_CACHE_TAGREAD)) {
+		b = cache_hash(5381, e->value) % cache->nbuckets;
+		e->dnext = cache->dhash[b];
+		cache->dhash[b] = i + 1;
+	}
+}
+
+static int cache_rehash(struct libmnt_cache *cache, size_t nbuckets)
+{
+	size_t *kh, *dh, i;
+
+	kh = calloc(nbuckets, sizeof(size_t));
+	dh = calloc(nbuckets, sizeof(size_t));
+	if (!kh || !dh) {
+		free(kh);
+		free(dh);
+		return -ENOMEM;
+	}
+	free(cache->khash);
+	free(cache->dhash);
+	cache->khash = kh;
+	cache->dhash = dh;
+	cache->nbuckets = nbuckets;
+
+	for (i = 0; i < cache->nents; i++)
+		cache_hash_entry(cache, i);
+	return 0;
+}
+
 /* note that the @key could be tha same pointer as @value */
 static int cache_add_entry(struct libmnt_cache *cache, char *key,
 					char *value, int flag)
@@ -121,11 +193,16 @@ static int cache_add_entry(struct libmnt_cache *cache, char *key,
 		cache->ents = e;
 		cache->nallocs = sz;
 	}
+	if (cache->nents >= cache->nbuckets &&
+	    cache_rehash(cache, cache->nbuckets ?
+				cache->nbuckets * 2 : MNT_CACHE_CHUNKSZ))
+		return -ENOMEM;
 
 	e = &cache->ents[cache->nents];
 	e->key = key;
 	e->value = value;
 	e->flag = flag;
+	cache_hash_entry(cache, cache->nents);
 	cache->nents++;
 
 	DBG(CACHE, mnt_debug_h(cache, "add entry [%2zd] (%s): %s: %s",
@@ -181,11 +258,12 @@ static const char *cache_find_path(struct libmnt_cache *cache, const char *path)
 	assert(cache);
 	assert(path);
 
-	if (!cache || !path)
+	if (!cache || !path || !cache->nbuckets)
 		return NULL;
 
-	for (i = 0; i < cache->nents; i++) {
-		struct mnt_cache_entry *e = &cache->ents[i];
+	i = cache->khash[cache_hash(5381, path) % cache->nbuckets];
+	for (; i; i = cache->ents[i - 1].knext) {
+		struct mnt_cache_entry *e = &cache->ents[i - 1];
 		if (!(e->flag & MNT_CACHE_ISPATH))
 			continue;
 		if (strcmp(path, e->key) == 0)
@@ -195,11 +273,13 @@ static const char *cache_find_path(struct libmnt_cache *cache, const char *path)
 }
 
 /*
- * Returns cached path or NULL.
+ * Returns cached path or NULL. More devices may share the same tag, the
+ * chains are newest-first, so walk the whole chain to keep the first one.
  */
 static const char *cache_find_tag(struct libmnt_cache *cache,
 			const char *token, const char *value)
 {
+	const char *res = NULL;
 	size_t i;
 	size_t tksz;
 
@@ -207,18 +287,41 @@ static const char *cache_find_tag(struct libmnt_cache *cache,
 	assert(token);
 	assert(value);
 
-	if (!cache || !token || !value)
+	if (!cache || !token || !value || !cache->nbuckets)
 		return NULL;
 
 	tksz = strlen(token);
 
-	for (i = 0; i < cache->nents; i++) {
-		struct mnt_cache_entry *e = &cache->ents[i];
+	i = cache_hash(cache_hash(5381, token) * 33, value) % cache->nbuckets;
+	for (i = cache->khash[i]; i; i = cache->ents[i - 1].knext) {
+		struct mnt_cache_entry *e = &cache->ents[i - 1];
 		if (!(e->flag & MNT_CACHE_ISTAG))
 			continue;
 		if (strcmp(token, e->key) == 0 &&
 		    strcmp(value, e->key + tksz + 1) == 0)
-			return e->value;
+			res = e->value;
+	}
+	return res;
+}
+
+/*
+ * Returns the entry that marks @devname as probed by mnt_cache_read_tags()
+ * or NULL.
+ */
+static struct mnt_cache_entry *cache_find_probed(struct libmnt_cache *cache,
+			const char *devname)
+{
+	size_t i;
+
+	if (!cache->nbuckets)
+		return NULL;
+
+	i = cache->dhash[cache_hash(5381, devname) % cache->nbuckets];
+	for (; i; i = cache->ents[i - 1].dnext) {
+		struct mnt_cache_entry *e = &cache->ents[i - 1];
+		if ((e->flag & MNT_CACHE_TAGREAD) && !(e->flag & MNT_CACHE_ISTAG)
+		    && strcmp(e->value, devname) == 0)
+			return e;
 	}
 	return NULL;
 }
@@ -232,8 +335,12 @@ static char *cache_find_tag_value(struct libmnt_cache *cache,
 	assert(devname);
 	assert(token);
 
-	for (i = 0; i < cache->nents; i++) {
-		struct mnt_cache_entry *e = &cache->ents[i];
+	if (!cache->nbuckets)
+		return NULL;
+
+	i = cache->dhash[cache_hash(5381, devname) % cache->nbuckets];
+	for (; i; i = cache->ents[i - 1].dnext) {
+		struct mnt_cache_entry *e = &cache->ents[i - 1];
 		if (!(e->flag & MNT_CACHE_ISTAG))
 			continue;
 		if (strcmp(e->value, devname) == 0 &&	/* dev name */
@@ -244,6 +351,97 @@ static char *cache_find_tag_value(struct libmnt_cache *cache,
 	return NULL;
 }
 
+static const char *cache_tags[] = { "LABEL", "UUID", "TYPE", "PARTUUID", "PARTLABEL" };
+static const char *cache_blktags[] = { "LABEL", "UUID", "TYPE", "PART_ENTRY_UUID", "PART_ENTRY_NAME" };
+
+#define MNT_CACHE_NTAGS	ARRAY_SIZE(cache_tags)
+
+/*
+ * Probes @devname, returns blkid_do_safeprobe() result or -1. The @values
+ * (indexed like cache_tags[]) point to @pr, use blkid_free_probe(@pr) after
+ * the values are not needed anymore.
+ */
+static int cache_probe(const char *devname, blkid_probe *pr, const char **values)
+{
+	size_t i;
+	int rc;
+
+	memset(values, 0, MNT_CACHE_NTAGS * sizeof(char *));
+
+	*pr = blkid_new_probe_from_filename(devname);
+	if (!*pr)
+		return -1;
+
+	blkid_probe_enable_superblocks(*pr, 1);
+	blkid_probe_set_superblocks_flags(*pr,
+			BLKID_SUBLKS_LABEL | BLKID_SUBLKS_UUID |
+			BLKID_SUBLKS_TYPE);
+
+	blkid_probe_enable_partitions(*pr, 1);
+	blkid_probe_set_partitions_flags(*pr, BLKID_PARTS_ENTRY_DETAILS);
+
+	rc = blkid_do_safeprobe(*pr);
+	if (rc == 0) {
+		for (i = 0; i < MNT_CACHE_NTAGS; i++)
+			blkid_probe_lookup_value(*pr, cache_blktags[i],
+						 &values[i], NULL);
+	}
+	return rc;
+}
+
+/*
+ * Adds the result of cache_probe() to the cache. Returns 0 if at least one
+ * tag was added, 1 if no tag was added or negative number in case of error.
+ */
+static int cache_add_probed(struct libmnt_cache *cache, const char *devname,
+			    int rc, const char **values)
+{
+	size_t i, ntags = 0;
+	char *dev;
+
+	/*
+	 * Remember that the device has been probed (also when nothing has
+	 * been detected), the entry is invisible for tags and paths lookups.
+	 */
+	dev = strdup(devname);
+	if (!dev)
+		return -ENOMEM;
+	if (cache_add_entry(cache, dev, dev, MNT_CACHE_TAGREAD |
+				(rc == -2 ? MNT_CACHE_AMBI : 0))) {
+		free(dev);
+		return -ENOMEM;
+	}
+	if (rc) {
+		DBG(CACHE, mnt_debug_h(cache, "%s: %s", devname,
+				rc == -2 ? "ambivalent result" : "nothing detected"));
+		return 1;
+	}
+
+	DBG(CACHE, mnt_debug_h(cache, "reading tags for: %s", devname));
+
+	for (i = 0; i < MNT_CACHE_NTAGS; i++) {
+		if (!values[i])
+			continue;
+		if (cache_find_tag_value(cache, devname, cache_tags[i])) {
+			DBG(CACHE, mnt_debug_h(cache,
+					"\ntag %s already cached", cache_tags[i]));
+			continue;
+		}
+		dev = strdup(devname);
+		if (!dev)
+			return -ENOMEM;
+		if (cache_add_tag(cache, cache_tags[i], values[i], dev,
+					MNT_CACHE_TAGREAD)) {
+			free(dev);
+			return -ENOMEM;
+		}
+		ntags++;
+	}
+
+	DBG(CACHE, mnt_debug_h(cache, "\tread %zd tags", ntags));
+	return ntags ? 0 : 1;
+}
+
 /**
  * mnt_cache_read_tags
  * @cache: pointer to struct libmnt_cache instance
@@ -256,10 +454,9 @@ static char *cache_find_tag_value(struct libmnt_cache *cache,
  */
 int mnt_cache_read_tags(struct libmnt_cache *cache, const char *devname)
 {
-	blkid_probe pr;
-	size_t i, ntags = 0;
-	const char *tags[] = { "LABEL", "UUID", "TYPE", "PARTUUID", "PARTLABEL" };
-	const char *blktags[] = { "LABEL", "UUID", "TYPE", "PART_ENTRY_UUID", "PART_ENTRY_NAME" };
+	blkid_probe pr = NULL;
+	const char *values[MNT_CACHE_NTAGS];
+	int rc;
 
 	assert(cache);
 	assert(devname);
@@ -270,60 +467,207 @@ int mnt_cache_read_tags(struct libmnt_cache *cache, const char *devname)
 	DBG(CACHE, mnt_debug_h(cache, "tags for %s requested", devname));
 
 	/* check is device is already cached */
-	for (i = 0; i < cache->nents; i++) {
-		struct mnt_cache_entry *e = &cache->ents[i];
-		if (!(e->flag & MNT_CACHE_TAGREAD))
+	if (cache_find_probed(cache, devname))
+		return 0;
+
+	rc = cache_probe(devname, &pr, values);
+	if (rc != -1)
+		rc = cache_add_probed(cache, devname, rc, values);
+
+	blkid_free_probe(pr);
+	return rc;
+}
+
+/*
+ * mnt_cache_read_tags_set() worker, writes the results to @fd as records:
+ *
+ *	<index> <probe rc> { <length + 1> <value> | 0 } x MNT_CACHE_NTAGS
+ */
+static void cache_probe_worker(int fd, const char **devs, size_t ndevs,
+			       size_t first, size_t step)
+{
+	FILE *f = fdopen(fd, "w");
+	size_t i, t;
+
+	if (!f)
+		_exit(EXIT_FAILURE);
+
+	for (i = first; i < ndevs; i += step) {
+		blkid_probe pr = NULL;
+		const char *values[MNT_CACHE_NTAGS];
+		uint32_t idx = i, len;
+		int32_t rc = cache_probe(devs[i], &pr, values);
+
+		fwrite(&idx, sizeof(idx), 1, f);
+		fwrite(&rc, sizeof(rc), 1, f);
+		for (t = 0; t < MNT_CACHE_NTAGS; t++) {
+			len = values[t] ? strlen(values[t]) + 1 : 0;
+			fwrite(&len, sizeof(len), 1, f);
+			if (len)
+				fwrite(values[t], 1, len, f);
+		}
+		blkid_free_probe(pr);
+	}
+	_exit(fclose(f) == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+/* parses cache_probe_worker() output; incomplete records are ignored */
+static int cache_add_worker_output(struct libmnt_cache *cache,
+			const char **devs, size_t ndevs,
+			const char *buf, size_t bufsz)
+{
+	const char *p = buf, *end = buf + bufsz;
+
+	while (p + 2 * sizeof(uint32_t) <= end) {
+		const char *values[MNT_CACHE_NTAGS];
+		uint32_t idx, len;
+		int32_t rc;
+		size_t t;
+
+		memcpy(&idx, p, sizeof(idx));
+		memcpy(&rc, p + sizeof(idx), sizeof(rc));
+		p += sizeof(idx) + sizeof(rc);
+
+		for (t = 0; t < MNT_CACHE_NTAGS; t++) {
+			if (p + sizeof(len) > end)
+				return 0;
+			memcpy(&len, p, sizeof(len));
+			p += sizeof(len);
+			if (len > (size_t) (end - p) || (len && p[len - 1]))
+				return 0;
+			values[t] = len ? p : NULL;
+			p += len;
+		}
+		if (idx >= ndevs || rc == -1 || cache_find_probed(cache, devs[idx]))
 			continue;
-		if (strcmp(e->value, devname) == 0)
-			/* tags has been already read */
-			return 0;
+		if (cache_add_probed(cache, devs[idx], rc, values) < 0)
+			return -ENOMEM;
 	}
+	return 0;
+}
 
-	pr =  blkid_new_probe_from_filename(devname);
-	if (!pr)
-		return -1;
+static int cmp_devnames(const void *a, const void *b)
+{
+	return strcmp(*(char * const *) a, *(char * const *) b);
+}
 
-	blkid_probe_enable_superblocks(pr, 1);
-	blkid_probe_set_superblocks_flags(pr,
-			BLKID_SUBLKS_LABEL | BLKID_SUBLKS_UUID |
-			BLKID_SUBLKS_TYPE);
+/**
+ * mnt_cache_read_tags_set:
+ * @cache: pointer to struct libmnt_cache instance
+ * @devnames: array of device paths
+ * @ndevs: number of @devnames
+ * @nworkers: maximal number of devices probed at the same time
+ *
+ * Reads tags for all @devnames like mnt_cache_read_tags(), but the devices
+ * are probed by up to @nworkers child processes. Devices already in the cache
+ * and duplicate @devnames are probed only once. This is useful to populate
+ * the cache before a large table is printed.
+ *
+ * Returns: 0 on success, negative number in case of error.
+ */
+int mnt_cache_read_tags_set(struct libmnt_cache *cache, const char **devnames,
+			    size_t ndevs, int nworkers)
+{
+	const char **devs;
+	size_t i, n = 0;
+	int w, rc = 0;
+	struct {
+		pid_t	pid;
+		int	fd;
+	} *wk = NULL;
+
+	if (!cache || (ndevs && !devnames) || nworkers < 1)
+		return -EINVAL;
+	if (!ndevs)
+		return 0;
 
-	blkid_probe_enable_partitions(pr, 1);
-	blkid_probe_set_partitions_flags(pr, BLKID_PARTS_ENTRY_DETAILS);
+	devs = malloc(ndevs * sizeof(char *));
+	if (!devs)
+		return -ENOMEM;
 
-	if (blkid_do_safeprobe(pr))
-		goto error;
+	for (i = 0; i < ndevs; i++) {
+		if (devnames[i] && !cache_find_probed(cache, devnames[i]))
+			devs[n++] = devnames[i];
+	}
+	qsort(devs, n, sizeof(char *), cmp_devnames);
+	for (ndevs = n, n = 0, i = 0; i < ndevs; i++) {
+		if (!n || strcmp(devs[n - 1], devs[i]) != 0)
+			devs[n++] = devs[i];
+	}
+	ndevs = n;
 
-	DBG(CACHE, mnt_debug_h(cache, "reading tags for: %s", devname));
+	if ((size_t) nworkers > ndevs)
+		nworkers = ndevs;
 
-	for (i = 0; i < ARRAY_SIZE(tags); i++) {
-		const char *data;
-		char *dev;
+	DBG(CACHE, mnt_debug_h(cache, "probing %zu devices by %d workers",
+				ndevs, nworkers));
 
-		if (cache_find_tag_value(cache, devname, tags[i])) {
-			DBG(CACHE, mnt_debug_h(cache,
-					"\ntag %s already cached", tags[i]));
+	if (nworkers > 1)
+		wk = calloc(nworkers, sizeof(*wk));
+
+	for (w = 0; wk && w < nworkers; w++) {
+		int pfd[2];
+
+		wk[w].fd = -1;
+		if (pipe(pfd) != 0)
 			continue;
+
+		wk[w].pid = fork();
+		if (wk[w].pid == 0) {
+			close(pfd[0]);
+			cache_probe_worker(pfd[1], devs, ndevs, w, nworkers);
 		}
-		if (blkid_probe_lookup_value(pr, blktags[i], &data, NULL))
+		close(pfd[1]);
+		if (wk[w].pid < 0) {
+			DBG(CACHE, mnt_debug_h(cache, "fork failed %m"));
+			close(pfd[0]);
 			continue;
-		dev = strdup(devname);
-		if (!dev)
-			goto error;
-		if (cache_add_tag(cache, tags[i], data, dev,
-					MNT_CACHE_TAGREAD)) {
-			free(dev);
-			goto error;
 		}
-		ntags++;
+		wk[w].fd = pfd[0];
 	}
 
-	DBG(CACHE, mnt_debug_h(cache, "\tread %zd tags", ntags));
-	blkid_free_probe(pr);
-	return ntags ? 0 : 1;
-error:
-	blkid_free_probe(pr);
-	return -1;
+	for (w = 0; wk && w < nworkers; w++) {
+		char *buf = NULL;
+		size_t sz = 0, bufsz = 0;
+		ssize_t ret;
+
+		if (wk[w].fd < 0)
+			continue;
+		for (;;) {
+			if (sz == bufsz) {
+				char *tmp = realloc(buf, bufsz + BUFSIZ);
+				if (!tmp)
+					break;
+				buf = tmp;
+				bufsz += BUFSIZ;
+			}
+			ret = read(wk[w].fd, buf + sz, bufsz - sz);
+			if (ret < 0 && errno == EINTR)
+				continue;
+			if (ret <= 0)
+				break;
+			sz += ret;
+		}
+
+		close(wk[w].fd);
+		while (waitpid(wk[w].pid, NULL, 0) < 0 && errno == EINTR);
+
+		if (!rc && sz)
+			rc = cache_add_worker_output(cache, devs, ndevs, buf, sz);
+		free(buf);
+	}
+
+	/* devices without (working) worker */
+	for (i = 0; !rc && i < ndevs; i++) {
+		if (wk && wk[i % nworkers].fd >= 0)
+			continue;
+		if (mnt_cache_read_tags(cache, devs[i]) == -ENOMEM)
+			rc = -ENOMEM;
+	}
+
+	free(wk);
+	free(devs);
+	return rc;
 }
 
 /**
@@ -367,6 +711,16 @@ char *mnt_cache_find_tag_value(struct libmnt_cache *cache,
 	return cache_find_tag_value(cache, devname, token);
 }
 
+/*
+ * Returns TRUE if the cached probing result for @devname is ambivalent.
+ */
+static int cache_is_ambivalent(struct libmnt_cache *cache, const char *devname)
+{
+	struct mnt_cache_entry *e = cache_find_probed(cache, devname);
+
+	return e && (e->flag & MNT_CACHE_AMBI) ? TRUE : FALSE;
+}
+
 /**
  * mnt_get_fstype:
  * @devname: device name
@@ -385,8 +739,12 @@ char *mnt_get_fstype(const char *devname, int *ambi, struct libmnt_cache *cache)
 
 	DBG(CACHE, mnt_debug_h(cache, "get %s FS type", devname));
 
-	if (cache)
-		return mnt_cache_find_tag_value(cache, devname, "TYPE");
+	if (cache) {
+		type = mnt_cache_find_tag_value(cache, devname, "TYPE");
+		if (ambi)
+			*ambi = cache_is_ambivalent(cache, devname);
+		return type;
+	}
 
 	/*
 	 * no cache, probe directly
@@ -683,12 +1041,42 @@ int test_read_tags(struct libmnt_test *ts, int argc, char *argv[])
 
 }
 
+int test_read_tags_set(struct libmnt_test *ts, int argc, char *argv[])
+{
+	struct libmnt_cache *cache;
+	size_t i;
+	int rc;
+
+	if (argc < 2)
+		return -EINVAL;
+
+	cache = mnt_new_cache();
+	if (!cache)
+		return -ENOMEM;
+
+	rc = mnt_cache_read_tags_set(cache, (const char **) argv + 1,
+				     argc - 1, 4);
+
+	for (i = 0; rc == 0 && i < cache->nents; i++) {
+		struct mnt_cache_entry *e = &cache->ents[i];
+		if (!(e->flag & MNT_CACHE_ISTAG))
+			continue;
+
+		printf("%15s : %5s : %s\n", e->value, e->key,
+				e->key + strlen(e->key) + 1);
+	}
+
+	mnt_free_cache(cache);
+	return rc;
+}
+
 int main(int argc, char *argv[])
 {
 	struct libmnt_test ts[] = {
 		{ "--resolve-path", test_resolve_path, "  resolve paths from stdin" },
 		{ "--resolve-spec", test_resolve_spec, "  evaluate specs from stdin" },
 		{ "--read-tags", test_read_tags,       "  read devname or TAG from stdin (\"quit\" to exit)" },
+		{ "--read-tags-set", test_read_tags_set, "<devname> [...]  read tags by parallel workers" },
 		{ NULL }
 	};
 
@@ -33,6 +33,7 @@
 
 #include "mountP.h"
 
+#include <sys/time.h>
 #include <sys/wait.h>
 
 /**
@@ -86,6 +87,8 @@ void mnt_free_context(struct libmnt_context *cxt)
 
 	free(cxt->fstype_pattern);
 	free(cxt->optstr_pattern);
+	mnt_free_pattern(cxt->fstype_cpattern);
+	mnt_free_pattern(cxt->optstr_cpattern);
 
 	if (!(cxt->flags & MNT_FL_EXTERN_FSTAB))
 		mnt_free_table(cxt->fstab);
@@ -788,17 +791,24 @@ const char *mnt_context_get_options(struct libmnt_context *cxt)
  */
 int mnt_context_set_fstype_pattern(struct libmnt_context *cxt, const char *pattern)
 {
+	struct libmnt_pattern *cp = NULL;
 	char *p = NULL;
 
 	if (!cxt)
 		return -EINVAL;
 	if (pattern) {
 		p = strdup(pattern);
-		if (!p)
+		cp = mnt_new_pattern(MNT_PATTERN_FSTYPE, pattern);
+		if (!p || !cp) {
+			free(p);
+			mnt_free_pattern(cp);
 			return -ENOMEM;
+		}
 	}
 	free(cxt->fstype_pattern);
+	mnt_free_pattern(cxt->fstype_cpattern);
 	cxt->fstype_pattern = p;
+	cxt->fstype_cpattern = cp;
 	return 0;
 }
 
@@ -813,17 +823,24 @@ int mnt_context_set_fstype_pattern(struct libmnt_context *cxt, const char *patte
  */
 int mnt_context_set_options_pattern(struct libmnt_context *cxt, const char *pattern)
 {
+	struct libmnt_pattern *cp = NULL;
 	char *p = NULL;
 
 	if (!cxt)
 		return -EINVAL;
 	if (pattern) {
 		p = strdup(pattern);
-		if (!p)
+		cp = mnt_new_pattern(MNT_PATTERN_OPTIONS, pattern);
+		if (!p || !cp) {
+			free(p);
+			mnt_free_pattern(cp);
 			return -ENOMEM;
+		}
 	}
 	free(cxt->optstr_pattern);
+	mnt_free_pattern(cxt->optstr_cpattern);
 	cxt->optstr_pattern = p;
+	cxt->optstr_cpattern = cp;
 	return 0;
 }
 
@@ -1399,6 +1416,10 @@ int mnt_context_prepare_target(struct libmnt_context *cxt)
 /*
  * It's usully no error when we're not able to detect filesystem type -- we
  * will try to use types from /{etc,proc}/filesystems.
+ *
+ * The device is probed also if the FS type pattern is specified, the detected
+ * type is used if it matches the pattern. The pattern is tried by mount(2)
+ * calls only if probing fails or returns ambivalent or unexpected result.
  */
 int mnt_context_guess_fstype(struct libmnt_context *cxt)
 {
@@ -1426,8 +1447,6 @@ int mnt_context_guess_fstype(struct libmnt_context *cxt)
 		goto done;
 	if (cxt->flags & MS_REMOUNT)
 		goto none;
-	if (cxt->fstype_pattern)
-		goto done;
 
 	dev = mnt_fs_get_srcpath(cxt->fs);
 	if (!dev)
@@ -1437,12 +1456,17 @@ int mnt_context_guess_fstype(struct libmnt_context *cxt)
 		struct libmnt_cache *cache = mnt_context_get_cache(cxt);
 
 		type = mnt_get_fstype(dev, &cxt->ambi, cache);
-		if (type) {
+		if (type && cxt->fstype_pattern &&
+		    !mnt_match_fstype(type, cxt->fstype_pattern)) {
+			DBG(CXT, mnt_debug_h(cxt, "detected %s does not match "
+					"%s pattern", type, cxt->fstype_pattern));
+		} else if (type)
 			rc = mnt_fs_set_fstype(cxt->fs, type);
-			if (!cache)
-				free(type);	/* type is not cached */
-		}
-	} else {
+
+		if (!cache)
+			free(type);	/* type is not cached */
+
+	} else if (!cxt->fstype_pattern) {
 		if (strchr(dev, ':') != NULL)
 			rc = mnt_fs_set_fstype(cxt->fs, "nfs");
 		else if (!strncmp(dev, "//", 2))
@@ -2104,6 +2128,218 @@ int mnt_context_wait_for_children(struct libmnt_context *cxt,
 	return 0;
 }
 
+/*
+ * The filesystems have to be (u)mounted in the original order if a mountpoint
+ * is below the other one, or if the source (bind mount, loop device backing
+ * file, ...) is below the other mountpoint.
+ */
+static int set_is_related(struct libmnt_fs *a, struct libmnt_fs *b)
+{
+	const char *ta = mnt_fs_get_target(a),
+		   *tb = mnt_fs_get_target(b);
+
+	return mnt_path_is_under(ta, tb) || mnt_path_is_under(tb, ta) ||
+	       mnt_path_is_under(ta, mnt_fs_get_srcpath(b)) ||
+	       mnt_path_is_under(tb, mnt_fs_get_srcpath(a));
+}
+
+struct set_entry {
+	struct libmnt_fs	*fs;
+	pid_t			pid;
+	struct timeval		start;
+
+	size_t			ndeps;		/* number of unfinished dependencies */
+	size_t			*waiting;	/* entries which depend on this entry */
+	size_t			nwaiting;
+};
+
+static int set_add_waiting(struct set_entry *ent, size_t idx)
+{
+	if ((ent->nwaiting & 7) == 0) {
+		size_t *w = realloc(ent->waiting,
+				(ent->nwaiting + 8) * sizeof(size_t));
+		if (!w)
+			return -ENOMEM;
+		ent->waiting = w;
+	}
+	ent->waiting[ent->nwaiting++] = idx;
+	return 0;
+}
+
+static pid_t set_start_entry(struct libmnt_context *cxt,
+			     struct set_entry *ent,
+			     int (*action)(struct libmnt_context *),
+			     int (*worker)(struct libmnt_context *,
+					   struct libmnt_fs *, int))
+{
+	struct libmnt_table *mtab;
+	pid_t pid;
+	int rc;
+
+	DBG(CXT, mnt_debug_h(cxt, "set: starting %s",
+				mnt_fs_get_target(ent->fs)));
+	DBG_FLUSH;
+	fflush(stdout);
+	fflush(stderr);
+
+	gettimeofday(&ent->start, NULL);
+
+	pid = fork();
+	if (pid != 0)
+		return pid;	/* parent or error */
+
+	/* child */
+	mtab = cxt->mtab;
+	cxt->mtab = NULL;		/* do not reset mtab */
+	mnt_reset_context(cxt);
+	cxt->mtab = mtab;
+	cxt->pid = getpid();
+
+	rc = mnt_context_set_fs(cxt, ent->fs);
+	if (!rc)
+		rc = action(cxt);
+	if (worker)
+		rc = worker(cxt, ent->fs, rc);
+
+	DBG(CXT, mnt_debug_h(cxt, "set: child exit [rc=%d]", rc));
+	DBG_FLUSH;
+	exit(rc);
+}
+
+/*
+ * The (u)mount set executor. Filesystems from @tb (in @direction order) are
+ * filtered by @ignore() and the rest is (u)mounted by @action() in child
+ * processes, at most @nworkers at the same time. The filesystems are started
+ * in the table order, but a filesystem waits for all previous related
+ * filesystems (see set_is_related()).
+ */
+int mnt_context_run_set(struct libmnt_context *cxt,
+			struct libmnt_table *tb,
+			int direction,
+			int (*ignore)(struct libmnt_context *, struct libmnt_fs *),
+			int (*action)(struct libmnt_context *),
+			int nworkers,
+			int (*worker)(struct libmnt_context *,
+				      struct libmnt_fs *, int),
+			void (*done)(struct libmnt_context *,
+				     struct libmnt_fs *, int, int,
+				     unsigned long))
+{
+	struct libmnt_iter itr;
+	struct libmnt_fs *fs;
+	struct set_entry *ents = NULL;
+	size_t nents = 0, i, j, *ready = NULL, nready = 0, head = 0;
+	int nrunning = 0, rc = 0;
+
+	assert(cxt);
+	assert(tb);
+	assert(nworkers > 0);
+
+	ents = calloc(mnt_table_get_nents(tb) + 1, sizeof(struct set_entry));
+	ready = calloc(mnt_table_get_nents(tb) + 1, sizeof(size_t));
+	if (!ents || !ready) {
+		rc = -ENOMEM;
+		goto done;
+	}
+
+	mnt_reset_iter(&itr, direction);
+	while (mnt_table_next_fs(tb, &itr, &fs) == 0) {
+		int ign;
+
+		if (!mnt_fs_get_target(fs))
+			continue;
+		ign = ignore(cxt, fs);
+		if (ign < 0) {
+			rc = ign;
+			goto done;
+		}
+		if (ign) {
+			if (done)
+				done(cxt, fs, ign, 0, 0);
+			continue;
+		}
+		ents[nents].fs = fs;
+
+		for (j = 0; j < nents; j++) {
+			if (!set_is_related(ents[j].fs, fs))
+				continue;
+			rc = set_add_waiting(&ents[j], nents);
+			if (rc)
+				goto done;
+			ents[nents].ndeps++;
+		}
+		if (!ents[nents].ndeps)
+			ready[nready++] = nents;
+		nents++;
+	}
+
+	DBG(CXT, mnt_debug_h(cxt, "set: %zu filesystems, %d workers",
+				nents, nworkers));
+
+	while (head < nready || nrunning) {
+		struct set_entry *ent = NULL;
+		struct timeval now;
+		int status = 0;
+		pid_t pid;
+
+		/* start ready filesystems */
+		if (nrunning < nworkers && head < nready) {
+			ent = &ents[ready[head++]];
+			ent->pid = set_start_entry(cxt, ent, action, worker);
+			if (ent->pid > 0) {
+				nrunning++;
+				continue;
+			}
+			status = -errno;
+			DBG(CXT, mnt_debug_h(cxt, "set: fork failed %m"));
+			ent->pid = 0;
+		} else {
+			/* wait for any worker */
+			pid = waitpid(-1, &status, 0);
+			if (pid < 0) {
+				if (errno == EINTR)
+					continue;
+				rc = -errno;
+				goto done;
+			}
+			for (i = 0; i < nents; i++) {
+				if (ents[i].pid == pid) {
+					ent = &ents[i];
+					break;
+				}
+			}
+			if (!ent)
+				continue;	/* not our child */
+			nrunning--;
+			ent->pid = 0;
+			status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+		}
+
+		gettimeofday(&now, NULL);
+		if (done)
+			done(cxt, ent->fs, 0, status,
+			     (now.tv_sec - ent->start.tv_sec) * 1000000 +
+			     (now.tv_usec - ent->start.tv_usec));
+
+		for (i = 0; i < ent->nwaiting; i++) {
+			struct set_entry *w = &ents[ent->waiting[i]];
+
+			if (--w->ndeps == 0)
+				ready[nready++] = ent->waiting[i];
+		}
+	}
+done:
+	/* wait for remaining workers on error */
+	while (nrunning && waitpid(-1, NULL, 0) > 0)
+		nrunning--;
+
+	for (i = 0; ents && i < nents; i++)
+		free(ents[i].waiting);
+	free(ents);
+	free(ready);
+	return rc;
+}
+
 
 
 #ifdef TEST_PROGRAM
@@ -803,6 +803,53 @@ int mnt_context_mount(struct libmnt_context *cxt)
 	return rc;
 }
 
+/*
+ * Returns 1 if @fs does not match, 2 if it's already mounted, 0 if it should
+ * be mounted by mount -a, or <0 on error.
+ */
+static int mount_ignored(struct libmnt_context *cxt, struct libmnt_fs *fs)
+{
+	const char *o, *tgt;
+	int rc, mounted = 0;
+
+	o = mnt_fs_get_user_options(fs);
+	tgt = mnt_fs_get_target(fs);
+
+	DBG(CXT, mnt_debug_h(cxt, "next-mount: trying %s", tgt));
+
+	/*  ignore swap */
+	if (mnt_fs_is_swaparea(fs) ||
+
+	/* ignore root filesystem */
+	   (tgt && (strcmp(tgt, "/") == 0 || strcmp(tgt, "root") == 0)) ||
+
+	/* ignore noauto filesystems */
+	   (o && mnt_optstr_get_option(o, "noauto", NULL, NULL) == 0) ||
+
+	/* ignore filesystems not match with options patterns */
+	   (cxt->fstype_cpattern && !mnt_fs_match_pattern(fs,
+					cxt->fstype_cpattern)) ||
+
+	/* ignore filesystems not match with type patterns */
+	   (cxt->optstr_cpattern && !mnt_fs_match_pattern(fs,
+					cxt->optstr_cpattern))) {
+		DBG(CXT, mnt_debug_h(cxt, "next-mount: not-match "
+				"[fstype: %s, t-pattern: %s, options: %s, O-pattern: %s]",
+				mnt_fs_get_fstype(fs),
+				cxt->fstype_pattern,
+				mnt_fs_get_options(fs),
+				cxt->optstr_pattern));
+		return 1;
+	}
+
+	/* ignore already mounted filesystems */
+	rc = mnt_context_is_fs_mounted(cxt, fs, &mounted);
+	if (rc)
+		return rc;
+
+	return mounted ? 2 : 0;
+}
+
 /**
  * mnt_context_next_mount:
  * @cxt: context
@@ -839,8 +886,7 @@ int mnt_context_next_mount(struct libmnt_context *cxt,
 			   int *ignored)
 {
 	struct libmnt_table *fstab, *mtab;
-	const char *o, *tgt;
-	int rc, mounted = 0;
+	int rc;
 
 	if (ignored)
 		*ignored = 0;
@@ -863,45 +909,12 @@ int mnt_context_next_mount(struct libmnt_context *cxt,
 	if (rc != 0)
 		return rc;	/* more filesystems (or error) */
 
-	o = mnt_fs_get_user_options(*fs);
-	tgt = mnt_fs_get_target(*fs);
-
-	DBG(CXT, mnt_debug_h(cxt, "next-mount: trying %s", tgt));
-
-	/*  ignore swap */
-	if (mnt_fs_is_swaparea(*fs) ||
-
-	/* ignore root filesystem */
-	   (tgt && (strcmp(tgt, "/") == 0 || strcmp(tgt, "root") == 0)) ||
-
-	/* ignore noauto filesystems */
-	   (o && mnt_optstr_get_option(o, "noauto", NULL, NULL) == 0) ||
-
-	/* ignore filesystems not match with options patterns */
-	   (cxt->fstype_pattern && !mnt_fs_match_fstype(*fs,
-					cxt->fstype_pattern)) ||
-
-	/* ignore filesystems not match with type patterns */
-	   (cxt->optstr_pattern && !mnt_fs_match_options(*fs,
-					cxt->optstr_pattern))) {
-		if (ignored)
-			*ignored = 1;
-		DBG(CXT, mnt_debug_h(cxt, "next-mount: not-match "
-				"[fstype: %s, t-pattern: %s, options: %s, O-pattern: %s]",
-				mnt_fs_get_fstype(*fs),
-				cxt->fstype_pattern,
-				mnt_fs_get_options(*fs),
-				cxt->optstr_pattern));
-		return 0;
-	}
-
-	/* ignore already mounted filesystems */
-	rc = mnt_context_is_fs_mounted(cxt, *fs, &mounted);
-	if (rc)
+	rc = mount_ignored(cxt, *fs);
+	if (rc < 0)
 		return rc;
-	if (mounted) {
+	if (rc) {
 		if (ignored)
-			*ignored = 2;
+			*ignored = rc;
 		return 0;
 	}
 
@@ -932,3 +945,55 @@ int mnt_context_next_mount(struct libmnt_context *cxt,
 	return 0;
 }
 
+/**
+ * mnt_context_mount_set:
+ * @cxt: context
+ * @nworkers: maximal number of filesystems mounted at the same time
+ * @worker: called in the child process after mount, or NULL
+ * @done: called in the parent process for each filesystem, or NULL
+ *
+ * Mounts all filesystems from fstab like mnt_context_next_mount(), but more
+ * filesystems are mounted in parallel, every filesystem in a separate child
+ * process. A filesystem is mounted after all previous fstab entries with a
+ * mountpoint (or source path) above or below its mountpoint are finished, so
+ * nested mountpoints are mounted in the fstab order.
+ *
+ * The @worker(cxt, fs, rc) function is called in the child process with the
+ * return code from mnt_context_mount(); the function returns the child exit
+ * status. Without @worker the return code is used as exit status.
+ *
+ * The @done(cxt, fs, ignored, status, usec) function is called for ignored
+ * filesystems (@ignored is 1 for not matching and 2 for already mounted
+ * filesystems) and for finished children with the exit status (or -1 if the
+ * child has been killed, or negative errno if fork failed) and the elapsed
+ * time in microseconds.
+ *
+ * Note that the function waits for any child process (see waitpid(2)), and the
+ * fork mode (mnt_context_enable_fork()) cannot be used together with this
+ * function.
+ *
+ * Returns: 0 on success, <0 in case of error (!= mount(2) errors)
+ */
+int mnt_context_mount_set(struct libmnt_context *cxt,
+			  int nworkers,
+			  int (*worker)(struct libmnt_context *,
+					struct libmnt_fs *, int),
+			  void (*done)(struct libmnt_context *,
+				       struct libmnt_fs *, int, int,
+				       unsigned long))
+{
+	struct libmnt_table *fstab;
+	int rc;
+
+	if (!cxt || nworkers < 1 || mnt_context_is_fork(cxt))
+		return -EINVAL;
+
+	rc = mnt_context_get_fstab(cxt, &fstab);
+	if (rc)
+		return rc;
+
+	return mnt_context_run_set(cxt, fstab, MNT_ITER_FORWARD,
+				   mount_ignored, mnt_context_mount,
+				   nworkers, worker, done);
+}
+
@@ -812,6 +812,36 @@ int mnt_context_umount(struct libmnt_context *cxt)
 }
 
 
+/*
+ * Returns 1 if @fs does not match umount -a patterns, or 0.
+ */
+static int umount_ignored(struct libmnt_context *cxt, struct libmnt_fs *fs)
+{
+	const char *tgt = mnt_fs_get_target(fs);
+
+	DBG(CXT, mnt_debug_h(cxt, "next-umount: trying %s", tgt));
+
+	/* ignore root filesystem */
+	if ((tgt && (strcmp(tgt, "/") == 0 || strcmp(tgt, "root") == 0)) ||
+
+	/* ignore filesystems not match with options patterns */
+	   (cxt->fstype_cpattern && !mnt_fs_match_pattern(fs,
+					cxt->fstype_cpattern)) ||
+
+	/* ignore filesystems not match with type patterns */
+	   (cxt->optstr_cpattern && !mnt_fs_match_pattern(fs,
+					cxt->optstr_cpattern))) {
+		DBG(CXT, mnt_debug_h(cxt, "next-umount: not-match "
+				"[fstype: %s, t-pattern: %s, options: %s, O-pattern: %s]",
+				mnt_fs_get_fstype(fs),
+				cxt->fstype_pattern,
+				mnt_fs_get_options(fs),
+				cxt->optstr_pattern));
+		return 1;
+	}
+	return 0;
+}
+
 /**
  * mnt_context_next_umount:
  * @cxt: context
@@ -874,26 +904,9 @@ int mnt_context_next_umount(struct libmnt_context *cxt,
 		tgt = mnt_fs_get_target(*fs);
 	} while (!tgt);
 
-	DBG(CXT, mnt_debug_h(cxt, "next-umount: trying %s", tgt));
-
-	/* ignore root filesystem */
-	if ((tgt && (strcmp(tgt, "/") == 0 || strcmp(tgt, "root") == 0)) ||
-
-	/* ignore filesystems not match with options patterns */
-	   (cxt->fstype_pattern && !mnt_fs_match_fstype(*fs,
-					cxt->fstype_pattern)) ||
-
-	/* ignore filesystems not match with type patterns */
-	   (cxt->optstr_pattern && !mnt_fs_match_options(*fs,
-					cxt->optstr_pattern))) {
+	if (umount_ignored(cxt, *fs)) {
 		if (ignored)
 			*ignored = 1;
-		DBG(CXT, mnt_debug_h(cxt, "next-umount: not-match "
-				"[fstype: %s, t-pattern: %s, options: %s, O-pattern: %s]",
-				mnt_fs_get_fstype(*fs),
-				cxt->fstype_pattern,
-				mnt_fs_get_options(*fs),
-				cxt->optstr_pattern));
 		return 0;
 	}
 
@@ -905,3 +918,204 @@ int mnt_context_next_umount(struct libmnt_context *cxt,
 		*mntrc = rc;
 	return 0;
 }
+
+/**
+ * mnt_context_umount_set:
+ * @cxt: context
+ * @nworkers: maximal number of filesystems umounted at the same time
+ * @worker: called in the child process after umount, or NULL
+ * @done: called in the parent process for each filesystem, or NULL
+ *
+ * Umounts all filesystems from mtab like mnt_context_next_umount() in
+ * backward order, but more filesystems are umounted in parallel. A filesystem
+ * is umounted after all filesystems mounted later with a mountpoint (or source
+ * path) above or below its mountpoint.
+ *
+ * See mnt_context_mount_set() for more details about @worker and @done, the
+ * @ignored argument for @done is 1 for filesystems that do not match.
+ *
+ * Returns: 0 on success, <0 in case of error (!= umount(2) errors)
+ */
+int mnt_context_umount_set(struct libmnt_context *cxt,
+			   int nworkers,
+			   int (*worker)(struct libmnt_context *,
+					 struct libmnt_fs *, int),
+			   void (*done)(struct libmnt_context *,
+					struct libmnt_fs *, int, int,
+					unsigned long))
+{
+	struct libmnt_table *mtab;
+	int rc;
+
+	if (!cxt || nworkers < 1 || mnt_context_is_fork(cxt))
+		return -EINVAL;
+
+	rc = mnt_context_get_mtab(cxt, &mtab);
+	if (rc)
+		return rc;
+
+	return mnt_context_run_set(cxt, mtab, MNT_ITER_BACKWARD,
+				   umount_ignored, mnt_context_umount,
+				   nworkers, worker, done);
+}
+
+/*
+ * Adds @parent and all its children from mountinfo @tb to @ents in
+ * post-order, so children are before parents.
+ */
+static int umount_subtree_add(struct libmnt_table *tb, struct libmnt_fs *parent,
+			      struct libmnt_fs **ents, size_t *nents, size_t max)
+{
+	struct libmnt_iter itr;
+	struct libmnt_fs *chld;
+	int rc;
+
+	mnt_reset_iter(&itr, MNT_ITER_FORWARD);
+	while ((rc = mnt_table_next_child_fs(tb, &itr, parent, &chld)) == 0) {
+		rc = umount_subtree_add(tb, chld, ents, nents, max);
+		if (rc)
+			return rc;
+	}
+	if (rc < 0)
+		return rc;
+	if (*nents >= max)
+		return -EINVAL;
+
+	ents[(*nents)++] = parent;
+	return 0;
+}
+
+/**
+ * mnt_context_umount_recursive:
+ * @cxt: umount context
+ * @done: called after each successfully umounted filesystem, or NULL
+ *
+ * Umounts the filesystem specified by mnt_context_set_target() and all
+ * filesystems mounted below it. The subtree is computed from one mtab snapshot
+ * (see mnt_context_get_mtab()); for mountinfo it follows parent/child IDs,
+ * for /etc/mtab it is based on paths. The filesystems are umounted leaves
+ * first and mtab (or utab) is updated only once at the end.
+ *
+ * The umount stops on the first failed filesystem; the context describes the
+ * failed filesystem then, see mnt_context_get_status() and
+ * mnt_context_get_target().
+ *
+ * Returns: 0 on success;
+ *         >0 in case of umount(2) error (returns syscall errno),
+ *         <0 in case of other errors.
+ */
+int mnt_context_umount_recursive(struct libmnt_context *cxt,
+			void (*done)(struct libmnt_context *, struct libmnt_fs *))
+{
+	struct libmnt_table *mtab;
+	struct libmnt_fs *fs, *root, **ents = NULL;
+	struct libmnt_iter itr;
+	const char **rmtgts = NULL;
+	const char *tgt;
+	size_t nents = 0, nrm = 0, i;
+	int rc, update;
+
+	if (!cxt || !cxt->fs)
+		return -EINVAL;
+
+	tgt = mnt_fs_get_target(cxt->fs);
+	if (!tgt)
+		return -EINVAL;
+
+	rc = mnt_context_get_mtab(cxt, &mtab);
+	if (rc)
+		return rc;
+
+	root = mnt_table_find_target(mtab, tgt, MNT_ITER_BACKWARD);
+	if (!root && mnt_context_is_swapmatch(cxt))
+		root = mnt_table_find_source(mtab, tgt, MNT_ITER_BACKWARD);
+	if (!root) {
+		DBG(CXT, mnt_debug_h(cxt, "umount-recursive: %s not found", tgt));
+		return mnt_context_umount(cxt);
+	}
+
+	ents = calloc(mnt_table_get_nents(mtab), sizeof(struct libmnt_fs *));
+	if (!ents)
+		return -ENOMEM;
+
+	if (mnt_fs_get_id(root) > 0) {
+		/* mountinfo: follow the mount tree, the table order is not
+		 * the tree order (e.g. after mount --move) */
+		rc = umount_subtree_add(mtab, root, ents, &nents,
+					mnt_table_get_nents(mtab));
+		if (rc) {
+			free(ents);
+			return rc;
+		}
+	} else {
+		/* mtab: @root and all later mounted filesystems below it */
+		mnt_reset_iter(&itr, MNT_ITER_FORWARD);
+		while (mnt_table_next_fs(mtab, &itr, &fs) == 0) {
+			if (fs == root || (nents &&
+			    mnt_path_is_under(mnt_fs_get_target(root),
+					      mnt_fs_get_target(fs))))
+				ents[nents++] = fs;
+		}
+		/* leaves first */
+		for (i = 0; i < nents / 2; i++) {
+			fs = ents[i];
+			ents[i] = ents[nents - i - 1];
+			ents[nents - i - 1] = fs;
+		}
+	}
+
+	DBG(CXT, mnt_debug_h(cxt, "umount-recursive: %s: %zu filesystems",
+				mnt_fs_get_target(root), nents));
+
+	update = !mnt_context_is_nomtab(cxt) &&
+		 (cxt->mtab_writable || cxt->utab_writable);
+	if (update) {
+		rmtgts = calloc(nents, sizeof(char *));
+		if (!rmtgts) {
+			free(ents);
+			return -ENOMEM;
+		}
+	}
+
+	for (i = 0; i < nents; i++) {
+		fs = ents[i];
+
+		cxt->mtab = NULL;		/* do not reset mtab */
+		mnt_reset_context(cxt);
+		cxt->mtab = mtab;
+
+		rc = mnt_context_set_fs(cxt, fs);
+		if (!rc)
+			rc = mnt_context_prepare_umount(cxt);
+		if (!rc)
+			rc = mnt_context_do_umount(cxt);
+		if (rc)
+			break;
+
+		/* helpers maintain mtab on their own */
+		if (rmtgts && !cxt->helper && !(cxt->mountflags & MS_REMOUNT)
+		    && strcmp(mnt_fs_get_target(fs), "/") != 0)
+			rmtgts[nrm++] = mnt_fs_get_target(fs);
+		if (done)
+			done(cxt, fs);
+	}
+
+	if (nrm) {
+		struct libmnt_update *upd = mnt_new_update();
+		int rc2 = -ENOMEM;
+
+		if (upd)
+			rc2 = mnt_update_set_filename(upd,
+				cxt->mtab_writable ? cxt->mtab_path : cxt->utab_path,
+				!cxt->mtab_writable);
+		if (!rc2)
+			rc2 = mnt_update_remove_targets(upd, rmtgts, nrm, cxt->lock);
+		if (!rc)
+			rc = rc2;
+		mnt_free_update(upd);
+	}
+
+	free(rmtgts);
+	free(ents);
+	return rc;
+}
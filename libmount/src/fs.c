@@ -1368,6 +1368,26 @@ int mnt_fs_match_options(struct libmnt_fs *fs, const char *options)
 	return mnt_match_options(mnt_fs_get_options(fs), options);
 }
 
+/**
+ * mnt_fs_match_pattern:
+ * @fs: filesystem
+ * @pat: compiled pattern, see mnt_new_pattern()
+ *
+ * Matches the filesystem type (MNT_PATTERN_FSTYPE) or the mount options
+ * (MNT_PATTERN_OPTIONS) against @pat, the same as mnt_fs_match_fstype() or
+ * mnt_fs_match_options() with the not compiled pattern.
+ *
+ * Returns: 1 if @fs is matching, else 0.
+ */
+int mnt_fs_match_pattern(struct libmnt_fs *fs, struct libmnt_pattern *pat)
+{
+	if (!fs || !pat)
+		return 0;
+	if (mnt_pattern_get_type(pat) == MNT_PATTERN_FSTYPE)
+		return mnt_pattern_match(pat, fs->fstype);
+	return mnt_pattern_match(pat, mnt_fs_get_options(fs));
+}
+
 /**
  * mnt_fs_print_debug
  * @fs: fstab/mtab/mountinfo entry
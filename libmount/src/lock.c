@@ -13,12 +13,17 @@
  * The mtab lock is backwardly compatible with the standard linux /etc/mtab
  * locking.  Note, it's necessary to use the same locking schema in all
  * application that access the file.
+ *
+ * The private utab file is protected by flock(2). The waiters are queued in
+ * FIFO order by open file description locks (if supported by kernel), so
+ * unlock wakes up only the next waiter.
  */
 #include <sys/time.h>
 #include <time.h>
 #include <signal.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <stdint.h>
 #include <sys/file.h>
 
 #include "pathnames.h"
@@ -34,11 +39,31 @@ struct libmnt_lock {
 
 	unsigned int	locked :1,	/* do we own the lock? */
 			sigblock :1,	/* block signals when locked */
-			simplelock :1;	/* use flock rather than normal mtab lock */
+			simplelock :1,	/* use flock rather than normal mtab lock */
+			nofifo :1;	/* don't queue flock waiters */
 
 	sigset_t oldsigmask;
+
+	/* simplelock contention statistics */
+	unsigned int	nlocks;		/* number of successful locks */
+	unsigned int	ncontended;	/* number of locks we had to wait for */
+	unsigned long	wait_usec;	/* time spent by waiting */
+	unsigned long	wait_max;	/* the longest wait */
 };
 
+/* open file description locks (Linux 3.15) */
+#ifndef F_OFD_SETLK
+# define F_OFD_GETLK	36
+# define F_OFD_SETLK	37
+# define F_OFD_SETLKW	38
+#endif
+
+/*
+ * The simplelock queue lives in the lock file: the ticket counter is stored at
+ * the begin of the file, every waiter owns one byte at MNT_LOCK_SLOTS + ticket.
+ */
+#define MNT_LOCK_SLOTS		((off_t) sizeof(uint64_t))
+
 
 /**
  * mnt_new_lock:
@@ -99,6 +124,12 @@ void mnt_free_lock(struct libmnt_lock *ml)
 	if (!ml)
 		return;
 	DBG(LOCKS, mnt_debug_h(ml, "free%s", ml->locked ? " !!! LOCKED !!!" : ""));
+	if (ml->nlocks) {
+		DBG(LOCKS, mnt_debug_h(ml, "stats: locks=%u, contended=%u, "
+				"wait avg=%lu us, max=%lu us",
+				ml->nlocks, ml->ncontended,
+				ml->wait_usec / ml->nlocks, ml->wait_max));
+	}
 	free(ml->lockfile);
 	free(ml->linkfile);
 	free(ml);
@@ -192,10 +223,75 @@ static void unlock_simplelock(struct libmnt_lock *ml)
 	}
 }
 
+static int ofd_lock(int fd, int cmd, short type, off_t start, off_t len)
+{
+	struct flock fl;
+	int rc;
+
+	memset(&fl, 0, sizeof(fl));
+	fl.l_type = type;
+	fl.l_whence = SEEK_SET;
+	fl.l_start = start;
+	fl.l_len = len;
+
+	do {
+		rc = fcntl(fd, cmd, &fl);
+	} while (rc < 0 && errno == EINTR);
+
+	return rc < 0 ? -errno : 0;
+}
+
+/*
+ * Waits in the FIFO queue for our turn. The queue is a chain of the one byte
+ * locks: the waiter holds the lock on its slot and waits for the slot of its
+ * predecessor. The kernel drops the locks on close(), so the unlock (or the
+ * exit of the owner) wakes up only the next waiter.
+ *
+ * The queue does not replace flock() -- it's still necessary for mutual
+ * exclusion against older libmount versions and against waiters who left the
+ * queue before their turn.
+ *
+ * Returns: 0 if we are the queue head, 1 if we had to wait, <0 on error.
+ */
+static int queue_simplelock(struct libmnt_lock *ml)
+{
+	int fd = ml->lockfile_fd, rc;
+	uint64_t ticket = 0, next;
+	off_t slot;
+
+	rc = ofd_lock(fd, F_OFD_SETLKW, F_WRLCK, 0, MNT_LOCK_SLOTS);
+	if (rc)
+		return rc;	/* old kernel or read-only lock file */
+
+	if (pread(fd, &ticket, sizeof(ticket), 0) != sizeof(ticket))
+		ticket = 0;	/* new lock file */
+	next = ticket + 1;
+
+	if (pwrite(fd, &next, sizeof(next), 0) != sizeof(next))
+		rc = -errno;
+	slot = MNT_LOCK_SLOTS + (off_t) ticket;
+	if (!rc)
+		rc = ofd_lock(fd, F_OFD_SETLK, F_WRLCK, slot, 1);
+
+	ofd_lock(fd, F_OFD_SETLK, F_UNLCK, 0, MNT_LOCK_SLOTS);
+	if (rc || !ticket)
+		return rc;
+
+	DBG(LOCKS, mnt_debug_h(ml, "queued: ticket=%llu",
+				(unsigned long long) ticket));
+
+	rc = ofd_lock(fd, F_OFD_SETLK, F_WRLCK, slot - 1, 1);
+	if (rc == -EAGAIN || rc == -EACCES)
+		return ofd_lock(fd, F_OFD_SETLKW, F_WRLCK, slot - 1, 1) ? : 1;
+	return rc;
+}
+
 static int lock_simplelock(struct libmnt_lock *ml)
 {
 	const char *lfile;
-	int rc;
+	struct timeval start, end;
+	unsigned long usec;
+	int rc, contended = 0;
 
 	assert(ml);
 	assert(ml->simplelock);
@@ -211,24 +307,53 @@ static int lock_simplelock(struct libmnt_lock *ml)
 		sigprocmask(SIG_BLOCK, &sigs, &ml->oldsigmask);
 	}
 
-	ml->lockfile_fd = open(lfile, O_RDONLY|O_CREAT|O_CLOEXEC,
+	gettimeofday(&start, NULL);
+
+	ml->lockfile_fd = open(lfile, O_RDWR|O_CREAT|O_CLOEXEC,
 				      S_IWUSR|S_IRUSR|S_IRGRP|S_IROTH);
+	if (ml->lockfile_fd < 0 && errno == EACCES)
+		/* the queue is unusable, but flock() is fine */
+		ml->lockfile_fd = open(lfile, O_RDONLY|O_CLOEXEC);
 	if (ml->lockfile_fd < 0) {
 		rc = -errno;
 		goto err;
 	}
 
-	while (flock(ml->lockfile_fd, LOCK_EX) < 0) {
-		int errsv;
-		if ((errno == EAGAIN) || (errno == EINTR))
-			continue;
-		errsv = errno;
+	if (!ml->nofifo) {
+		rc = queue_simplelock(ml);
+		if (rc < 0)
+			DBG(LOCKS, mnt_debug_h(ml, "%s: FIFO queue unsupported "
+					"[rc=%d]", lfile, rc));
+		else if (rc == 1)
+			contended = 1;
+	}
+
+	rc = flock(ml->lockfile_fd, LOCK_EX | LOCK_NB);
+	if (rc < 0 && errno == EWOULDBLOCK) {
+		contended = 1;
+		while ((rc = flock(ml->lockfile_fd, LOCK_EX)) < 0 &&
+		       ((errno == EAGAIN) || (errno == EINTR)));
+	}
+	if (rc < 0) {
+		rc = -errno;
 		close(ml->lockfile_fd);
 		ml->lockfile_fd = -1;
-		rc = -errsv;
 		goto err;
 	}
 	ml->locked = 1;
+
+	gettimeofday(&end, NULL);
+	usec = (end.tv_sec - start.tv_sec) * 1000000UL +
+		end.tv_usec - start.tv_usec;
+	ml->nlocks++;
+	ml->wait_usec += usec;
+	if (usec > ml->wait_max)
+		ml->wait_max = usec;
+	if (contended)
+		ml->ncontended++;
+
+	DBG(LOCKS, mnt_debug_h(ml, "%s: locked [%s, %lu us]", lfile,
+				contended ? "contended" : "uncontended", usec));
 	return 0;
 err:
 	if (ml->sigblock)
@@ -548,6 +673,8 @@ void mnt_unlock_file(struct libmnt_lock *ml)
 }
 
 #ifdef TEST_PROGRAM
+#include <sys/mman.h>
+#include <sys/wait.h>
 
 struct libmnt_lock *lock;
 
@@ -679,6 +806,122 @@ int test_lock(struct libmnt_test *ts, int argc, char *argv[])
 	return 0;
 }
 
+static int cmp_usec(const void *a, const void *b)
+{
+	unsigned long x = *((unsigned long *) a), y = *((unsigned long *) b);
+
+	return x < y ? -1 : x > y ? 1 : 0;
+}
+
+/*
+ * Forks <nprocs> lockers, every locker increments the number in <datafile>
+ * <loops> times under the simplelock (flock) and records how long it waited
+ * for the lock.
+ */
+int test_stress(struct libmnt_test *ts, int argc, char *argv[])
+{
+	int nprocs, loops, i, idx = 1, nofifo = 0, rc = 0, pfd[2];
+	unsigned long *lat;
+	size_t nlat;
+	long num = 0;
+	FILE *f;
+
+	if (idx < argc && strcmp(argv[idx], "--nofifo") == 0) {
+		nofifo = 1;
+		idx++;
+	}
+	if (argc - idx < 3)
+		return -EINVAL;
+
+	nprocs = atoi(argv[idx + 1]);
+	loops = atoi(argv[idx + 2]);
+	if (nprocs <= 0 || loops <= 0)
+		return -EINVAL;
+
+	nlat = (size_t) nprocs * loops;
+	lat = mmap(NULL, nlat * sizeof(*lat), PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (lat == MAP_FAILED)
+		err(EXIT_FAILURE, "mmap failed");
+
+	if (pipe(pfd) != 0)
+		err(EXIT_FAILURE, "pipe failed");
+
+	for (i = 0; i < nprocs; i++) {
+		char c;
+		int l;
+
+		switch (fork()) {
+		case -1:
+			err(EXIT_FAILURE, "fork failed");
+		case 0:
+			break;
+		default:
+			continue;
+		}
+
+		/* wait for the others */
+		close(pfd[1]);
+		if (read(pfd[0], &c, 1) < 0)
+			_exit(EXIT_FAILURE);
+
+		for (l = 0; l < loops; l++) {
+			struct timeval start, end;
+
+			gettimeofday(&start, NULL);
+			lock = mnt_new_lock(argv[idx], 0);
+			if (!lock)
+				_exit(EXIT_FAILURE);
+			mnt_lock_use_simplelock(lock, TRUE);
+			lock->nofifo = nofifo;
+
+			if (mnt_lock_file(lock) != 0) {
+				warnx("%d: failed to lock %s file",
+						getpid(), argv[idx]);
+				_exit(EXIT_FAILURE);
+			}
+			gettimeofday(&end, NULL);
+
+			increment_data(argv[idx], 0, l);
+
+			mnt_unlock_file(lock);
+			mnt_free_lock(lock);
+			lock = NULL;
+
+			lat[i * loops + l] = (end.tv_sec - start.tv_sec) * 1000000UL
+						+ end.tv_usec - start.tv_usec;
+		}
+		_exit(EXIT_SUCCESS);
+	}
+
+	close(pfd[0]);
+	close(pfd[1]);		/* start */
+
+	while (wait(&i) > 0) {
+		if (!WIFEXITED(i) || WEXITSTATUS(i) != EXIT_SUCCESS)
+			rc = -1;
+	}
+
+	f = fopen(argv[idx], "r");
+	if (!f || fscanf(f, "%ld", &num) != 1)
+		err(EXIT_FAILURE, "%s: failed to read data", argv[idx]);
+	fclose(f);
+
+	qsort(lat, nlat, sizeof(*lat), cmp_usec);
+
+	printf("lockers: %d, loops: %d, fifo: %s\n", nprocs, loops,
+			nofifo ? "no" : "yes");
+	printf("lock wait: p50=%lu us, p99=%lu us, max=%lu us\n",
+			lat[nlat / 2], lat[nlat * 99 / 100], lat[nlat - 1]);
+	if (num != (long) nlat) {
+		warnx("%s: expected %zu, got %ld", argv[idx], nlat, num);
+		rc = -1;
+	}
+
+	munmap(lat, nlat * sizeof(*lat));
+	return rc;
+}
+
 /*
  * Note that this test should be executed from a script that creates many
  * parallel processes, otherwise this test does not make sense.
@@ -688,6 +931,8 @@ int main(int argc, char *argv[])
 	struct libmnt_test tss[] = {
 	{ "--lock", test_lock,  " [--synctime <time_t>] [--verbose] <datafile> <loops> "
 				"increment a number in datafile" },
+	{ "--stress", test_stress, " [--nofifo] <datafile> <nprocs> <loops> "
+				"parallel flock lockers, prints wait percentiles" },
 	{ NULL }
 	};
 
@@ -134,6 +134,7 @@ extern int mnt_is_readonly(const char *path);
 extern int mnt_parse_offset(const char *str, size_t len, uintmax_t *res);
 
 extern int mnt_chdir_to_parent(const char *target, char **filename);
+extern int mnt_path_is_under(const char *dir, const char *path);
 extern char *mnt_get_username(const uid_t uid);
 extern int mnt_get_uid(const char *username, uid_t *uid);
 extern int mnt_get_gid(const char *groupname, gid_t *gid);
@@ -255,6 +256,7 @@ struct libmnt_table {
 	int		(*fltrcb)(struct libmnt_fs *fs, void *data);
 	void		*fltrcb_data;
 
+	struct libmnt_tabidx	*srcidx;	/* see mnt_table_is_fs_mounted() */
 
 	struct list_head	ents;	/* list of entries (libmnt_fs) */
 };
@@ -285,6 +287,9 @@ struct libmnt_context
 	char	*fstype_pattern;	/* for mnt_match_fstype() */
 	char	*optstr_pattern;	/* for mnt_match_options() */
 
+	struct libmnt_pattern *fstype_cpattern;	/* compiled fstype_pattern */
+	struct libmnt_pattern *optstr_cpattern;	/* compiled optstr_pattern */
+
 	struct libmnt_fs *fs;		/* filesystem description (type, mountpoint, device, ...) */
 
 	struct libmnt_table *fstab;	/* fstab (or mtab for some remounts) entries */
@@ -367,6 +372,11 @@ struct libmnt_context
 /* lock.c */
 extern int mnt_lock_use_simplelock(struct libmnt_lock *ml, int enable);
 
+/* tab_update.c */
+extern int mnt_update_remove_targets(struct libmnt_update *upd,
+				     const char **targets, size_t ntargets,
+				     struct libmnt_lock *lc);
+
 /* optmap.c */
 extern const struct libmnt_optmap *mnt_optmap_get_entry(
 			     struct libmnt_optmap const **maps,
@@ -405,6 +415,17 @@ extern int mnt_context_delete_loopdev(struct libmnt_context *cxt);
 extern int mnt_context_clear_loopdev(struct libmnt_context *cxt);
 
 extern int mnt_fork_context(struct libmnt_context *cxt);
+extern int mnt_context_run_set(struct libmnt_context *cxt,
+			struct libmnt_table *tb,
+			int direction,
+			int (*ignore)(struct libmnt_context *, struct libmnt_fs *),
+			int (*action)(struct libmnt_context *),
+			int nworkers,
+			int (*worker)(struct libmnt_context *,
+				      struct libmnt_fs *, int),
+			void (*done)(struct libmnt_context *,
+				     struct libmnt_fs *, int, int,
+				     unsigned long));
 
 extern int mnt_context_set_tabfilter(struct libmnt_context *cxt,
 			int (*fltr)(struct libmnt_fs *, void *),
@@ -183,6 +183,125 @@ const struct libmnt_optmap *mnt_get_builtin_optmap(int id)
 	return NULL;
 }
 
+/*
+ * Sorted index for the built-in maps. The maps themselves cannot be sorted,
+ * the order of the entries defines the order of the options generated from
+ * flags (see mnt_optstr_apply_flags()).
+ */
+struct optmap_key {
+	const char	*name;
+	size_t		namesz;		/* without "=" or "[=]" suffix */
+	const struct libmnt_optmap *ent;
+};
+
+struct optmap_index {
+	const struct libmnt_optmap *map;
+	struct optmap_key	*keys;		/* sorted by name, position */
+	size_t			nkeys;
+	const struct libmnt_optmap *prefix;	/* first MNT_PREFIX entry */
+	int			state;		/* 0: none, 1: building, 2: ready */
+};
+
+static struct optmap_key linux_flags_keys[ARRAY_SIZE(linux_flags_map)];
+static struct optmap_key userspace_opts_keys[ARRAY_SIZE(userspace_opts_map)];
+
+static struct optmap_index builtin_indexes[] = {
+	{ linux_flags_map, linux_flags_keys },
+	{ userspace_opts_map, userspace_opts_keys }
+};
+
+static int cmp_optmap_keys(const void *a, const void *b)
+{
+	const struct optmap_key *x = a, *y = b;
+	int rc = memcmp(x->name, y->name, min(x->namesz, y->namesz));
+
+	if (rc == 0 && x->namesz != y->namesz)
+		rc = x->namesz < y->namesz ? -1 : 1;
+	if (rc == 0)
+		rc = x->ent < y->ent ? -1 : 1;
+	return rc;
+}
+
+/*
+ * Returns the index for the built-in @map or NULL. The index is built by
+ * the first caller only, other (concurrent) callers use linear search until
+ * the index is ready.
+ */
+static struct optmap_index *get_builtin_index(const struct libmnt_optmap *map)
+{
+	struct optmap_index *idx = NULL;
+	const struct libmnt_optmap *ent;
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(builtin_indexes); i++) {
+		if (builtin_indexes[i].map == map) {
+			idx = &builtin_indexes[i];
+			break;
+		}
+	}
+	if (!idx)
+		return NULL;
+	if (idx->state == 2) {
+		__sync_synchronize();
+		return idx;
+	}
+	if (!__sync_bool_compare_and_swap(&idx->state, 0, 1))
+		return NULL;
+
+	for (ent = map; ent->name; ent++) {
+		struct optmap_key *k;
+
+		if (ent->mask & MNT_PREFIX) {
+			if (!idx->prefix)
+				idx->prefix = ent;
+			continue;
+		}
+		k = &idx->keys[idx->nkeys++];
+		k->name = ent->name;
+		k->namesz = strcspn(ent->name, "=[");
+		k->ent = ent;
+	}
+	qsort(idx->keys, idx->nkeys, sizeof(struct optmap_key), cmp_optmap_keys);
+
+	DBG(OPTIONS, mnt_debug("optmap %p: indexed %zu options",
+				map, idx->nkeys));
+	__sync_synchronize();
+	idx->state = 2;
+	return idx;
+}
+
+static const struct libmnt_optmap *index_get_entry(struct optmap_index *idx,
+				const char *name, size_t namelen)
+{
+	const struct libmnt_optmap *ent = NULL;
+	size_t lo = 0, hi = idx->nkeys;
+
+	/* the first key >= name */
+	while (lo < hi) {
+		size_t mid = (lo + hi) / 2;
+		struct optmap_key *k = &idx->keys[mid];
+		int rc = memcmp(k->name, name, min(k->namesz, namelen));
+
+		if (rc < 0 || (rc == 0 && k->namesz < namelen))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo < idx->nkeys && idx->keys[lo].namesz == namelen &&
+	    memcmp(idx->keys[lo].name, name, namelen) == 0)
+		ent = idx->keys[lo].ent;
+
+	if (idx->prefix && (!ent || idx->prefix < ent)) {
+		const struct libmnt_optmap *p;
+
+		for (p = idx->prefix; p->name && (!ent || p < ent); p++) {
+			if ((p->mask & MNT_PREFIX) && startswith(name, p->name))
+				return p;
+		}
+	}
+	return ent;
+}
+
 /*
  * Lookups for the @name in @maps and returns a map and in @mapent
  * returns the map entry
@@ -207,8 +326,19 @@ const struct libmnt_optmap *mnt_optmap_get_entry(
 	for (i = 0; i < nmaps; i++) {
 		const struct libmnt_optmap *map = maps[i];
 		const struct libmnt_optmap *ent;
+		struct optmap_index *idx = get_builtin_index(map);
 		const char *p;
 
+		if (idx) {
+			ent = index_get_entry(idx, name, namelen);
+			if (ent) {
+				if (mapent)
+					*mapent = ent;
+				return map;
+			}
+			continue;
+		}
+
 		for (ent = map; ent && ent->name; ent++) {
 			if (ent->mask & MNT_PREFIX) {
 				if (startswith(name, ent->name)) {
@@ -230,4 +360,3 @@ const struct libmnt_optmap *mnt_optmap_get_entry(
 	}
 	return NULL;
 }
-
@@ -42,11 +42,32 @@
  * will returns the first entry (if UUID matches with the device).
  */
 #include <blkid.h>
+#include <sys/time.h>
 
 #include "mountP.h"
 #include "strutils.h"
 #include "loopdev.h"
 
+/*
+ * Index of the table entries by source path, used by
+ * mnt_table_is_fs_mounted(). The index is built on demand and dropped
+ * when entries are added to or removed from the table.
+ */
+struct tabidx_ent {
+	unsigned int		hash;
+	struct libmnt_fs	*fs;
+};
+
+struct libmnt_tabidx {
+	size_t			nents;
+	struct tabidx_ent	*ents;		/* sorted by hash */
+
+	size_t			nloops;
+	struct libmnt_fs	**loops;	/* kernel entries with /dev/loopN source */
+};
+
+static void table_free_index(struct libmnt_table *tb);
+
 /**
  * mnt_new_table:
  *
@@ -93,6 +114,7 @@ int mnt_reset_table(struct libmnt_table *tb)
 	}
 
 	tb->nents = 0;
+	table_free_index(tb);
 	return 0;
 }
 
@@ -184,6 +206,7 @@ int mnt_table_add_fs(struct libmnt_table *tb, struct libmnt_fs *fs)
 	DBG(TAB, mnt_debug_h(tb, "add entry: %s %s",
 			mnt_fs_get_source(fs), mnt_fs_get_target(fs)));
 	tb->nents++;
+	table_free_index(tb);
 	return 0;
 }
 
@@ -203,6 +226,7 @@ int mnt_table_remove_fs(struct libmnt_table *tb, struct libmnt_fs *fs)
 		return -EINVAL;
 	list_del(&fs->ents);
 	tb->nents--;
+	table_free_index(tb);
 	return 0;
 }
 
@@ -883,6 +907,113 @@ static int is_mountinfo(struct libmnt_table *tb)
 	return 0;
 }
 
+/* the same as streq_except_trailing_slash(), the last slash is ignored */
+static unsigned int srcpath_hash(const char *path)
+{
+	unsigned int h = 5381;
+	size_t len = strlen(path);
+
+	if (len && path[len - 1] == '/')
+		len--;
+	while (len--)
+		h = (h * 33) ^ (unsigned char) *path++;
+	return h;
+}
+
+static int cmp_tabidx_ents(const void *a, const void *b)
+{
+	unsigned int ha = ((const struct tabidx_ent *) a)->hash,
+		     hb = ((const struct tabidx_ent *) b)->hash;
+
+	return ha < hb ? -1 : ha > hb;
+}
+
+static void table_free_index(struct libmnt_table *tb)
+{
+	if (!tb->srcidx)
+		return;
+
+	DBG(TAB, mnt_debug_h(tb, "drop source index"));
+	free(tb->srcidx->ents);
+	free(tb->srcidx->loops);
+	free(tb->srcidx);
+	tb->srcidx = NULL;
+}
+
+static struct libmnt_tabidx *table_get_index(struct libmnt_table *tb)
+{
+	struct libmnt_tabidx *idx;
+	struct libmnt_iter itr;
+	struct libmnt_fs *fs;
+
+	if (tb->srcidx)
+		return tb->srcidx;
+
+	DBG(TAB, mnt_debug_h(tb, "build source index [%d entries]", tb->nents));
+
+	idx = calloc(1, sizeof(*idx));
+	if (!idx)
+		return NULL;
+	idx->ents = malloc(tb->nents * sizeof(struct tabidx_ent));
+	idx->loops = malloc(tb->nents * sizeof(struct libmnt_fs *));
+	if (!idx->ents || !idx->loops) {
+		free(idx->ents);
+		free(idx->loops);
+		free(idx);
+		return NULL;
+	}
+
+	mnt_reset_iter(&itr, MNT_ITER_FORWARD);
+	while (mnt_table_next_fs(tb, &itr, &fs) == 0) {
+		const char *src = mnt_fs_get_srcpath(fs);
+
+		if (!src)
+			continue;
+		idx->ents[idx->nents].hash = srcpath_hash(src);
+		idx->ents[idx->nents].fs = fs;
+		idx->nents++;
+
+		if (mnt_fs_is_kernel(fs) && startswith(src, "/dev/loop"))
+			idx->loops[idx->nloops++] = fs;
+	}
+
+	qsort(idx->ents, idx->nents, sizeof(struct tabidx_ent), cmp_tabidx_ents);
+
+	tb->srcidx = idx;
+	return idx;
+}
+
+/* returns index entries with the same hash as @src, the number is in @n */
+static struct tabidx_ent *index_lookup(struct libmnt_tabidx *idx,
+				       const char *src, size_t *n)
+{
+	unsigned int h = srcpath_hash(src);
+	size_t lo = 0, hi = idx->nents, i;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (idx->ents[mid].hash < h)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	for (i = lo; i < idx->nents && idx->ents[i].hash == h; i++);
+
+	*n = i - lo;
+	return &idx->ents[lo];
+}
+
+static int is_same_root(struct libmnt_fs *fs, const char *root)
+{
+	const char *r;
+
+	if (!root)
+		return 1;
+	r = mnt_fs_get_root(fs);
+	return r && strcmp(r, root) == 0;
+}
+
 /**
  * mnt_table_is_mounted:
  * @tb: /proc/self/mountinfo file
@@ -899,21 +1030,22 @@ static int is_mountinfo(struct libmnt_table *tb)
  * Don't use it if you want to know if a device is mounted, just use
  * mnt_table_find_source() for the device.
  *
- * This function is designed mostly for "mount -a".
- *
- * TODO: check for loopdev (see mount/mount.c is_fstab_entry_mounted().
+ * This function is designed mostly for "mount -a". The @tb entries are
+ * indexed by source path on the first call; the index is dropped when an
+ * entry is added to or removed from @tb, but it's not updated if you modify
+ * the source of an entry that is already in the table.
  *
  * Returns: 0 or 1
  */
 int mnt_table_is_fs_mounted(struct libmnt_table *tb, struct libmnt_fs *fstab_fs)
 {
-	struct libmnt_iter itr;
-	struct libmnt_fs *fs;
+	struct libmnt_tabidx *idx;
+	struct tabidx_ent *ents;
+	size_t nents = 0, i;
 
 	char *root = NULL;
 	const char *src = NULL, *tgt = NULL;
-	char *xtgt = NULL;
-	int rc = 0;
+	int rc = 0, resolve = 0;
 
 	assert(tb);
 	assert(fstab_fs);
@@ -945,58 +1077,67 @@ int mnt_table_is_fs_mounted(struct libmnt_table *tb, struct libmnt_fs *fstab_fs)
 	if (!tgt || !src)
 		goto done;
 
-	mnt_reset_iter(&itr, MNT_ITER_FORWARD);
+	idx = table_get_index(tb);
+	if (!idx)
+		goto done;
 
-	while (mnt_table_next_fs(tb, &itr, &fs) == 0) {
+	/* 1) the same source and fs-root */
+	ents = index_lookup(idx, src, &nents);
+	for (i = 0; i < nents; i++) {
+		struct libmnt_fs *fs = ents[i].fs;
 
-		if (!mnt_fs_streq_srcpath(fs, src)) {
-			/* The source does not match. Maybe the source is a loop
-			 * device backing file.
-			 */
-			uint64_t offset = 0;
-			char *val;
-			size_t len;
-			int flags;
-
-			if (!mnt_fs_is_kernel(fs) ||
-			    !mnt_fs_get_srcpath(fs) ||
-			    !startswith(mnt_fs_get_srcpath(fs), "/dev/loop"))
-				continue;	/* does not look like loopdev */
-
-			if (mnt_fs_get_option(fstab_fs, "offset", &val, &len) == 0 &&
-			    mnt_parse_offset(val, len, &offset)) {
-				DBG(FS, mnt_debug_h(fstab_fs, "failed to parse offset="));
-				continue;
-			} else
-				flags = LOOPDEV_FL_OFFSET;
+		if (!mnt_fs_streq_srcpath(fs, src) || !is_same_root(fs, root))
+			continue;
+		if (mnt_fs_streq_target(fs, tgt))
+			goto mounted;
+		resolve = 1;
+	}
 
-			if (loopdev_is_used(mnt_fs_get_srcpath(fs), src, offset, flags))
-				break;
+	/* 2) the source does not match. Maybe the source is a loop
+	 *    device backing file.
+	 */
+	if (idx->nloops) {
+		size_t nloops = idx->nloops;
+		uint64_t offset = 0;
+		char *val;
+		size_t len;
+
+		if (mnt_fs_get_option(fstab_fs, "offset", &val, &len) == 0 &&
+		    mnt_parse_offset(val, len, &offset)) {
+			DBG(FS, mnt_debug_h(fstab_fs, "failed to parse offset="));
+			nloops = 0;
 		}
-
-		if (root) {
-			const char *r = mnt_fs_get_root(fs);
-			if (!r || strcmp(r, root) != 0)
-				continue;
+		for (i = 0; i < nloops; i++) {
+			struct libmnt_fs *fs = idx->loops[i];
+
+			if (mnt_fs_streq_srcpath(fs, src))
+				continue;	/* already checked above */
+			if (loopdev_is_used(mnt_fs_get_srcpath(fs), src,
+					    offset, LOOPDEV_FL_OFFSET))
+				goto mounted;
 		}
+	}
 
-		/*
-		 * Compare target, try to minimize number of situations when we
-		 * need to canonicalize the path to avoid readlink() on
-		 * mountpoints.
-		 */
-		if (!xtgt) {
-			if (mnt_fs_streq_target(fs, tgt))
-				break;
-			if (tb->cache)
-				xtgt = mnt_resolve_path(tgt, tb->cache);
+	/*
+	 * 3) the source matches, but the target does not. We canonicalize
+	 *    the target path only here to avoid readlink() on mountpoints
+	 *    as much as possible.
+	 */
+	if (resolve && tb->cache) {
+		char *xtgt = mnt_resolve_path(tgt, tb->cache);
+
+		for (i = 0; xtgt && i < nents; i++) {
+			struct libmnt_fs *fs = ents[i].fs;
+
+			if (mnt_fs_streq_srcpath(fs, src) &&
+			    is_same_root(fs, root) &&
+			    mnt_fs_streq_target(fs, xtgt))
+				goto mounted;
 		}
-		if (xtgt && mnt_fs_streq_target(fs, xtgt))
-			break;
 	}
-
-	if (fs)
-		rc = 1;		/* success */
+	goto done;
+mounted:
+	rc = 1;		/* success */
 done:
 	free(root);
 
@@ -1214,6 +1355,89 @@ done:
 	return rc;
 }
 
+static struct libmnt_fs *new_bench_fs(int n, int kernel)
+{
+	struct libmnt_fs *fs = mnt_new_fs();
+	char buf[64];
+
+	if (!fs)
+		return NULL;
+	snprintf(buf, sizeof(buf), "/dev/bench%d", n);
+	mnt_fs_set_source(fs, buf);
+	snprintf(buf, sizeof(buf), "/mnt/bench%d", n);
+	mnt_fs_set_target(fs, buf);
+	mnt_fs_set_fstype(fs, "ext4");
+	if (kernel) {
+		mnt_fs_set_root(fs, "/");
+		fs->flags |= MNT_FS_KERNEL;
+	}
+	return fs;
+}
+
+static double bench_now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+/*
+ * Creates mountinfo-like table with <nmounts> entries and fstab with <nfstab>
+ * entries (every second is mounted) and compares mnt_table_is_fs_mounted()
+ * with the plain scan of the table.
+ */
+static int test_is_mounted_bench(struct libmnt_test *ts, int argc, char *argv[])
+{
+	struct libmnt_table *tb, *fstab;
+	struct libmnt_iter itr, itr2;
+	struct libmnt_fs *fs, *x;
+	int nmounts, nfstab, i, rc = -1;
+	size_t found = 0, found_scan = 0;
+	double t;
+
+	if (argc < 3)
+		return -EINVAL;
+	nmounts = atoi(argv[1]);
+	nfstab = atoi(argv[2]);
+
+	tb = mnt_new_table();
+	fstab = mnt_new_table();
+	if (!tb || !fstab)
+		goto done;
+
+	for (i = 0; i < nmounts; i++)
+		mnt_table_add_fs(tb, new_bench_fs(i, 1));
+	for (i = 0; i < nfstab; i++)
+		mnt_table_add_fs(fstab, new_bench_fs(i % 2 ? i : nmounts + i, 0));
+
+	t = bench_now();
+	mnt_reset_iter(&itr, MNT_ITER_FORWARD);
+	while (mnt_table_next_fs(fstab, &itr, &fs) == 0)
+		found += mnt_table_is_fs_mounted(tb, fs);
+	printf("index: %zu mounted, %.3f s\n", found, bench_now() - t);
+
+	t = bench_now();
+	mnt_reset_iter(&itr, MNT_ITER_FORWARD);
+	while (mnt_table_next_fs(fstab, &itr, &fs) == 0) {
+		mnt_reset_iter(&itr2, MNT_ITER_FORWARD);
+		while (mnt_table_next_fs(tb, &itr2, &x) == 0) {
+			if (mnt_fs_streq_srcpath(x, mnt_fs_get_srcpath(fs)) &&
+			    mnt_fs_streq_target(x, mnt_fs_get_target(fs))) {
+				found_scan++;
+				break;
+			}
+		}
+	}
+	printf("scan:  %zu mounted, %.3f s\n", found_scan, bench_now() - t);
+
+	rc = found == found_scan ? 0 : -1;
+done:
+	mnt_free_table(tb);
+	mnt_free_table(fstab);
+	return rc;
+}
+
 int main(int argc, char *argv[])
 {
 	struct libmnt_test tss[] = {
@@ -1223,6 +1447,7 @@ int main(int argc, char *argv[])
 	{ "--find-pair",     test_find_pair, "<file> <source> <target>" },
 	{ "--copy-fs",       test_copy_fs, "<file>  copy root FS from the file" },
 	{ "--is-mounted",    test_is_mounted, "<fstab> check what from <file> are already mounted" },
+	{ "--is-mounted-bench", test_is_mounted_bench, "<nmounts> <nfstab>  is-mounted with synthetic tables" },
 	{ NULL }
 	};
 
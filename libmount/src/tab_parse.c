@@ -369,6 +369,10 @@ next_line:
 			if (feof(f)) {
 				DBG(TAB, mnt_debug_h(tb,
 					"%s: no final newline",	filename));
+				/* utab entries are appended without lock
+				 * for readers, ignore incomplete entry */
+				if (tb->fmt == MNT_FMT_UTAB)
+					return 1;
 				s = strchr (buf, '\0');
 			} else {
 				DBG(TAB, mnt_debug_h(tb,
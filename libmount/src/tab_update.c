@@ -25,6 +25,7 @@
 #include "mountP.h"
 #include "mangle.h"
 #include "pathnames.h"
+#include "all-io.h"
 
 struct libmnt_update {
 	char		*target;
@@ -438,10 +439,54 @@ static int fprintf_mtab_fs(FILE *f, struct libmnt_fs *fs)
 	return rc;
 }
 
+/*
+ * Returns utab line for @fs (terminated by '\n') in newly allocated buffer.
+ */
+static char *utab_fs_to_line(struct libmnt_fs *fs, size_t *len)
+{
+	static const char *names[] = {
+		"SRC=", "TARGET=", "ROOT=", "BINDSRC=", "ATTRS=", "OPTS="
+	};
+	char *vals[ARRAY_SIZE(names)];
+	char *line = NULL, *p;
+	size_t i, sz = 2;
+
+	vals[0] = mangle(mnt_fs_get_source(fs));
+	vals[1] = mangle(mnt_fs_get_target(fs));
+	vals[2] = mangle(mnt_fs_get_root(fs));
+	vals[3] = mangle(mnt_fs_get_bindsrc(fs));
+	vals[4] = mangle(mnt_fs_get_attributes(fs));
+	vals[5] = mangle(mnt_fs_get_user_options(fs));
+
+	for (i = 0; i < ARRAY_SIZE(names); i++) {
+		if (vals[i])
+			sz += strlen(names[i]) + strlen(vals[i]) + 1;
+	}
+
+	line = malloc(sz);
+	if (!line)
+		goto done;
+
+	p = line;
+	for (i = 0; i < ARRAY_SIZE(names); i++) {
+		if (vals[i])
+			p += sprintf(p, "%s%s%s", names[i], vals[i],
+					i < ARRAY_SIZE(names) - 1 ? " " : "");
+	}
+	*p++ = '\n';
+	*p = '\0';
+	*len = p - line;
+done:
+	for (i = 0; i < ARRAY_SIZE(names); i++)
+		free(vals[i]);
+	return line;
+}
+
 static int fprintf_utab_fs(FILE *f, struct libmnt_fs *fs)
 {
-	char *p;
-	int rc = 0;
+	char *line;
+	size_t len = 0;
+	int rc;
 
 	assert(fs);
 	assert(f);
@@ -449,51 +494,56 @@ static int fprintf_utab_fs(FILE *f, struct libmnt_fs *fs)
 	if (!fs || !f)
 		return -EINVAL;
 
-	p = mangle(mnt_fs_get_source(fs));
-	if (p) {
-		rc = fprintf(f, "SRC=%s ", p);
-		free(p);
-	}
-	if (rc >= 0) {
-		p = mangle(mnt_fs_get_target(fs));
-		if (p) {
-			rc = fprintf(f, "TARGET=%s ", p);
-			free(p);
-		}
-	}
-	if (rc >= 0) {
-		p = mangle(mnt_fs_get_root(fs));
-		if (p) {
-			rc = fprintf(f, "ROOT=%s ", p);
-			free(p);
-		}
-	}
-	if (rc >= 0) {
-		p = mangle(mnt_fs_get_bindsrc(fs));
-		if (p) {
-			rc = fprintf(f, "BINDSRC=%s ", p);
-			free(p);
-		}
+	line = utab_fs_to_line(fs, &len);
+	if (!line)
+		return -ENOMEM;
+
+	rc = fwrite(line, 1, len, f) == len ? 0 : -errno;
+	free(line);
+	return rc;
+}
+
+/*
+ * Appends @line to utab by one write(2). Returns 1 if the file does not
+ * exist, then the caller has to write the whole file by update_table().
+ *
+ * Readers don't use the lock. We rely on the single small O_APPEND write
+ * being atomic; for a short write (and before the rollback) the reader
+ * ignores the last line without the final newline, see
+ * mnt_table_parse_next().
+ */
+static int utab_append(struct libmnt_update *upd, const char *line, size_t len)
+{
+	struct stat st;
+	char last;
+	int fd, rc;
+
+	fd = open(upd->filename, O_RDWR|O_APPEND|O_CLOEXEC);
+	if (fd < 0) {
+		DBG(UPDATE, mnt_debug_h(upd, "%s: open failed: %m", upd->filename));
+		return 1;
 	}
-	if (rc >= 0) {
-		p = mangle(mnt_fs_get_attributes(fs));
-		if (p) {
-			rc = fprintf(f, "ATTRS=%s ", p);
-			free(p);
-		}
+	/* incomplete last line (e.g. after crash), rewrite the file */
+	if (fstat(fd, &st) != 0 ||
+	    (st.st_size > 0 &&
+	     (pread(fd, &last, 1, st.st_size - 1) != 1 || last != '\n'))) {
+		close(fd);
+		return 1;
 	}
-	if (rc >= 0) {
-		p = mangle(mnt_fs_get_user_options(fs));
-		if (p) {
-			rc = fprintf(f, "OPTS=%s", p);
-			free(p);
-		}
+
+	if (write_all(fd, line, len) != 0) {
+		rc = -errno;
+		DBG(UPDATE, mnt_debug_h(upd, "%s: append failed: %m", upd->filename));
+		/* don't leave a partial line in the file */
+		if (ftruncate(fd, st.st_size) != 0)
+			DBG(UPDATE, mnt_debug_h(upd, "%s: truncate failed: %m",
+						upd->filename));
+	} else {
+		DBG(UPDATE, mnt_debug_h(upd, "%s: appended", upd->filename));
+		rc = 0;
 	}
-	if (rc >= 0)
-		rc = fprintf(f, "\n");
 
-	if (rc > 0)
-		rc = 0;	/* success */
+	close(fd);
 	return rc;
 }
 
@@ -575,7 +625,7 @@ static int add_file_entry(struct libmnt_table *tb, struct libmnt_update *upd)
 
 static int update_add_entry(struct libmnt_update *upd, struct libmnt_lock *lc)
 {
-	struct libmnt_table *tb;
+	struct libmnt_table *tb = NULL;
 	int rc = 0;
 
 	assert(upd);
@@ -588,10 +638,22 @@ static int update_add_entry(struct libmnt_update *upd, struct libmnt_lock *lc)
 	if (rc)
 		return rc;
 
+	if (upd->userspace_only) {
+		size_t len = 0;
+		char *line = utab_fs_to_line(upd->fs, &len);
+
+		rc = line ? utab_append(upd, line, len) : -ENOMEM;
+		free(line);
+		if (rc != 1)
+			goto done;
+		rc = 0;
+	}
+
 	tb = __mnt_new_table_from_file(upd->filename,
 			upd->userspace_only ? MNT_FMT_UTAB : MNT_FMT_MTAB);
 	if (tb)
 		rc = add_file_entry(tb, upd);
+done:
 	if (lc)
 		mnt_unlock_file(lc);
 
@@ -614,6 +676,10 @@ static int update_remove_entry(struct libmnt_update *upd, struct libmnt_lock *lc
 	if (rc)
 		return rc;
 
+	/*
+	 * The file is always rewritten, older libmount versions would not
+	 * recognize any remove record and use the removed entry.
+	 */
 	tb = __mnt_new_table_from_file(upd->filename,
 			upd->userspace_only ? MNT_FMT_UTAB : MNT_FMT_MTAB);
 	if (tb) {
@@ -759,6 +825,67 @@ int mnt_update_table(struct libmnt_update *upd, struct libmnt_lock *lc)
 	return rc;
 }
 
+/*
+ * Removes the last entry for each of @targets from mtab/utab, the file is
+ * locked, read and rewritten only once. The @upd filename has to be set.
+ */
+int mnt_update_remove_targets(struct libmnt_update *upd,
+			      const char **targets, size_t ntargets,
+			      struct libmnt_lock *lc)
+{
+	struct libmnt_lock *lc0 = lc;
+	struct libmnt_table *tb = NULL;
+	size_t i, nrem = 0;
+	int rc = 0;
+
+	assert(upd);
+
+	if (!upd || !upd->filename || (ntargets && !targets))
+		return -EINVAL;
+	if (!ntargets)
+		return 0;
+
+	DBG(UPDATE, mnt_debug_h(upd, "%s: remove %zu entries",
+				upd->filename, ntargets));
+	if (!lc) {
+		lc = mnt_new_lock(upd->filename, 0);
+		if (lc)
+			mnt_lock_block_signals(lc, TRUE);
+	}
+	if (lc && upd->userspace_only)
+		mnt_lock_use_simplelock(lc, TRUE);	/* use flock */
+	if (lc)
+		rc = mnt_lock_file(lc);
+	if (rc)
+		goto done;
+
+	tb = __mnt_new_table_from_file(upd->filename,
+			upd->userspace_only ? MNT_FMT_UTAB : MNT_FMT_MTAB);
+	if (tb) {
+		for (i = 0; i < ntargets; i++) {
+			struct libmnt_fs *rem = mnt_table_find_target(tb,
+					targets[i], MNT_ITER_BACKWARD);
+			if (!rem)
+				continue;
+			mnt_table_remove_fs(tb, rem);
+			mnt_free_fs(rem);
+			nrem++;
+		}
+		if (nrem)
+			rc = update_table(upd, tb);
+	}
+
+	if (lc)
+		mnt_unlock_file(lc);
+done:
+	DBG(UPDATE, mnt_debug_h(upd, "%s: removed %zu entries [rc=%d]",
+				upd->filename, nrem, rc));
+	if (lc != lc0)
+		mnt_free_lock(lc);
+	mnt_free_table(tb);
+	return rc;
+}
+
 #ifdef TEST_PROGRAM
 
 static int update(const char *target, struct libmnt_fs *fs, unsigned long mountflags)
@@ -815,6 +942,47 @@ static int test_remove(struct libmnt_test *ts, int argc, char *argv[])
 	return update(argv[1], NULL, 0);
 }
 
+static int test_remove_targets(struct libmnt_test *ts, int argc, char *argv[])
+{
+	struct libmnt_update *upd;
+	int rc;
+
+	if (argc < 2)
+		return -1;
+	upd = mnt_new_update();
+	if (!upd)
+		return -ENOMEM;
+
+	rc = mnt_update_set_filename(upd, NULL, 0);
+	if (!rc)
+		rc = mnt_update_remove_targets(upd, (const char **) argv + 1,
+					       argc - 1, NULL);
+	mnt_free_update(upd);
+	return rc;
+}
+
+static int test_parse_utab(struct libmnt_test *ts, int argc, char *argv[])
+{
+	struct libmnt_table *tb;
+	struct libmnt_iter itr;
+	struct libmnt_fs *fs;
+
+	if (argc < 2)
+		return -1;
+	tb = __mnt_new_table_from_file(argv[1], MNT_FMT_UTAB);
+	if (!tb)
+		return -1;
+
+	mnt_reset_iter(&itr, MNT_ITER_FORWARD);
+	while (mnt_table_next_fs(tb, &itr, &fs) == 0)
+		printf("%s %s %s %s\n", mnt_fs_get_source(fs),
+				mnt_fs_get_target(fs), mnt_fs_get_root(fs),
+				mnt_fs_get_user_options(fs));
+
+	mnt_free_table(tb);
+	return 0;
+}
+
 static int test_move(struct libmnt_test *ts, int argc, char *argv[])
 {
 	struct libmnt_fs *fs = mnt_new_fs();
@@ -851,8 +1019,10 @@ int main(int argc, char *argv[])
 	struct libmnt_test tss[] = {
 	{ "--add",    test_add,     "<src> <target> <type> <options>  add line to mtab" },
 	{ "--remove", test_remove,  "<target>                      MS_REMOUNT mtab change" },
+	{ "--remove-targets", test_remove_targets, "<target> [...]  remove more targets at once" },
 	{ "--move",   test_move,    "<old_target>  <target>        MS_MOVE mtab change" },
 	{ "--remount",test_remount, "<target>  <options>           MS_REMOUNT mtab change" },
+	{ "--parse-utab", test_parse_utab, "<file>                  parse utab and print entries" },
 	{ NULL }
 	};
 
@@ -54,6 +54,26 @@ int startswith(const char *s, const char *sx)
         return !strncmp(s, sx, off);
 }
 
+/*
+ * Returns 1 if @path is @dir or any path below @dir. Only absolute paths are
+ * compared.
+ */
+int mnt_path_is_under(const char *dir, const char *path)
+{
+	size_t len;
+
+	if (!dir || !path || *dir != '/' || *path != '/')
+		return 0;
+
+	len = strlen(dir);
+	while (len > 1 && dir[len - 1] == '/')
+		len--;
+	if (strncmp(dir, path, len) != 0)
+		return 0;
+
+	return path[len] == '\0' || path[len] == '/' || len == 1;
+}
+
 int mnt_parse_offset(const char *str, size_t len, uintmax_t *res)
 {
 	char *p;
@@ -398,6 +418,254 @@ int mnt_match_options(const char *optstr, const char *pattern)
 	return 1;
 }
 
+/*
+ * Compiled fstype or options pattern. The pattern items are stored in a hash
+ * table, the matching functions don't parse the pattern again.
+ */
+struct pattern_ent {
+	const char	*name;		/* points to libmnt_pattern->buf */
+	size_t		len;
+	size_t		next;		/* next entry (+1) in the hash chain */
+	int		value;		/* fstype: result; options: 1 = wanted */
+	size_t		reqidx;		/* options: index of the wanted item */
+};
+
+struct libmnt_pattern {
+	int			type;		/* MNT_PATTERN_* */
+	int			no;		/* fstype: global "no" prefix */
+	int			never;		/* options: "foo,nofoo" */
+
+	char			*buf;		/* copy of the pattern */
+	struct pattern_ent	*ents;
+	size_t			nents;
+	size_t			nreq;		/* options: wanted items */
+
+	size_t			*hash;		/* chain heads (entry index + 1) */
+	size_t			nbuckets;
+};
+
+static unsigned int pattern_hash(const char *name, size_t len)
+{
+	unsigned int h = 5381;
+
+	while (len--)
+		h = (h * 33) ^ (unsigned char) *name++;
+	return h;
+}
+
+static struct pattern_ent *pattern_lookup(struct libmnt_pattern *pat,
+					  const char *name, size_t len)
+{
+	size_t i = pat->hash[pattern_hash(name, len) % pat->nbuckets];
+
+	for (; i; i = pat->ents[i - 1].next) {
+		struct pattern_ent *e = &pat->ents[i - 1];
+
+		if (e->len == len && strncmp(e->name, name, len) == 0)
+			return e;
+	}
+	return NULL;
+}
+
+/* the first item wins, returns the already stored entry for duplicates */
+static struct pattern_ent *pattern_add(struct libmnt_pattern *pat,
+				       const char *name, size_t len, int value)
+{
+	struct pattern_ent *e = pattern_lookup(pat, name, len);
+	size_t b;
+
+	if (e)
+		return e;
+
+	e = &pat->ents[pat->nents++];
+	e->name = name;
+	e->len = len;
+	e->value = value;
+
+	b = pattern_hash(name, len) % pat->nbuckets;
+	e->next = pat->hash[b];
+	pat->hash[b] = pat->nents;
+	return e;
+}
+
+/**
+ * mnt_new_pattern:
+ * @type: MNT_PATTERN_FSTYPE or MNT_PATTERN_OPTIONS
+ * @pattern: comma delimited list of filesystem types or options
+ *
+ * Compiles the @pattern; mnt_pattern_match() then returns the same results
+ * as mnt_match_fstype() or mnt_match_options(), but it does not parse the
+ * pattern for each call. Use it if the same pattern is matched against
+ * many filesystems.
+ *
+ * Returns: new pattern or NULL in case of error.
+ */
+struct libmnt_pattern *mnt_new_pattern(int type, const char *pattern)
+{
+	struct libmnt_pattern *pat;
+	size_t n = 2;
+	char *p, *end;
+
+	if (!pattern ||
+	    (type != MNT_PATTERN_FSTYPE && type != MNT_PATTERN_OPTIONS))
+		return NULL;
+
+	pat = calloc(1, sizeof(*pat));
+	if (!pat)
+		return NULL;
+
+	pat->type = type;
+	pat->buf = strdup(pattern);
+	if (!pat->buf)
+		goto err;
+
+	for (p = pat->buf; *p; p++) {
+		if (*p == ',')
+			n++;
+	}
+	/* fstype items may be stored twice (as "foo" and "nofoo") */
+	pat->ents = calloc(2 * n, sizeof(struct pattern_ent));
+	pat->nbuckets = 2 * n;
+	pat->hash = calloc(pat->nbuckets, sizeof(size_t));
+	if (!pat->ents || !pat->hash)
+		goto err;
+
+	p = pat->buf;
+	if (type == MNT_PATTERN_FSTYPE && !strncmp(p, "no", 2)) {
+		pat->no = 1;
+		p += 2;
+	}
+
+	for (end = p + strlen(p); p <= end; p++) {
+		char *sep = strchr(p, ',');
+		size_t plen = sep ? (size_t) (sep - p) : (size_t) (end - p);
+
+		if (type == MNT_PATTERN_FSTYPE) {
+			/* see match_fstype(): "nofoo" item, then "foo" item */
+			if (plen >= 2 && !strncmp(p, "no", 2))
+				pattern_add(pat, p + 2, plen - 2, 0);
+			pattern_add(pat, p, plen, !pat->no);
+
+		} else if (plen) {
+			/* see check_option() */
+			struct pattern_ent *e;
+			const char *name = p;
+			size_t len = plen, nents = pat->nents;
+			int want = 1;
+
+			if (*name == '+') {
+				name++;
+				len--;
+			} else if (len >= 2 && !strncmp(name, "no", 2)) {
+				want = 0;
+				name += 2;
+				len -= 2;
+			}
+			e = pattern_add(pat, name, len, want);
+			if (e->value != want)
+				pat->never = 1;
+			else if (want && pat->nents > nents)
+				e->reqidx = pat->nreq++;
+		}
+		p += plen;
+	}
+
+	DBG(UTILS, mnt_debug("compiled %s pattern '%s' [%zu items]",
+		type == MNT_PATTERN_FSTYPE ? "fstype" : "options",
+		pattern, pat->nents));
+	return pat;
+err:
+	mnt_free_pattern(pat);
+	return NULL;
+}
+
+/**
+ * mnt_free_pattern:
+ * @pat: pattern
+ *
+ * Deallocates the pattern.
+ */
+void mnt_free_pattern(struct libmnt_pattern *pat)
+{
+	if (!pat)
+		return;
+	free(pat->hash);
+	free(pat->ents);
+	free(pat->buf);
+	free(pat);
+}
+
+/**
+ * mnt_pattern_get_type:
+ * @pat: pattern
+ *
+ * Returns: MNT_PATTERN_FSTYPE, MNT_PATTERN_OPTIONS or negative number in case
+ * of error.
+ */
+int mnt_pattern_get_type(struct libmnt_pattern *pat)
+{
+	return pat ? pat->type : -EINVAL;
+}
+
+/**
+ * mnt_pattern_match:
+ * @pat: pattern from mnt_new_pattern()
+ * @str: filesystem type or options string
+ *
+ * Returns: 1 if @str is matching, else 0.
+ */
+int mnt_pattern_match(struct libmnt_pattern *pat, const char *str)
+{
+	unsigned char seenbuf[64], *seen = seenbuf;
+	size_t len, nseen = 0;
+	const char *p;
+	int rc = 0;
+
+	if (!pat)
+		return 0;
+
+	if (pat->type == MNT_PATTERN_FSTYPE) {
+		struct pattern_ent *e;
+
+		if (!str)
+			return pat->no;
+		e = pattern_lookup(pat, str, strlen(str));
+		return e ? e->value : pat->no;
+	}
+
+	if (pat->never)
+		return 0;
+	if (!str)
+		return pat->nreq == 0;
+
+	if (pat->nreq > sizeof(seenbuf)) {
+		seen = calloc(pat->nreq, 1);
+		if (!seen)
+			return 0;
+	} else
+		memset(seen, 0, pat->nreq);
+
+	len = strlen(str);
+	for (p = str; p < str + len; p++) {
+		char *sep = strchr(p, ',');
+		size_t plen = sep ? (size_t) (sep - p) : len - (p - str);
+		struct pattern_ent *e = pattern_lookup(pat, p, plen);
+
+		if (e && !e->value)
+			goto done;		/* unwanted option found */
+		if (e && !seen[e->reqidx]) {
+			seen[e->reqidx] = 1;
+			nseen++;
+		}
+		p += plen;
+	}
+	rc = nseen == pat->nreq;
+done:
+	if (seen != seenbuf)
+		free(seen);
+	return rc;
+}
+
 void mnt_free_filesystems(char **filesystems)
 {
 	char **p;
@@ -882,22 +1150,38 @@ char *mnt_get_fs_root(const char *path, const char *mnt)
 }
 
 #ifdef TEST_PROGRAM
+/* the compiled pattern has to return the same result */
+static int test_match_pattern(int type, const char *str, const char *pattern,
+			      int rc)
+{
+	struct libmnt_pattern *pat = mnt_new_pattern(type, pattern);
+
+	if (!pat)
+		return -ENOMEM;
+	if (mnt_pattern_match(pat, str) != rc)
+		printf("compiled pattern mismatch\n");
+	mnt_free_pattern(pat);
+	return 0;
+}
+
 int test_match_fstype(struct libmnt_test *ts, int argc, char *argv[])
 {
 	char *type = argv[1];
 	char *pattern = argv[2];
+	int rc = mnt_match_fstype(type, pattern);
 
-	printf("%s\n", mnt_match_fstype(type, pattern) ? "MATCH" : "NOT-MATCH");
-	return 0;
+	printf("%s\n", rc ? "MATCH" : "NOT-MATCH");
+	return test_match_pattern(MNT_PATTERN_FSTYPE, type, pattern, rc);
 }
 
 int test_match_options(struct libmnt_test *ts, int argc, char *argv[])
 {
 	char *optstr = argv[1];
 	char *pattern = argv[2];
+	int rc = mnt_match_options(optstr, pattern);
 
-	printf("%s\n", mnt_match_options(optstr, pattern) ? "MATCH" : "NOT-MATCH");
-	return 0;
+	printf("%s\n", rc ? "MATCH" : "NOT-MATCH");
+	return test_match_pattern(MNT_PATTERN_OPTIONS, optstr, pattern, rc);
 }
 
 int test_startswith(struct libmnt_test *ts, int argc, char *argv[])
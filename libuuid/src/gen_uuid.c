@@ -86,6 +86,8 @@
 #if defined(__linux__) && defined(HAVE_SYS_SYSCALL_H)
 #include <sys/syscall.h>
 #endif
+#include <pthread.h>
+#include <sched.h>
 
 #include "all-io.h"
 #include "uuidP.h"
@@ -397,40 +399,157 @@ static int get_uuid_via_daemon(int op, uuid_t out, int *num)
 }
 #endif
 
-int __uuid_generate_time(uuid_t out, int *num)
+static unsigned char node_id[6];
+static int node_id_init;
+
+static void init_node_id(void)
+{
+	if (node_id_init)
+		return;
+	if (get_node_id(node_id) <= 0) {
+		random_get_bytes(node_id, 6);
+		/*
+		 * Set multicast bit, to prevent conflicts
+		 * with IEEE 802 addresses obtained from
+		 * network cards
+		 */
+		node_id[0] |= 0x01;
+	}
+	node_id_init = 1;
+}
+
+static void pack_time_uuid(uuid_t out, uint64_t clock_reg, uint16_t clock_seq)
 {
-	static unsigned char node_id[6];
-	static int has_init = 0;
 	struct uuid uu;
-	uint32_t	clock_mid;
-	int ret;
 
-	if (!has_init) {
-		if (get_node_id(node_id) <= 0) {
-			random_get_bytes(node_id, 6);
-			/*
-			 * Set multicast bit, to prevent conflicts
-			 * with IEEE 802 addresses obtained from
-			 * network cards
-			 */
-			node_id[0] |= 0x01;
-		}
-		has_init = 1;
-	}
-	ret = get_clock(&clock_mid, &uu.time_low, &uu.clock_seq, num);
-	uu.clock_seq |= 0x8000;
-	uu.time_mid = (uint16_t) clock_mid;
-	uu.time_hi_and_version = ((clock_mid >> 16) & 0x0FFF) | 0x1000;
+	uu.time_low = (uint32_t) clock_reg;
+	uu.time_mid = (uint16_t) (clock_reg >> 32);
+	uu.time_hi_and_version = ((clock_reg >> 48) & 0x0FFF) | 0x1000;
+	uu.clock_seq = clock_seq | 0x8000;
 	memcpy(uu.node, node_id, 6);
 	uuid_pack(&uu, out);
+}
+
+int __uuid_generate_time(uuid_t out, int *num)
+{
+	uint32_t clock_high, clock_low;
+	uint16_t clock_seq;
+	int ret;
+
+	init_node_id();
+	ret = get_clock(&clock_high, &clock_low, &clock_seq, num);
+	pack_time_uuid(out, ((uint64_t) clock_high << 32) | clock_low, clock_seq);
 	return ret;
 }
 
+/*
+ * In-process time-based UUIDs.
+ *
+ * A range of clock ticks is reserved from the global clock state by one
+ * get_clock() call (the same way uuidd reserves bulk requests) and all
+ * threads generate UUIDs from the range by an atomic increment. The clock
+ * state file is locked and rewritten only when the range is exhausted or
+ * expired. The size of the range grows while the ranges are used up within
+ * their lifetime, so heavy users lock the file rarely.
+ *
+ * The range is guarded by a sequence counter, odd value means that a thread
+ * is refilling the range.
+ */
+#define CLOCK_RANGE_MIN		1000
+#define CLOCK_RANGE_MAX		100000
+#define CLOCK_RANGE_LIFETIME	1	/* seconds */
+
+static struct {
+	volatile unsigned int	seq;		/* sequence counter */
+	volatile unsigned int	used;		/* number of consumed ticks */
+	unsigned int		size;		/* number of reserved ticks */
+	uint64_t		start;		/* the first reserved tick */
+	uint16_t		clock_seq;
+	time_t			expire;
+	int			ret;		/* get_clock() return code */
+	int			atfork;
+} clock_range;
+
+/* the child must not generate the same UUIDs as the parent */
+static void clock_range_atfork_child(void)
+{
+	clock_range.seq = (clock_range.seq | 1) + 1;
+	clock_range.used = clock_range.size = 0;
+}
+
+/* called with odd clock_range.seq */
+static void clock_range_refill(time_t now)
+{
+	uint32_t clock_high, clock_low;
+	int num;
+
+	if (!clock_range.atfork) {
+		pthread_atfork(NULL, NULL, clock_range_atfork_child);
+		clock_range.atfork = 1;
+	}
+	init_node_id();
+
+	if (clock_range.size && clock_range.used >= clock_range.size &&
+	    now <= clock_range.expire)
+		num = min(clock_range.size * 2, (unsigned int) CLOCK_RANGE_MAX);
+	else
+		num = CLOCK_RANGE_MIN;
+
+	clock_range.ret = get_clock(&clock_high, &clock_low,
+				    &clock_range.clock_seq, &num);
+	clock_range.start = ((uint64_t) clock_high << 32) | clock_low;
+	clock_range.size = num;
+	clock_range.expire = now + CLOCK_RANGE_LIFETIME;
+	clock_range.used = 0;
+}
+
+static int uuid_generate_time_local(uuid_t out)
+{
+	for (;;) {
+		unsigned int seq = clock_range.seq;
+		time_t now = time(NULL);
+
+		if (!(seq & 1)) {
+			uint64_t start;
+			uint16_t clock_seq;
+			unsigned int n, size;
+			int ret;
+
+			__sync_synchronize();
+			start = clock_range.start;
+			size = clock_range.size;
+			clock_seq = clock_range.clock_seq;
+			ret = clock_range.ret;
+
+			/* full barrier, the range has to be read before */
+			n = __sync_fetch_and_add(&clock_range.used, 1);
+
+			if (clock_range.seq == seq) {
+				if (n < size && now <= clock_range.expire) {
+					pack_time_uuid(out, start + n, clock_seq);
+					return ret;
+				}
+				/* exhausted or expired, refill */
+				if (__sync_bool_compare_and_swap(&clock_range.seq,
+							seq, seq + 1)) {
+					clock_range_refill(now);
+					__sync_synchronize();
+					clock_range.seq = seq + 2;
+				}
+				continue;
+			}
+		}
+		/* another thread is refilling the range */
+		sched_yield();
+	}
+}
+
 /*
  * Generate time-based UUID and store it to @out
  *
  * Tries to guarantee uniqueness of the generated UUIDs by obtaining them from the uuidd daemon,
- * or, if uuidd is not usable, by using the global clock state counter (see get_clock()).
+ * or, if uuidd is not usable, by using a range reserved from the global clock state counter
+ * (see get_clock() and uuid_generate_time_local()).
  * If neither of these is possible (e.g. because of insufficient permissions), it generates
  * the UUID anyway, but returns -1. Otherwise, returns 0.
  */
@@ -439,6 +558,7 @@ static int uuid_generate_time_generic(uuid_t out) {
 	THREAD_LOCAL int		num = 0;
 	THREAD_LOCAL struct uuid	uu;
 	THREAD_LOCAL time_t		last_time = 0;
+	THREAD_LOCAL time_t		daemon_retry = 0;
 	time_t				now;
 
 	if (num > 0) {
@@ -446,7 +566,8 @@ static int uuid_generate_time_generic(uuid_t out) {
 		if (now > last_time+1)
 			num = 0;
 	}
-	if (num <= 0) {
+	/* don't try to connect to the (not running) daemon for every UUID */
+	if (num <= 0 && (now = time(0)) >= daemon_retry) {
 		num = 1000;
 		if (get_uuid_via_daemon(UUIDD_OP_BULK_TIME_UUID,
 					out, &num) == 0) {
@@ -456,6 +577,7 @@ static int uuid_generate_time_generic(uuid_t out) {
 			return 0;
 		}
 		num = 0;
+		daemon_retry = now + 1;
 	}
 	if (num > 0) {
 		uu.time_low++;
@@ -473,7 +595,7 @@ static int uuid_generate_time_generic(uuid_t out) {
 		return 0;
 #endif
 
-	return __uuid_generate_time(out, 0);
+	return uuid_generate_time_local(out);
 }
 
 /*
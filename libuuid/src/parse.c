@@ -33,47 +33,87 @@
  */
 
 #include <stdlib.h>
-#include <stdio.h>
-#include <ctype.h>
 #include <string.h>
 
 #include "uuidP.h"
 
-int uuid_parse(const char *in, uuid_t uu)
+/*
+ * Hex digit values, zero for all other characters (so '0' has to be
+ * checked separately).
+ */
+static const unsigned char hexval[256] = {
+	['0'] = 0x00, ['1'] = 0x01, ['2'] = 0x02, ['3'] = 0x03,
+	['4'] = 0x04, ['5'] = 0x05, ['6'] = 0x06, ['7'] = 0x07,
+	['8'] = 0x08, ['9'] = 0x09,
+	['a'] = 0x0a, ['b'] = 0x0b, ['c'] = 0x0c, ['d'] = 0x0d,
+	['e'] = 0x0e, ['f'] = 0x0f,
+	['A'] = 0x0a, ['B'] = 0x0b, ['C'] = 0x0c, ['D'] = 0x0d,
+	['E'] = 0x0e, ['F'] = 0x0f
+};
+
+/* offsets of the hex digit pairs in the string, the dashes are skipped */
+static const unsigned char pairpos[16] = {
+	0, 2, 4, 6, 9, 11, 14, 16, 19, 21, 24, 26, 28, 30, 32, 34
+};
+
+static inline int is_hexdigit(unsigned char c)
 {
-	struct uuid	uuid;
-	int 		i;
-	const char	*cp;
-	char		buf[3];
+	return c == '0' || hexval[c] != 0;
+}
 
-	if (strlen(in) != 36)
+/*
+ * The bytes of the binary UUID are in the same order as the hex digits in
+ * the string, so every pair of digits is decoded by two table lookups.
+ * Invalid digits are detected with a single test after the loop.
+ */
+static int parse_one(const char *in, uuid_t uu)
+{
+	const unsigned char *cp = (const unsigned char *) in;
+	unsigned int bad = 0;
+	int i;
+
+	if (cp[8] != '-' || cp[13] != '-' || cp[18] != '-' || cp[23] != '-')
 		return -1;
-	for (i=0, cp = in; i <= 36; i++,cp++) {
-		if ((i == 8) || (i == 13) || (i == 18) ||
-		    (i == 23)) {
-			if (*cp == '-')
-				continue;
-			else
-				return -1;
-		}
-		if (i== 36)
-			if (*cp == 0)
-				continue;
-		if (!isxdigit(*cp))
-			return -1;
-	}
-	uuid.time_low = strtoul(in, NULL, 16);
-	uuid.time_mid = strtoul(in+9, NULL, 16);
-	uuid.time_hi_and_version = strtoul(in+14, NULL, 16);
-	uuid.clock_seq = strtoul(in+19, NULL, 16);
-	cp = in+24;
-	buf[2] = 0;
-	for (i=0; i < 6; i++) {
-		buf[0] = *cp++;
-		buf[1] = *cp++;
-		uuid.node[i] = strtoul(buf, NULL, 16);
+
+	for (i = 0; i < 16; i++) {
+		unsigned char hi = cp[pairpos[i]], lo = cp[pairpos[i] + 1];
+
+		bad |= !is_hexdigit(hi) | !is_hexdigit(lo);
+		uu[i] = (hexval[hi] << 4) | hexval[lo];
 	}
 
-	uuid_pack(&uuid, uu);
+	/* the string has to be terminated right after the last digit */
+	if (bad || cp[36] != '\0')
+		return -1;
+	return 0;
+}
+
+int uuid_parse(const char *in, uuid_t uu)
+{
+	uuid_t tmp;
+
+	/* check the length before accessing the string */
+	if (strnlen(in, 37) != 36)
+		return -1;
+	if (parse_one(in, tmp) != 0)
+		return -1;
+
+	memcpy(uu, tmp, sizeof(uuid_t));
 	return 0;
 }
+
+/*
+ * Parses @n strings from @in to @out. Returns the number of successfully
+ * parsed UUIDs; if it is less than @n, then in[<returned value>] is not a
+ * valid UUID string.
+ */
+size_t uuid_parse_many(const char * const *in, uuid_t *out, size_t n)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		if (uuid_parse(in[i], out[i]) != 0)
+			break;
+	}
+	return i;
+}
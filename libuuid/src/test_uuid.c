@@ -40,6 +40,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "uuid.h"
 
@@ -60,14 +61,193 @@ static int test_uuid(const char * uuid, int isValid)
 	return 0;
 }
 
-#ifdef __GNUC__
-#define ATTR(x) __attribute__(x)
-#else
-#define ATTR(x)
-#endif
+/*
+ * The original sprintf() based implementation of uuid_unparse_lower()
+ */
+static void unparse_ref(const uuid_t uu, char *out)
+{
+	sprintf(out, "%08x-%04x-%04x-%02x%02x-%02x%02x%02x%02x%02x%02x",
+		(uu[0] << 24) | (uu[1] << 16) | (uu[2] << 8) | uu[3],
+		(uu[4] << 8) | uu[5], (uu[6] << 8) | uu[7],
+		uu[8], uu[9], uu[10], uu[11], uu[12], uu[13], uu[14], uu[15]);
+}
+
+static void random_uuids(uuid_t *uus, size_t n)
+{
+	size_t i;
+	int k;
+
+	srandom(n);
+	for (i = 0; i < n; i++)
+		for (k = 0; k < 16; k++)
+			uus[i][k] = random();
+}
+
+/*
+ * Compare the table-driven unparse/parse with the printf() format and check
+ * that the bulk functions produce the same results.
+ */
+static int test_conversions(size_t n)
+{
+	uuid_t *uus = calloc(n, sizeof(uuid_t));
+	uuid_t *res = calloc(n, sizeof(uuid_t));
+	char *strs = calloc(n, UUID_STR_LEN);
+	const char **ptrs = calloc(n, sizeof(char *));
+	char ref[UUID_STR_LEN], str[UUID_STR_LEN];
+	size_t i, k;
+	int failed = 0;
+
+	if (!uus || !res || !strs || !ptrs) {
+		printf("cannot allocate memory\n");
+		exit(1);
+	}
+	random_uuids(uus, n);
+
+	uuid_unparse_lower_many((const uuid_t *) uus, n, strs);
+
+	for (i = 0; i < n; i++) {
+		unparse_ref(uus[i], ref);
+		uuid_unparse_lower(uus[i], str);
+		if (strcmp(ref, str) || strcmp(ref, strs + i * UUID_STR_LEN)) {
+			printf("unparse mismatch: %s != %s\n", ref, str);
+			failed++;
+			break;
+		}
+		uuid_unparse_upper(uus[i], str);
+		for (k = 0; k < UUID_STR_LEN; k++)
+			if (str[k] >= 'A' && str[k] <= 'F')
+				str[k] += 'a' - 'A';
+		if (strcmp(ref, str)) {
+			printf("unparse upper mismatch: %s\n", ref);
+			failed++;
+			break;
+		}
+		ptrs[i] = strs + i * UUID_STR_LEN;
+	}
+
+	if (uuid_parse_many(ptrs, res, n) != n ||
+	    memcmp(uus, res, n * sizeof(uuid_t))) {
+		printf("bulk parse failed\n");
+		failed++;
+	}
+
+	/* the first invalid string stops bulk parsing */
+	if (n > 2) {
+		strs[UUID_STR_LEN + 35] = 'x';
+		if (uuid_parse_many(ptrs, res, n) != 1) {
+			printf("bulk parse accepted invalid string\n");
+			failed++;
+		}
+	}
+
+	if (!failed)
+		printf("%zu conversions compared, OK\n", n);
+
+	free(uus);
+	free(res);
+	free(strs);
+	free(ptrs);
+	return failed;
+}
+
+static int cmp_uuids(const void *a, const void *b)
+{
+	return uuid_compare(*(const uuid_t *) a, *(const uuid_t *) b);
+}
+
+/*
+ * The time-based UUIDs are generated from a reserved range of clock ticks,
+ * make sure that the ranges do not overlap.
+ */
+static int test_time_unique(size_t n)
+{
+	uuid_t *uus = calloc(n, sizeof(uuid_t));
+	size_t i;
+	int failed = 0;
+
+	if (!uus) {
+		printf("cannot allocate memory\n");
+		exit(1);
+	}
+	for (i = 0; i < n; i++)
+		uuid_generate_time(uus[i]);
+
+	qsort(uus, n, sizeof(uuid_t), cmp_uuids);
+	for (i = 1; i < n; i++) {
+		if (uuid_compare(uus[i - 1], uus[i]) == 0) {
+			printf("duplicate time UUID generated\n");
+			failed++;
+			break;
+		}
+	}
+	if (!failed)
+		printf("%zu time UUIDs are unique, OK\n", n);
+	free(uus);
+	return failed;
+}
+
+static double elapsed(struct timeval *start)
+{
+	struct timeval end;
+
+	gettimeofday(&end, NULL);
+	return (end.tv_sec - start->tv_sec) * 1E9 +
+	       (end.tv_usec - start->tv_usec) * 1E3;
+}
+
+static void benchmark(size_t n)
+{
+	uuid_t *uus = calloc(n, sizeof(uuid_t));
+	char *strs = calloc(n, UUID_STR_LEN);
+	const char **ptrs = calloc(n, sizeof(char *));
+	struct timeval start;
+	size_t i;
+
+	if (!uus || !strs || !ptrs) {
+		printf("cannot allocate memory\n");
+		exit(1);
+	}
+	random_uuids(uus, n);
+	for (i = 0; i < n; i++)
+		ptrs[i] = strs + i * UUID_STR_LEN;
+
+	printf("%zu UUIDs\n", n);
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < n; i++)
+		unparse_ref(uus[i], strs + i * UUID_STR_LEN);
+	printf("  sprintf():           %6.1f ns/UUID\n", elapsed(&start) / n);
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < n; i++)
+		uuid_unparse(uus[i], strs + i * UUID_STR_LEN);
+	printf("  uuid_unparse():      %6.1f ns/UUID\n", elapsed(&start) / n);
+
+	gettimeofday(&start, NULL);
+	uuid_unparse_many((const uuid_t *) uus, n, strs);
+	printf("  uuid_unparse_many(): %6.1f ns/UUID\n", elapsed(&start) / n);
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < n; i++)
+		uuid_parse(ptrs[i], uus[i]);
+	printf("  uuid_parse():        %6.1f ns/UUID\n", elapsed(&start) / n);
+
+	gettimeofday(&start, NULL);
+	uuid_parse_many(ptrs, uus, n);
+	printf("  uuid_parse_many():   %6.1f ns/UUID\n", elapsed(&start) / n);
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < n; i++)
+		uuid_generate_time(uus[i]);
+	printf("  uuid_generate_time():%6.1f ns/UUID\n", elapsed(&start) / n);
+
+	free(uus);
+	free(strs);
+	free(ptrs);
+}
 
 int
-main(int argc ATTR((unused)) , char **argv ATTR((unused)))
+main(int argc, char **argv)
 {
 	uuid_t		buf, tst;
 	char		str[100];
@@ -78,6 +258,13 @@ main(int argc ATTR((unused)) , char **argv ATTR((unused)))
 	int failed = 0;
 	int type, variant;
 
+	if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+		size_t n = argc > 2 ? strtoul(argv[2], NULL, 10) : 0;
+
+		benchmark(n ? n : 1000000);
+		return 0;
+	}
+
 	uuid_generate(buf);
 	uuid_unparse(buf, str);
 	printf("UUID generate = %s\n", str);
@@ -171,6 +358,10 @@ main(int argc ATTR((unused)) , char **argv ATTR((unused)))
 	failed += test_uuid("84949cc5-4701-4a84-895b0354c584a981b", 0);
 	failed += test_uuid("g4949cc5-4701-4a84-895b-354c584a981b", 0);
 	failed += test_uuid("84949cc5-4701-4a84-895b-354c584a981g", 0);
+	failed += test_uuid("84949cc5-4701-4a84-895b-354c584a981 ", 0);
+	failed += test_uuid("", 0);
+	failed += test_conversions(10000);
+	failed += test_time_unique(200000);
 
 	if (failed) {
 		printf("%d failures.\n", failed);
@@ -43,6 +43,9 @@
 
 typedef unsigned char uuid_t[16];
 
+/* Size of the UUID string representation including the terminating zero */
+#define UUID_STR_LEN	37
+
 /* UUID Variant definitions */
 #define UUID_VARIANT_NCS	0
 #define UUID_VARIANT_DCE	1
@@ -86,11 +89,15 @@ int uuid_is_null(const uuid_t uu);
 
 /* parse.c */
 int uuid_parse(const char *in, uuid_t uu);
+size_t uuid_parse_many(const char * const *in, uuid_t *out, size_t n);
 
 /* unparse.c */
 void uuid_unparse(const uuid_t uu, char *out);
 void uuid_unparse_lower(const uuid_t uu, char *out);
 void uuid_unparse_upper(const uuid_t uu, char *out);
+void uuid_unparse_many(const uuid_t *uu, size_t n, char *out);
+void uuid_unparse_lower_many(const uuid_t *uu, size_t n, char *out);
+void uuid_unparse_upper_many(const uuid_t *uu, size_t n, char *out);
 
 /* uuid_time.c */
 time_t uuid_time(const uuid_t uu, struct timeval *ret_tv);
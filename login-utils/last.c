@@ -51,6 +51,7 @@
 #include <getopt.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <errno.h>
 
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -78,24 +79,35 @@ static struct utmp	utmpbuf;
 #define P_LMAX	min(LMAX, 8)
 #define P_NMAX	min(NMAX, 16)
 
-typedef struct arg {
-	char	*name;				/* argument */
-#define	HOST_TYPE	-2
-#define	TTY_TYPE	-3
-#define	USER_TYPE	-4
-#define INET_TYPE	-5
-	int	type;				/* type of arg */
-	struct arg	*next;			/* linked list pointer */
-} ARG;
-ARG	*arglist;				/* head of linked list */
+#define	HOST_TYPE	0
+#define	TTY_TYPE	1
+#define	USER_TYPE	2
+#define INET_TYPE	3
+
+/*
+ * Arguments of one type; the names are truncated to the utmp field size
+ * and sorted, so a record is matched by one bsearch() per type.
+ */
+typedef struct filter {
+	char	**names;			/* sorted names */
+	in_addr_t *addrs;			/* INET_TYPE addresses */
+	int	nitems;
+} FILTER;
+static FILTER	filters[INET_TYPE + 1];
+static int	nargs;				/* number of all arguments */
 
 typedef struct ttytab {
 	long	logout;				/* log out time */
 	char	tty[LMAX + 1];			/* terminal name */
 	struct ttytab	*next;			/* linked list pointer */
+	struct ttytab	*hnext;			/* hash chain pointer */
 } TTY;
 TTY	*ttylist;				/* head of linked list */
 
+static TTY	**ttyhash;			/* ttylist hash table */
+static size_t	ttyhash_size,			/* number of buckets */
+		nttys;				/* number of ttys */
+
 static long	currentout,			/* current logout value */
 		maxrec;				/* records to display */
 static char	*file = _PATH_WTMP;		/* wtmp file */
@@ -103,25 +115,43 @@ static char	*file = _PATH_WTMP;		/* wtmp file */
 static int	doyear = 0;			/* output year in dates */
 static int	dolong = 0;			/* print also ip-addr */
 
+static time_t	since,				/* --since, 0 if unset */
+		until;				/* --until, 0 if unset */
+
 static void wtmp(void);
+static int cmpname(const void *, const void *);
 static void addarg(int, char *);
+static void compilearg(void);
+static time_t parsetime(const char *);
 static void hostconv(char *);
 static void onintr(int);
 static int want(struct utmp *, int);
 TTY *addtty(char *);
+TTY *findtty(char *);
 static char *ttyconv(char *);
 
 int
 main(int argc, char **argv) {
 	int	ch;
 
+	enum {
+		OPT_SINCE = CHAR_MAX + 1,
+		OPT_UNTIL
+	};
+	static const struct option longopts[] = {
+		{ "since", required_argument, NULL, OPT_SINCE },
+		{ "until", required_argument, NULL, OPT_UNTIL },
+		{ NULL, 0, NULL, 0 }
+	};
+
 	setlocale(LC_ALL, "");
 	bindtextdomain(PACKAGE, LOCALEDIR);
 	textdomain(PACKAGE);
 	atexit(close_stdout);
 
-	while ((ch = getopt(argc, argv, "0123456789yli:f:h:t:")) != -1)
-		switch((char)ch) {
+	while ((ch = getopt_long(argc, argv, "0123456789yli:f:h:t:",
+				 longopts, NULL)) != -1)
+		switch(ch) {
 		case '0': case '1': case '2': case '3': case '4':
 		case '5': case '6': case '7': case '8': case '9':
 			/*
@@ -150,9 +180,16 @@ main(int argc, char **argv) {
 		case 'i':
 			addarg(INET_TYPE, optarg);
 			break;
+		case OPT_SINCE:
+			since = parsetime(optarg);
+			break;
+		case OPT_UNTIL:
+			until = parsetime(optarg);
+			break;
 		case '?':
 		default:
-			fputs(_("usage: last [-#] [-f file] [-t tty] [-h hostname] [user ...]\n"), stderr);
+			fputs(_("usage: last [-#] [-f file] [-t tty] [-h hostname] "
+				"[--since time] [--until time] [user ...]\n"), stderr);
 			exit(EXIT_FAILURE);
 		}
 	for (argv += optind; *argv; ++argv) {
@@ -163,6 +200,7 @@ main(int argc, char **argv) {
 #endif
 		addarg(USER_TYPE, *argv);
 	}
+	compilearg();
 	wtmp();
 
 	return EXIT_SUCCESS;
@@ -221,6 +259,8 @@ wtmp(void) {
 	struct stat st;
 	int utl_len;
 	int listnr = 0;
+	int first = 0;				/* oldest record to read */
+	int show;				/* record within --since/--until */
 	int i;
 
 	utmpname(file);
@@ -256,8 +296,30 @@ wtmp(void) {
 	if(listnr) 
 		ct = utmp_ctime(&utl[0]);
 
-	for(i = listnr - 1; i >= 0; i--) {
+	if (since) {
+		/*
+		 * wtmp is appended in time order, so the records older than
+		 * --since are skipped by binary search. The newer records
+		 * are read (but not printed) also with --until, they are
+		 * necessary to get the logout times.
+		 */
+		int lo = 0, hi = listnr;
+
+		while (lo < hi) {
+			int mid = lo + (hi - lo) / 2;
+
+			if ((time_t) utl[mid].ut_time < since)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		first = lo;
+	}
+
+	for(i = listnr - 1; i >= first; i--) {
 		bp = utl+i;
+		show = (!since || (time_t) bp->ut_time >= since) &&
+		       (!until || (time_t) bp->ut_time <= until);
 		/*
 		 * if the terminal line is '~', the machine stopped.
 		 * see utmp(5) for more info.
@@ -281,7 +343,7 @@ wtmp(void) {
 			    ? "crash" : "down ");
 		    if (!bp->ut_name[0])
 			(void)strcpy(bp->ut_name, "reboot");
-		    if (want(bp, NO)) {
+		    if (show && want(bp, NO)) {
 			ct = utmp_ctime(bp);
 			if(bp->ut_type != LOGIN_PROCESS) {
 			    print_partial_line(bp);
@@ -293,16 +355,11 @@ wtmp(void) {
 		    continue;
 		}
 		/* find associated tty */
-		for (T = ttylist;; T = T->next) {
-		    if (!T) {
-			/* add new one */
-			T = addtty(bp->ut_line);
-			break;
-		    }
-		    if (!strncmp(T->tty, bp->ut_line, LMAX))
-			break;
-		}
-		if (bp->ut_name[0] && bp->ut_type != LOGIN_PROCESS
+		T = findtty(bp->ut_line);
+		if (!T)
+		    T = addtty(bp->ut_line);
+
+		if (show && bp->ut_name[0] && bp->ut_type != LOGIN_PROCESS
 		    && bp->ut_type != DEAD_PROCESS
 		    && want(bp, YES)) {
 
@@ -334,13 +391,21 @@ wtmp(void) {
 	if(ct) printf(_("\nwtmp begins %s"), ct); 	/* ct already ends in \n */
 }
 
+static int
+cmpname(const void *a, const void *b) {
+	return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
 /*
  * want --
  *	see if want this entry
  */
 static int
 want(struct utmp *bp, int check) {
-	register ARG	*step;
+	FILTER	*f;
+	char	key[HMAX + 1];			/* HMAX is the largest field */
+	char	*name = key;
+	int	type;
 
 	if (check) {
 		/*
@@ -353,46 +418,118 @@ want(struct utmp *bp, int check) {
 		else if (!strncmp(bp->ut_line, "uucp", sizeof("uucp") - 1))
 			bp->ut_line[4] = '\0';
 	}
-	if (!arglist)
+	if (!nargs)
 		return YES;
 
-	for (step = arglist; step; step = step->next)
-		switch(step->type) {
+	for (type = HOST_TYPE; type <= INET_TYPE; type++) {
+		f = &filters[type];
+		if (!f->nitems)
+			continue;
+
+		switch(type) {
 		case HOST_TYPE:
-			if (!strncmp(step->name, bp->ut_host, HMAX))
-				return YES;
+			memcpy(key, bp->ut_host, HMAX);
+			key[HMAX] = '\0';
 			break;
 		case TTY_TYPE:
-			if (!strncmp(step->name, bp->ut_line, LMAX))
-				return YES;
+			memcpy(key, bp->ut_line, LMAX);
+			key[LMAX] = '\0';
 			break;
 		case USER_TYPE:
-			if (!strncmp(step->name, bp->ut_name, NMAX))
-				return YES;
+			memcpy(key, bp->ut_name, NMAX);
+			key[NMAX] = '\0';
 			break;
 		case INET_TYPE:
-			if ((in_addr_t) bp->ut_addr == inet_addr(step->name))
-			  return YES;
-			break;
+		{
+			int i;
+
+			for (i = 0; i < f->nitems; i++)
+				if ((in_addr_t) bp->ut_addr == f->addrs[i])
+					return YES;
+			continue;
+		}
 		default:
 			abort();
 		}
+		if (bsearch(&name, f->names, f->nitems, sizeof(char *), cmpname))
+			return YES;
+	}
 	return NO;
 }
 
 /*
  * addarg --
- *	add an entry to a linked list of arguments
+ *	add an entry to the list of arguments
  */
 static void
 addarg(int type, char *arg) {
-	register ARG	*cur;
+	FILTER	*f = &filters[type];
+
+	f->names = xrealloc(f->names, (f->nitems + 1) * sizeof(char *));
+	f->names[f->nitems++] = arg;
+	nargs++;
+}
+
+/*
+ * compilearg --
+ *	prepare the arguments for want(); the names are truncated to the
+ *	size of the utmp fields (strncmp() semantic) and sorted, and
+ *	the addresses are converted
+ */
+static void
+compilearg(void) {
+	static const int maxlen[] = {
+		[HOST_TYPE] = HMAX,
+		[TTY_TYPE] = LMAX,
+		[USER_TYPE] = NMAX
+	};
+	FILTER	*f;
+	int	type, i;
+
+	for (type = HOST_TYPE; type <= USER_TYPE; type++) {
+		f = &filters[type];
+		for (i = 0; i < f->nitems; i++) {
+			char *name = xcalloc(1, maxlen[type] + 1);
+
+			strncpy(name, f->names[i], maxlen[type]);
+			f->names[i] = name;
+		}
+		qsort(f->names, f->nitems, sizeof(char *), cmpname);
+	}
+
+	f = &filters[INET_TYPE];
+	if (f->nitems) {
+		f->addrs = xmalloc(f->nitems * sizeof(in_addr_t));
+		for (i = 0; i < f->nitems; i++)
+			f->addrs[i] = inet_addr(f->names[i]);
+	}
+}
+
+static unsigned int
+ttyhashfn(const char *name) {
+	unsigned int	h = 5381;
+	int	i;
+
+	for (i = 0; i < LMAX && name[i]; i++)
+		h = h * 33 + (unsigned char) name[i];
+	return h;
+}
+
+/*
+ * findtty --
+ *	find an entry in the list of ttys
+ */
+TTY *
+findtty(char *ttyname) {
+	register TTY	*T;
 
-	cur = xmalloc(sizeof(ARG));
-	cur->next = arglist;
-	cur->type = type;
-	cur->name = arg;
-	arglist = cur;
+	if (!ttyhash)
+		return NULL;
+
+	for (T = ttyhash[ttyhashfn(ttyname) & (ttyhash_size - 1)]; T; T = T->hnext)
+		if (!strncmp(T->tty, ttyname, LMAX))
+			return T;
+	return NULL;
 }
 
 /*
@@ -402,14 +539,75 @@ addarg(int type, char *arg) {
 TTY *
 addtty(char *ttyname) {
 	register TTY	*cur;
+	size_t	idx;
+
+	if (nttys >= ttyhash_size) {
+		/* resize the hash table, keep at most one tty per bucket */
+		ttyhash_size = ttyhash_size ? ttyhash_size * 2 : 256;
+		free(ttyhash);
+		ttyhash = xcalloc(ttyhash_size, sizeof(TTY *));
+
+		for (cur = ttylist; cur; cur = cur->next) {
+			idx = ttyhashfn(cur->tty) & (ttyhash_size - 1);
+			cur->hnext = ttyhash[idx];
+			ttyhash[idx] = cur;
+		}
+	}
 
 	cur = xmalloc(sizeof(TTY));
 	cur->next = ttylist;
 	cur->logout = currentout;
 	memcpy(cur->tty, ttyname, LMAX);
+	cur->tty[LMAX] = '\0';
+
+	idx = ttyhashfn(cur->tty) & (ttyhash_size - 1);
+	cur->hnext = ttyhash[idx];
+	ttyhash[idx] = cur;
+	nttys++;
+
 	return(ttylist = cur);
 }
 
+/*
+ * parsetime --
+ *	convert --since and --until argument to time_t
+ */
+static time_t
+parsetime(const char *arg) {
+	static const char *formats[] = {
+		"%Y-%m-%d %H:%M:%S",
+		"%Y-%m-%d %H:%M",
+		"%Y-%m-%d"
+	};
+	struct tm	tm;
+	char	*end;
+	size_t	i;
+
+	if (*arg == '@') {
+		long long t;
+
+		errno = 0;
+		t = strtoll(arg + 1, &end, 10);
+		if (!errno && end > arg + 1 && !*end && t > 0)
+			return (time_t) t;
+	} else {
+		for (i = 0; i < ARRAY_SIZE(formats); i++) {
+			memset(&tm, 0, sizeof(tm));
+			end = strptime(arg, formats[i], &tm);
+			if (end && !*end) {
+				time_t t;
+
+				tm.tm_isdst = -1;
+				t = mktime(&tm);
+				if (t > 0)
+					return t;
+				break;
+			}
+		}
+	}
+	errx(EXIT_FAILURE, _("invalid time value \"%s\""), arg);
+}
+
 /*
  * hostconv --
  *	convert the hostname to search pattern; if the supplied host name
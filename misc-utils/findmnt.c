@@ -216,6 +216,18 @@ static void set_source_match(const char *data)
 		set_match(COL_SOURCE, data);
 }
 
+/* -t and -O patterns are compiled, see match_func() */
+static void set_pattern_match(int id, int type, const char *pattern)
+{
+	struct libmnt_pattern *pat = mnt_new_pattern(type, pattern);
+
+	if (!pat)
+		err(EXIT_FAILURE, _("failed to compile pattern %s"), pattern);
+
+	mnt_free_pattern(get_match_data(id));
+	set_match_data(id, pat);
+}
+
 static void enable_extra_target_match(void)
 {
 	char *cn = NULL, *mnt = NULL;
@@ -726,12 +738,12 @@ static int match_func(struct libmnt_fs *fs,
 	if (m && !mnt_fs_match_source(fs, m, cache))
 		return rc;
 
-	m = get_match(COL_FSTYPE);
-	if (m && !mnt_fs_match_fstype(fs, m))
+	md = get_match_data(COL_FSTYPE);
+	if (md && !mnt_fs_match_pattern(fs, md))
 		return rc;
 
-	m = get_match(COL_OPTIONS);
-	if (m && !mnt_fs_match_options(fs, m))
+	md = get_match_data(COL_OPTIONS);
+	if (md && !mnt_fs_match_pattern(fs, md))
 		return rc;
 
 	md = get_match_data(COL_MAJMIN);
@@ -802,6 +814,58 @@ again:
 	return fs;
 }
 
+/*
+ * Reads tags for all devices needed by the tag columns at once, get_tag()
+ * then only looks at the libmount cache.
+ */
+static void prefetch_tags(struct libmnt_table *tb)
+{
+	struct libmnt_iter *itr;
+	struct libmnt_fs *fs;
+	const char **devs;
+	size_t ndevs = 0;
+	long ncpus;
+	int i, all = is_listall_mode();
+
+	for (i = 0; i < ncolumns; i++) {
+		int id = get_column_id(i);
+
+		if (id == COL_UUID || id == COL_PARTUUID ||
+		    id == COL_LABEL || id == COL_PARTLABEL)
+			break;
+	}
+	if (i == ncolumns)
+		return;
+	if (!all && (get_match(COL_SOURCE) || get_match(COL_TARGET)))
+		return;		/* a few entries, don't probe in advance */
+
+	itr = mnt_new_iter(MNT_ITER_FORWARD);
+	if (!itr)
+		return;
+
+	devs = xcalloc(mnt_table_get_nents(tb), sizeof(char *));
+
+	while (mnt_table_next_fs(tb, itr, &fs) == 0) {
+		const char *src;
+
+		if (mnt_fs_is_pseudofs(fs) || mnt_fs_is_netfs(fs))
+			continue;
+		if (!all && !match_func(fs, NULL))
+			continue;
+		src = mnt_fs_get_source(fs);
+		if (src)
+			src = mnt_resolve_spec(src, cache);
+		if (src && *src == '/')
+			devs[ndevs++] = src;
+	}
+
+	ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	mnt_cache_read_tags_set(cache, devs, ndevs, ncpus > 0 ? ncpus : 1);
+
+	free(devs);
+	mnt_free_iter(itr);
+}
+
 static int add_matching_lines(struct libmnt_table *tb,
 			      struct tt *tt, int direction)
 {
@@ -1149,6 +1213,7 @@ int main(int argc, char *argv[])
 			break;
 		case 'O':
 			set_match(COL_OPTIONS, optarg);
+			set_pattern_match(COL_OPTIONS, MNT_PATTERN_OPTIONS, optarg);
 			break;
 		case 'p':
 			if (optarg) {
@@ -1178,6 +1243,7 @@ int main(int argc, char *argv[])
 			break;
 		case 't':
 			set_match(COL_FSTYPE, optarg);
+			set_pattern_match(COL_FSTYPE, MNT_PATTERN_FSTYPE, optarg);
 			break;
 		case 'r':
 			tt_flags &= ~TT_FL_TREE;	/* disable the default */
@@ -1341,6 +1407,9 @@ int main(int argc, char *argv[])
 	/*
 	 * Fill in data to the output table
 	 */
+	if (!(flags & FL_POLL))
+		prefetch_tags(tb);
+
 	if (flags & FL_POLL) {
 		/* poll mode (accept the first tabfile only) */
 		rc = poll_table(tb, tabfiles ? *tabfiles : _PATH_PROC_MOUNTINFO, timeout, tt, direction);
@@ -1362,6 +1431,8 @@ leave:
 
 	mnt_free_table(tb);
 	mnt_free_cache(cache);
+	mnt_free_pattern(get_match_data(COL_FSTYPE));
+	mnt_free_pattern(get_match_data(COL_OPTIONS));
 	free(tabfiles);
 
 	return rc ? EXIT_FAILURE : EXIT_SUCCESS;
@@ -45,21 +45,64 @@
 #include <string.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/uio.h>
 #include <sys/un.h>
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <getopt.h>
+#include <limits.h>
 
+#include "all-io.h"
 #include "c.h"
 #include "closestream.h"
 #include "nls.h"
 #include "strutils.h"
+#include "xalloc.h"
 
 #define	SYSLOG_NAMES
 #include <syslog.h>
 
+#ifndef _PATH_LOG
+# define _PATH_LOG	"/dev/log"
+#endif
+
+#define BATCH_MAXMSGS	256		/* max number of messages per send */
+#define BATCH_BUFSZ	(256 * 1024)	/* buffer for the formatted messages */
+#define BATCH_INBUFSZ	(64 * 1024)	/* stdin read buffer */
+#define BATCH_MSGSZ	1024		/* default max size of one message */
+
 static int optd = 0;
 
+/*
+ * Batch mode: the messages are formatted into one large buffer and sent by
+ * one sendmmsg() (datagram sockets) or write() (stream sockets) call.
+ */
+struct logger_batch {
+	int		fd;
+	int		stream;		/* SOCK_STREAM socket */
+	int		logflags;
+	int		pri;
+	const char	*tag;
+	size_t		msgsz;		/* max size of one message */
+
+	char		*buf;		/* formatted messages */
+	size_t		bufsz;
+	size_t		used;
+	struct iovec	iov[BATCH_MAXMSGS];
+#ifdef HAVE_SENDMMSG
+	struct mmsghdr	msgs[BATCH_MAXMSGS];
+#endif
+	size_t		nmsgs;
+
+	time_t		hdr_time;	/* time of the cached header */
+	char		hdr[256];	/* "<pri>timestamp tag[pid]: " */
+	size_t		hdrlen;
+
+	uintmax_t	sent_msgs;	/* statistics */
+	uintmax_t	sent_bytes;
+};
+
 static int decode(char *name, CODE *codetab)
 {
 	register CODE *c;
@@ -167,6 +210,184 @@ mysyslog(int fd, int logflags, int pri, char *tag, char *msg) {
        }
 }
 
+static void batch_init(struct logger_batch *b, int fd, int logflags,
+		       int pri, const char *tag, size_t msgsz)
+{
+	int type = SOCK_STREAM;
+	socklen_t sz = sizeof(type);
+#ifdef HAVE_SENDMMSG
+	size_t i;
+#endif
+
+	memset(b, 0, sizeof(*b));
+	b->fd = fd;
+	b->logflags = logflags;
+	b->pri = pri;
+	b->msgsz = msgsz;
+	b->bufsz = max((size_t) BATCH_BUFSZ, msgsz * 2);
+	b->buf = xmalloc(b->bufsz);
+	b->hdr_time = (time_t) -1;
+
+	getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &sz);
+	b->stream = type == SOCK_STREAM;
+
+	if (tag)
+		b->tag = tag;
+	else {
+		b->tag = getlogin();
+		if (!b->tag)
+			b->tag = "<someone>";
+	}
+#ifdef HAVE_SENDMMSG
+	for (i = 0; i < BATCH_MAXMSGS; i++) {
+		b->msgs[i].msg_hdr.msg_iov = &b->iov[i];
+		b->msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+#endif
+}
+
+/* the header is the same for all messages within one second */
+static void batch_update_header(struct logger_batch *b, time_t now)
+{
+	char pid[30];
+	int rc;
+
+	if (b->logflags & LOG_PID)
+		snprintf(pid, sizeof(pid), "[%d]", getpid());
+	else
+		pid[0] = 0;
+
+	rc = snprintf(b->hdr, sizeof(b->hdr), "<%d>%.15s %.200s%s: ",
+		      b->pri, ctime(&now) + 4, b->tag, pid);
+	b->hdrlen = rc < 0 ? 0 : min((size_t) rc, sizeof(b->hdr) - 1);
+	b->hdr_time = now;
+
+	if (b->hdrlen + 1 >= b->msgsz)
+		errx(EXIT_FAILURE, _("message size %zu is too small"), b->msgsz);
+}
+
+static void batch_flush(struct logger_batch *b)
+{
+	size_t i = 0;
+
+	if (!b->nmsgs)
+		return;
+
+	if (b->stream) {
+		/* messages are separated by the terminating zeros */
+		if (write_all(b->fd, b->buf, b->used) == 0)
+			i = b->nmsgs;
+	} else {
+#ifdef HAVE_SENDMMSG
+		while (i < b->nmsgs) {
+			int rc = sendmmsg(b->fd, b->msgs + i, b->nmsgs - i, 0);
+
+			if (rc > 0)
+				i += rc;
+			else if (rc < 0 && errno != EINTR)
+				break;
+		}
+		if (i == 0 && errno == ENOSYS)
+#endif
+		for (; i < b->nmsgs; i++) {
+			if (send(b->fd, b->iov[i].iov_base,
+				 b->iov[i].iov_len, 0) < 0)
+				break;
+		}
+	}
+
+	b->sent_msgs += i;
+	while (i > 0)
+		b->sent_bytes += b->iov[--i].iov_len;
+
+	b->nmsgs = 0;
+	b->used = 0;
+}
+
+/* adds one message, too long messages are split */
+static void batch_add(struct logger_batch *b, const char *msg, size_t len)
+{
+	time_t now = time(NULL);
+	size_t room;
+
+	if (now != b->hdr_time)
+		batch_update_header(b, now);
+
+	len = strnlen(msg, len);
+	if (b->logflags & LOG_PERROR)
+		fprintf(stderr, "%.*s\n", (int) len, msg);
+
+	room = b->msgsz - b->hdrlen - 1;
+	do {
+		size_t sz = min(len, room);
+		char *p;
+
+		if (b->nmsgs == BATCH_MAXMSGS ||
+		    b->used + b->hdrlen + sz + 1 > b->bufsz)
+			batch_flush(b);
+
+		p = b->buf + b->used;
+		memcpy(p, b->hdr, b->hdrlen);
+		memcpy(p + b->hdrlen, msg, sz);
+		p[b->hdrlen + sz] = '\0';
+
+		b->iov[b->nmsgs].iov_base = p;
+		b->iov[b->nmsgs].iov_len = b->hdrlen + sz + 1;
+		b->used += b->hdrlen + sz + 1;
+		b->nmsgs++;
+
+		msg += sz;
+		len -= sz;
+	} while (len);
+}
+
+/*
+ * Reads stdin in large chunks and sends all lines of the chunk at once. The
+ * batch is flushed before the next read(), so the messages are not delayed
+ * when the input is idle.
+ */
+static void batch_log_stdin(struct logger_batch *b)
+{
+	char *in = xmalloc(BATCH_INBUFSZ);
+	size_t pending = 0;
+
+	for (;;) {
+		ssize_t rc = read(STDIN_FILENO, in + pending,
+				  BATCH_INBUFSZ - pending);
+		char *p, *end, *nl;
+
+		if (rc < 0) {
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			err(EXIT_FAILURE, _("read failed"));
+		}
+		if (rc == 0)
+			break;
+
+		p = in;
+		end = in + pending + rc;
+		while ((nl = memchr(p, '\n', end - p))) {
+			batch_add(b, p, nl - p);
+			p = nl + 1;
+		}
+
+		pending = end - p;
+		if (pending == BATCH_INBUFSZ) {
+			/* the line does not fit to the buffer */
+			batch_add(b, in, pending);
+			pending = 0;
+		} else if (pending && p != in)
+			memmove(in, p, pending);
+
+		batch_flush(b);
+	}
+
+	if (pending)
+		batch_add(b, in, pending);
+	batch_flush(b);
+	free(in);
+}
+
 static void __attribute__ ((__noreturn__)) usage(FILE *out)
 {
 	fputs(_("\nUsage:\n"), out);
@@ -174,7 +395,8 @@ static void __attribute__ ((__noreturn__)) usage(FILE *out)
 	      _(" %s [options] [message]\n"), program_invocation_short_name);
 
 	fputs(_("\nOptions:\n"), out);
-	fputs(_(" -d, --udp             use UDP (TCP is default)\n"
+	fputs(_(" -b, --batch           send the lines from stdin in batches\n"
+		" -d, --udp             use UDP (TCP is default)\n"
 		" -i, --id              log the process ID too\n"
 		" -f, --file <file>     log the contents of this file\n"
 		" -h, --help            display this help text and exit\n"), out);
@@ -182,7 +404,9 @@ static void __attribute__ ((__noreturn__)) usage(FILE *out)
 		" -P, --port <number>   use this UDP port\n"
 		" -p, --priority <prio> mark given message with this priority\n"
 		" -s, --stderr          output message to standard error as well\n"), out);
-	fputs(_(" -t, --tag <tag>       mark every line with this tag\n"
+	fputs(_(" -S, --size <num>      maximum size of one message in batch mode\n"
+		"     --stats           print statistics at exit in batch mode\n"
+		" -t, --tag <tag>       mark every line with this tag\n"
 		" -u, --socket <socket> write to this Unix socket\n"
 		" -V, --version         output version information and exit\n\n"), out);
 
@@ -203,7 +427,10 @@ main(int argc, char **argv) {
 	char *udpserver = NULL;
 	char *udpport = NULL;
 	int LogSock = -1;
+	int batch = 0, stats = 0;
+	size_t msgsz = BATCH_MSGSZ;
 
+	enum { OPT_STATS = CHAR_MAX + 1 };
 	static const struct option longopts[] = {
 		{ "id",		no_argument,	    0, 'i' },
 		{ "stderr",	no_argument,	    0, 's' },
@@ -214,6 +441,9 @@ main(int argc, char **argv) {
 		{ "udp",	no_argument,	    0, 'd' },
 		{ "server",	required_argument,  0, 'n' },
 		{ "port",	required_argument,  0, 'P' },
+		{ "batch",	no_argument,	    0, 'b' },
+		{ "size",	required_argument,  0, 'S' },
+		{ "stats",	no_argument,	    0, OPT_STATS },
 		{ "version",	no_argument,	    0, 'V' },
 		{ "help",	no_argument,	    0, 'h' },
 		{ NULL,		0, 0, 0 }
@@ -227,9 +457,9 @@ main(int argc, char **argv) {
 	tag = NULL;
 	pri = LOG_NOTICE;
 	logflags = 0;
-	while ((ch = getopt_long(argc, argv, "f:ip:st:u:dn:P:Vh",
+	while ((ch = getopt_long(argc, argv, "f:ip:st:u:dn:P:bS:Vh",
 					    longopts, NULL)) != -1) {
-		switch((char)ch) {
+		switch(ch) {
 		case 'f':		/* file to log */
 			if (freopen(optarg, "r", stdin) == NULL)
 				err(EXIT_FAILURE, _("file %s"),
@@ -260,6 +490,18 @@ main(int argc, char **argv) {
 		case 'P':		/* change udp port */
 			udpport = optarg;
 			break;
+		case 'b':		/* batch mode */
+			batch = 1;
+			break;
+		case 'S':		/* max message size */
+			msgsz = strtosize_or_err(optarg,
+					_("failed to parse message size"));
+			if (msgsz < 2 || msgsz > INT_MAX)
+				errx(EXIT_FAILURE, _("invalid message size"));
+			break;
+		case OPT_STATS:
+			stats = 1;
+			break;
 		case 'V':
 			printf(_("%s from %s\n"), program_invocation_short_name,
 						  PACKAGE_STRING);
@@ -274,6 +516,12 @@ main(int argc, char **argv) {
 	argc -= optind;
 	argv += optind;
 
+	/* batch mode uses the socket directly, the same one as syslog(3) */
+	if (batch && argc == 0 && !usock && !udpserver) {
+		usock = _PATH_LOG;
+		optd = 1;
+	}
+
 	/* setup for logging */
 	if (!usock && !udpserver)
 		openlog(tag ? tag : getlogin(), logflags, 0);
@@ -314,6 +562,25 @@ main(int argc, char **argv) {
 		    else
 			mysyslog(LogSock, logflags, pri, tag, buf);
 		}
+	} else if (batch) {
+		struct logger_batch b;
+		struct timeval start, end;
+
+		gettimeofday(&start, NULL);
+		batch_init(&b, LogSock, logflags, pri, tag, msgsz);
+		batch_log_stdin(&b);
+		gettimeofday(&end, NULL);
+
+		if (stats) {
+			double sec = (end.tv_sec - start.tv_sec) +
+				     (end.tv_usec - start.tv_usec) / 1E6;
+
+			fprintf(stderr, _("%ju messages, %ju bytes sent in "
+					  "%.3f seconds (%.0f messages/s)\n"),
+				b.sent_msgs, b.sent_bytes, sec,
+				sec > 0 ? b.sent_msgs / sec : 0);
+		}
+		free(b.buf);
 	} else {
 		while (fgets(buf, sizeof(buf), stdin) != NULL) {
 		    /* glibc is buggy and adds an additional newline,
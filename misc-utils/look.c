@@ -53,12 +53,17 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <string.h>
 #include <ctype.h>
 #include <getopt.h>
+#include <libgen.h>
 
 #include "nls.h"
+#include "c.h"
 #include "xalloc.h"
+#include "all-io.h"
+#include "fileutils.h"
 #include "pathnames.h"
 #include "closestream.h"
 
@@ -73,24 +78,301 @@ int stringlen;
 char *string;
 char *comparbuf;
 
+/*
+ * The strings to look for. The strings are searched in sorted order, so
+ * the dictionary is read by one forward pass for all of them, and printed
+ * in the original order.
+ */
+struct look_query {
+	char	*str;		/* formatted (-d, -f) string */
+	size_t	nr;		/* original order */
+	char	*start;		/* the first matching line */
+	char	*end;		/* end of the last matching line */
+};
+
+/*
+ * Sidecar index: header, array of entries (sorted like the dictionary)
+ * and the keys, the keys are the lines formatted according to -d and -f.
+ * The index is in the native byte order and it's rebuilt when the
+ * dictionary or the flags don't match the header.
+ */
+#define LOOK_INDEX_MAGIC	"LOOKIDX"
+#define LOOK_INDEX_VERSION	1
+
+struct look_index_header {
+	char		magic[8];
+	uint32_t	version;
+	uint32_t	flags;		/* LOOK_INDEX_{DFLAG,FFLAG} */
+	uint64_t	dict_size;
+	uint64_t	dict_mtime;
+	uint64_t	dict_ino;
+	uint64_t	nents;
+	uint64_t	keys_size;
+};
+
+#define LOOK_INDEX_DFLAG	(1 << 0)
+#define LOOK_INDEX_FFLAG	(1 << 1)
+
+struct look_index_entry {
+	uint64_t	line;		/* offset of the line in the dictionary */
+	uint64_t	key;		/* offset of the key in the keys area */
+};
+
+struct look_index {
+	void				*map;
+	size_t				mapsz;
+	struct look_index_header	*hdr;
+	struct look_index_entry		*ents;
+	char				*keys;
+};
+
 static char *binary_search (char *, char *);
 static int compare (char *, char *);
-static char *linear_search (char *, char *);
-static int look (char *, char *);
-static void print_from (char *, char *);
+static int look (struct look_query *, size_t, char *, char *,
+		 struct look_index *);
 static void __attribute__ ((__noreturn__)) usage(FILE * out);
 
+/*
+ * Reformat string to avoid doing it multiple times later.
+ */
+static char *format_string(char *str, int termchar)
+{
+	char *readp, *writep, *p;
+	int ch;
+
+	if (termchar != '\0' && (p = strchr(str, termchar)) != NULL)
+		*++p = '\0';
+
+	for (readp = writep = str; (ch = *readp++) != 0;) {
+		if (dflag && !isalnum((unsigned char) ch))
+			continue;
+		/* strncasecmp() ignores case, but the index and sort of
+		 * the strings need the same case */
+		*(writep++) = fflag ? tolower((unsigned char) ch) : ch;
+	}
+	*writep = '\0';
+	return str;
+}
+
+static struct look_query *read_queries(FILE *f, size_t *nqueries, int termchar)
+{
+	struct look_query *qs = NULL;
+	size_t n = 0, sz = 0, len = 0;
+	char *buf = NULL;
+	ssize_t rc;
+
+	while ((rc = getline(&buf, &len, f)) != -1) {
+		if (rc && buf[rc - 1] == '\n')
+			buf[rc - 1] = '\0';
+		if (!*buf)
+			continue;		/* ignore empty lines */
+		if (n == sz) {
+			sz = sz ? sz * 2 : 64;
+			qs = xrealloc(qs, sz * sizeof(*qs));
+		}
+		memset(&qs[n], 0, sizeof(*qs));
+		qs[n].str = format_string(xstrdup(buf), termchar);
+		qs[n].nr = n;
+		n++;
+	}
+	if (ferror(f))
+		err(EXIT_FAILURE, _("read failed"));
+	free(buf);
+
+	*nqueries = n;
+	return qs;
+}
+
+static int cmp_query_str(const void *a, const void *b)
+{
+	const struct look_query *qa = a, *qb = b;
+	int rc = strcmp(qa->str, qb->str);
+
+	return rc ? rc : qa->nr < qb->nr ? -1 : 1;
+}
+
+static int cmp_query_nr(const void *a, const void *b)
+{
+	const struct look_query *qa = a, *qb = b;
+
+	return qa->nr < qb->nr ? -1 : qa->nr > qb->nr ? 1 : 0;
+}
+
+static void *map_file(int fd, size_t size, const char *name)
+{
+	void *p;
+
+	if (!size)
+		return NULL;
+	p = mmap(NULL, size, PROT_READ,
+#ifdef MAP_FILE
+		     MAP_FILE |
+#endif
+		     MAP_SHARED, fd, (off_t) 0);
+	if
+#ifdef MAP_FAILED
+		(p == MAP_FAILED)
+#else
+		((void *)(p) <= (void *)0)
+#endif
+			err(EXIT_FAILURE, "%s", name);
+	return p;
+}
+
+static uint32_t index_flags(void)
+{
+	return (dflag ? LOOK_INDEX_DFLAG : 0) | (fflag ? LOOK_INDEX_FFLAG : 0);
+}
+
+static int index_is_valid(struct look_index *idx, struct stat *dict)
+{
+	struct look_index_header *hdr = idx->hdr;
+
+	if (idx->mapsz < sizeof(*hdr) ||
+	    memcmp(hdr->magic, LOOK_INDEX_MAGIC, sizeof(hdr->magic)) != 0 ||
+	    hdr->version != LOOK_INDEX_VERSION ||
+	    hdr->flags != index_flags() ||
+	    hdr->dict_size != (uint64_t) dict->st_size ||
+	    hdr->dict_mtime != (uint64_t) dict->st_mtime ||
+	    hdr->dict_ino != (uint64_t) dict->st_ino)
+		return 0;
+
+	/* don't trust the counters, it's a regular file */
+	if (hdr->nents > (idx->mapsz - sizeof(*hdr)) / sizeof(*idx->ents) ||
+	    hdr->keys_size != idx->mapsz - sizeof(*hdr)
+				- hdr->nents * sizeof(*idx->ents))
+		return 0;
+
+	idx->keys = (char *) (idx->ents + hdr->nents);
+	if (hdr->keys_size && idx->keys[hdr->keys_size - 1] != '\0')
+		return 0;
+	return 1;
+}
+
+static int open_index(struct look_index *idx, const char *name, struct stat *dict)
+{
+	struct stat st;
+	int fd;
+
+	memset(idx, 0, sizeof(*idx));
+
+	fd = open(name, O_RDONLY);
+	if (fd < 0)
+		return -1;
+	if (fstat(fd, &st) || (size_t) st.st_size < sizeof(*idx->hdr)) {
+		close(fd);
+		return -1;
+	}
+	idx->mapsz = st.st_size;
+	idx->map = map_file(fd, idx->mapsz, name);
+	close(fd);
+
+	idx->hdr = idx->map;
+	idx->ents = (struct look_index_entry *) (idx->hdr + 1);
+
+	if (!index_is_valid(idx, dict)) {
+		munmap(idx->map, idx->mapsz);
+		memset(idx, 0, sizeof(*idx));
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Writes a new index for the dictionary. The index is written to a
+ * temporary file and renamed, so the readers never see incomplete file.
+ */
+static int build_index(const char *name, char *front, char *back,
+		       struct stat *dict)
+{
+	struct look_index_header hdr;
+	struct look_index_entry *ents = NULL;
+	char *keys = NULL, *tmpname = NULL, *dir, *p;
+	size_t nents = 0, entsz = 0, keysz = 0, keyslen = 0;
+	int fd, rc = -1;
+
+	for (p = front; p < back; ) {
+		char *line = p;
+
+		if (nents == entsz) {
+			entsz = entsz ? entsz * 2 : 1024;
+			ents = xrealloc(ents, entsz * sizeof(*ents));
+		}
+		ents[nents].line = line - front;
+		ents[nents].key = keyslen;
+		nents++;
+
+		for (; p < back && *p != '\n'; p++) {
+			if (dflag && !isalnum((unsigned char) *p))
+				continue;
+			if (keyslen + 2 > keysz) {
+				keysz = keysz ? keysz * 2 : 64 * 1024;
+				keys = xrealloc(keys, keysz);
+			}
+			keys[keyslen++] = fflag ? tolower((unsigned char) *p) : *p;
+		}
+		if (keyslen + 1 > keysz) {
+			keysz = keysz ? keysz * 2 : 64 * 1024;
+			keys = xrealloc(keys, keysz);
+		}
+		keys[keyslen++] = '\0';
+		if (p < back)
+			p++;		/* skip newline */
+	}
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, LOOK_INDEX_MAGIC, sizeof(hdr.magic));
+	hdr.version = LOOK_INDEX_VERSION;
+	hdr.flags = index_flags();
+	hdr.dict_size = dict->st_size;
+	hdr.dict_mtime = dict->st_mtime;
+	hdr.dict_ino = dict->st_ino;
+	hdr.nents = nents;
+	hdr.keys_size = keyslen;
+
+	p = xstrdup(name);
+	dir = dirname(p);
+	fd = xmkstemp(&tmpname, dir);
+	free(p);
+	if (fd < 0)
+		goto done;
+
+	if (write_all(fd, &hdr, sizeof(hdr)) ||
+	    (nents && write_all(fd, ents, nents * sizeof(*ents))) ||
+	    (keyslen && write_all(fd, keys, keyslen)) ||
+	    fchmod(fd, 0644)) {
+		close(fd);
+		unlink(tmpname);
+		goto done;
+	}
+	if (close(fd) != 0 || rename(tmpname, name) != 0) {
+		unlink(tmpname);
+		goto done;
+	}
+	rc = 0;
+done:
+	free(tmpname);
+	free(ents);
+	free(keys);
+	return rc;
+}
+
 int
 main(int argc, char *argv[])
 {
 	struct stat sb;
-	int ch, fd, termchar;
-	char *back, *file, *front, *p;
+	struct look_query *queries, one;
+	struct look_index index, *idx = NULL;
+	size_t nqueries;
+	int ch, fd, termchar, bulk = 0;
+	char *back, *file, *front, *indexfile = NULL;
 
 	static const struct option longopts[] = {
 		{"alternative", no_argument, NULL, 'a'},
+		{"bulk", no_argument, NULL, 'b'},
 		{"alphanum", no_argument, NULL, 'd'},
 		{"ignore-case", no_argument, NULL, 'f'},
+		{"index", required_argument, NULL, 'i'},
 		{"terminate", required_argument, NULL, 't'},
 		{"version", no_argument, NULL, 'V'},
 		{"help", no_argument, NULL, 'h'},
@@ -108,17 +390,23 @@ main(int argc, char *argv[])
 	termchar = '\0';
 	string = NULL;		/* just for gcc */
 
-	while ((ch = getopt_long(argc, argv, "adft:Vh", longopts, NULL)) != -1)
+	while ((ch = getopt_long(argc, argv, "abdfi:t:Vh", longopts, NULL)) != -1)
 		switch(ch) {
 		case 'a':
 			file = _PATH_WORDS_ALT;
 			break;
+		case 'b':
+			bulk = 1;
+			break;
 		case 'd':
 			dflag = 1;
 			break;
 		case 'f':
 			fflag = 1;
 			break;
+		case 'i':
+			indexfile = optarg;
+			break;
 		case 't':
 			termchar = *optarg;
 			break;
@@ -136,36 +424,34 @@ main(int argc, char *argv[])
 	argc -= optind;
 	argv += optind;
 
-	switch (argc) {
+	/* the strings are read from stdin in bulk mode */
+	switch (argc + bulk) {
 	case 2:				/* Don't set -df for user. */
-		string = *argv++;
+		if (!bulk)
+			string = *argv++;
 		file = *argv;
 		break;
 	case 1:				/* But set -df by default. */
 		dflag = fflag = 1;
-		string = *argv;
+		if (!bulk)
+			string = *argv;
 		break;
 	default:
 		usage(stderr);
 	}
 
-	if (termchar != '\0' && (p = strchr(string, termchar)) != NULL)
-		*++p = '\0';
+	if (bulk)
+		queries = read_queries(stdin, &nqueries, termchar);
+	else {
+		memset(&one, 0, sizeof(one));
+		one.str = format_string(string, termchar);
+		queries = &one;
+		nqueries = 1;
+	}
 
 	if ((fd = open(file, O_RDONLY, 0)) < 0 || fstat(fd, &sb))
 		err(EXIT_FAILURE, "%s", file);
-	front = mmap(NULL, (size_t) sb.st_size, PROT_READ,
-#ifdef MAP_FILE
-		     MAP_FILE |
-#endif
-		     MAP_SHARED, fd, (off_t) 0);
-	if
-#ifdef MAP_FAILED
-		(front == MAP_FAILED)
-#else
-		((void *)(front) <= (void *)0)
-#endif
-			err(EXIT_FAILURE, "%s", file);
+	front = map_file(fd, (size_t) sb.st_size, file);
 
 #if 0
 	/* workaround for mmap problem (rmiller@duskglow.com) */
@@ -174,37 +460,139 @@ main(int argc, char *argv[])
 #endif
 
 	back = front + sb.st_size;
-	return look(front, back);
+
+	if (indexfile) {
+		if (open_index(&index, indexfile, &sb) == 0)
+			idx = &index;
+		else if (build_index(indexfile, front, back, &sb) == 0 &&
+			 open_index(&index, indexfile, &sb) == 0)
+			idx = &index;
+		else
+			warn(_("%s: cannot use index"), indexfile);
+	}
+
+	return look(queries, nqueries, front, back, idx);
 }
 
-int
-look(char *front, char *back)
+/*
+ * Returns the first index entry which is not GREATER than the string.
+ */
+static size_t
+index_search(struct look_index *idx, size_t lo)
 {
-	int ch;
-	char *readp, *writep;
+	size_t hi = idx->hdr->nents;
 
-	/* Reformat string string to avoid doing it multiple times later. */
-	if (dflag) {
-		for (readp = writep = string; (ch = *readp++) != 0;) {
-			if (isalnum(ch))
-				*(writep++) = ch;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (strncmp(idx->keys + idx->ents[mid].key,
+			    string, stringlen) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+static size_t
+index_lookup(struct look_index *idx, struct look_query *q,
+	     size_t cur, char *front, char *back)
+{
+	size_t n = idx->hdr->nents, end;
+
+	cur = end = index_search(idx, cur);
+
+	while (end < n && strncmp(idx->keys + idx->ents[end].key,
+				  string, stringlen) == 0)
+		end++;
+	if (end > cur) {
+		q->start = front + idx->ents[cur].line;
+		q->end = end < n ? front + idx->ents[end].line : back;
+	}
+	return cur;
+}
+
+#define	SKIP_PAST_NEWLINE(p, back) \
+	while (p < back && *p++ != '\n')
+
+/*
+ * Searches for the string from @cur, the strings are sorted, so @cur is
+ * the beginning of the line where the previous search stopped. The distance
+ * from @cur is doubled to find the range for binary_search(), so the search
+ * for close strings does not touch the rest of the file.
+ */
+static char *
+file_lookup(struct look_query *q, char *front, char *cur, char *back)
+{
+	size_t step = 4096;
+	char *p = cur, *end = back;
+	int rc = LESS;
+
+	while (cur > front && p < back) {
+		char *x = (size_t) (back - p) > step ? p + step : back;
+
+		SKIP_PAST_NEWLINE(x, back);
+		if (x >= back || compare(x, back) != GREATER) {
+			end = x;
+			break;
 		}
-		*writep = '\0';
-		stringlen = writep - string;
-	} else
+		p = x;
+		step *= 2;
+	}
+	p = binary_search(p, end);
+
+	while (p < back && (rc = compare(p, back)) == GREATER)
+		SKIP_PAST_NEWLINE(p, back);
+	cur = p;
+
+	if (p < back && rc == EQUAL) {
+		q->start = p;
+		while (p < back && compare(p, back) == EQUAL)
+			SKIP_PAST_NEWLINE(p, back);
+		q->end = p;
+	}
+	return cur;
+}
+
+int
+look(struct look_query *qs, size_t nqueries, char *front, char *back,
+     struct look_index *idx)
+{
+	size_t i, maxlen = 0, icur = 0;
+	char *cur = front;
+	int found = 0;
+
+	for (i = 0; i < nqueries; i++)
+		maxlen = max(maxlen, strlen(qs[i].str));
+	comparbuf = xmalloc(maxlen + 1);
+
+	if (nqueries > 1)
+		qsort(qs, nqueries, sizeof(*qs), cmp_query_str);
+
+	for (i = 0; i < nqueries; i++) {
+		string = qs[i].str;
 		stringlen = strlen(string);
 
-	comparbuf = xmalloc(stringlen+1);
+		if (idx)
+			icur = index_lookup(idx, &qs[i], icur, front, back);
+		else
+			cur = file_lookup(&qs[i], front, cur, back);
+	}
 
-	front = binary_search(front, back);
-	front = linear_search(front, back);
+	if (nqueries > 1)
+		qsort(qs, nqueries, sizeof(*qs), cmp_query_nr);
 
-	if (front)
-		print_from(front, back);
+	for (i = 0; i < nqueries; i++) {
+		if (!qs[i].start)
+			continue;
+		if (fwrite_all(qs[i].start, 1, qs[i].end - qs[i].start, stdout))
+			err(EXIT_FAILURE, "stdout");
+		found = 1;
+	}
 
 	free(comparbuf);
 
-	return (front ? 0 : 1);
+	return (found ? 0 : 1);
 }
 
 
@@ -242,9 +630,6 @@ look(char *front, char *back)
  * 	Trying to continue with binary search at this point would be
  *	more trouble than it's worth.
  */
-#define	SKIP_PAST_NEWLINE(p, back) \
-	while (p < back && *p++ != '\n')
-
 char *
 binary_search(char *front, char *back)
 {
@@ -268,58 +653,6 @@ binary_search(char *front, char *back)
 	return (front);
 }
 
-/*
- * Find the first line that starts with string, linearly searching from front
- * to back.
- *
- * Return NULL for no such line.
- *
- * This routine assumes:
- *
- * 	o front points at the first character in a line.
- *	o front is before or at the first line to be printed.
- */
-char *
-linear_search(char *front, char *back)
-{
-	while (front < back) {
-		switch (compare(front, back)) {
-		case EQUAL:		/* Found it. */
-			return (front);
-			break;
-		case LESS:		/* No such string. */
-			return (NULL);
-			break;
-		case GREATER:		/* Keep going. */
-			break;
-		}
-		SKIP_PAST_NEWLINE(front, back);
-	}
-	return (NULL);
-}
-
-/*
- * Print as many lines as match string, starting at front.
- */
-void
-print_from(char *front, char *back)
-{
-	int eol;
-
-	while (front < back && compare(front, back) == EQUAL) {
-		if (compare(front, back) == EQUAL) {
-			eol = 0;
-			while (front < back && !eol) {
-				if (putchar(*front) == EOF)
-					err(EXIT_FAILURE, "stdout");
-				if (*front++ == '\n')
-					eol = 1;
-			}
-		} else
-			SKIP_PAST_NEWLINE(front, back);
-	}
-}
-
 /*
  * Return LESS, GREATER, or EQUAL depending on how  string  compares with
  * string2 (s1 ??? s2).
@@ -367,12 +700,15 @@ static void __attribute__ ((__noreturn__)) usage(FILE * out)
 {
 	fputs(_("\nUsage:\n"), out),
 	fprintf(out,
-	      _(" %s [options] string [file]\n"), program_invocation_short_name);
+	      _(" %1$s [options] string [file]\n"
+		" %1$s [options] --bulk [file] < strings\n"), program_invocation_short_name);
 
 	fputs(_("\nOptions:\n"), out);
 	fputs(_(" -a, --alternative      use alternate dictionary\n"
+		" -b, --bulk             read strings from standard input\n"
 		" -d, --alphanum         compare only alpha numeric characters\n"
 		" -f, --ignore-case      ignore when comparing\n"
+		" -i, --index <file>     use (or create) index of the dictionary\n"
 		" -t, --terminate <char> define string termination character\n"
 		" -V, --version          output version information and exit\n"
 		" -h, --help             display this help and exit\n\n"), out);
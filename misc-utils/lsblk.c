@@ -932,6 +932,9 @@ static int set_cxt(struct blkdev_cxt *cxt,
 			return -1;
 		}
 	}
+	/* the context is parent for partitions and slaves, don't re-read
+	 * the queue/ attributes for all of them */
+	sysfs_set_memoize(&cxt->sysfs, 1);
 
 	cxt->maj = major(devno);
 	cxt->min = minor(devno);
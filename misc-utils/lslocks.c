@@ -28,6 +28,7 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <dirent.h>
+#include <search.h>
 #include <unistd.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -79,6 +80,37 @@ static struct colinfo infos[] = {
 static int columns[NCOLS], ncolumns;
 static pid_t pid = 0;
 
+/*
+ * Open files of one process, the array is sorted by inode numbers. The index
+ * is built when the process is seen for the first time and it is used for
+ * all its locks, so /proc/<pid>/fd is scanned only once.
+ */
+struct proc_file {
+	dev_t	dev;
+	ino_t	inode;
+	off_t	size;
+	char	*path;
+};
+
+struct proc_files {
+	pid_t		pid;
+	char		*cmdname;
+	struct proc_file *files;
+	size_t		nfiles;
+};
+
+static void *proc_files_tree;		/* tsearch() tree of struct proc_files */
+
+/* mountinfo device to mountpoint map, used when the file is not found */
+struct mnt_target {
+	dev_t	dev;
+	char	*target;
+};
+
+static struct mnt_target *mnt_targets;
+static size_t nmnt_targets;
+static int mnt_targets_read;
+
 struct lock {
 	struct list_head locks;
 
@@ -128,53 +160,67 @@ out:
  */
 static char *get_fallback_filename(dev_t dev)
 {
-	char buf[BUFSIZ], target[PATH_MAX], *ret = NULL;
-	int maj, min;
-	FILE *fp;
+	size_t i;
 
-	if (!(fp = fopen(_PATH_PROC_MOUNTINFO, "r")))
-		return NULL;
+	if (!mnt_targets_read) {
+		char buf[BUFSIZ], target[PATH_MAX];
+		unsigned int maj, min;
+		FILE *fp;
+
+		mnt_targets_read = 1;
+		if (!(fp = fopen(_PATH_PROC_MOUNTINFO, "r")))
+			return NULL;
+
+		while (fgets(buf, sizeof(buf), fp)) {
+			if (sscanf(buf, "%*u %*u %u:%u %*s %s",
+				   &maj, &min, target) != 3)
+				continue;
+			mnt_targets = xrealloc(mnt_targets, (nmnt_targets + 1)
+						* sizeof(struct mnt_target));
+			mnt_targets[nmnt_targets].dev = makedev(maj, min);
+			mnt_targets[nmnt_targets].target = xstrdup(target);
+			nmnt_targets++;
+		}
+		fclose(fp);
+	}
 
-	while (fgets(buf, sizeof(buf), fp)) {
-		sscanf(buf, "%*u %*u %u:%u %*s %s",
-			    &maj, &min, target);
+	for (i = 0; i < nmnt_targets; i++) {
+		if (mnt_targets[i].dev == dev)
+			return xstrdup(mnt_targets[i].target);
+	}
+	return NULL;
+}
+
+static int cmp_proc_file(const void *a, const void *b)
+{
+	const struct proc_file *fa = a, *fb = b;
 
-		if (dev == makedev(maj, min)) {
-			ret = xstrdup(target);
-			goto out;
+	return fa->inode < fb->inode ? -1 : fa->inode > fb->inode;
+}
 
-		}
-	}
-out:
-	fclose(fp);
-	return ret;
+static int cmp_proc_files(const void *a, const void *b)
+{
+	const struct proc_files *pa = a, *pb = b;
+
+	return pa->pid < pb->pid ? -1 : pa->pid > pb->pid;
 }
 
 /*
- * Return the absolute path of a file from
- * a given inode number (and its size)
+ * Read all descriptors from /proc/<pid>/fd
  */
-static char *get_filename_sz(ino_t inode, pid_t pid, size_t *size)
+static void read_proc_files(struct proc_files *pf)
 {
 	struct stat sb;
 	struct dirent *dp;
 	DIR *dirp;
-	size_t len;
+	size_t len, allocated = 0;
+	ssize_t sz;
 	int fd;
-	char path[PATH_MAX], sym[PATH_MAX], *ret = NULL;
-
-	*size = 0;
-	memset(path, 0, sizeof(path));
-	memset(sym, 0, sizeof(sym));
+	char path[PATH_MAX], sym[PATH_MAX];
 
-	/*
-	 * We know the pid so we don't have to
-	 * iterate the *entire* filesystem searching
-	 * for the damn file.
-	 */
-	sprintf(path, "/proc/%d/fd/", pid);
+	sprintf(path, "/proc/%d/fd/", pf->pid);
 	if (!(dirp = opendir(path)))
-		return NULL;
+		return;
 
 	if ((len = strlen(path)) >= (sizeof(path) - 2))
 		goto out;
@@ -183,6 +229,8 @@ static char *get_filename_sz(ino_t inode, pid_t pid, size_t *size)
 		goto out;
 
 	while ((dp = readdir(dirp))) {
+		struct proc_file *f;
+
 		if (!strcmp(dp->d_name, ".") ||
 		    !strcmp(dp->d_name, ".."))
 			continue;
@@ -191,23 +239,96 @@ static char *get_filename_sz(ino_t inode, pid_t pid, size_t *size)
 		if (!strtol(dp->d_name, (char **) NULL, 10))
 			continue;
 
-		if (!fstat_at(fd, path, dp->d_name, &sb, 0)
-		    && inode != sb.st_ino)
+		if (fstat_at(fd, path, dp->d_name, &sb, 0))
 			continue;
 
-		if ((len = readlink_at(fd, path, dp->d_name,
-				       sym, sizeof(sym) - 1)) < 1)
-			goto out;
-
-		*size = sb.st_size;
-		sym[len] = '\0';
+		if ((sz = readlink_at(fd, path, dp->d_name,
+				      sym, sizeof(sym) - 1)) < 1)
+			continue;
+		sym[sz] = '\0';
 
-		ret = xstrdup(sym);
-		break;
+		if (pf->nfiles == allocated) {
+			allocated = allocated ? allocated * 2 : 16;
+			pf->files = xrealloc(pf->files,
+					allocated * sizeof(struct proc_file));
+		}
+		f = &pf->files[pf->nfiles++];
+		f->dev = sb.st_dev;
+		f->inode = sb.st_ino;
+		f->size = sb.st_size;
+		f->path = xstrdup(sym);
 	}
+
+	if (pf->nfiles)
+		qsort(pf->files, pf->nfiles, sizeof(struct proc_file),
+		      cmp_proc_file);
 out:
 	closedir(dirp);
-	return ret;
+}
+
+/*
+ * Return the PID's open files index, the index is created on the first call
+ */
+static struct proc_files *get_proc_files(pid_t id)
+{
+	struct proc_files key = { .pid = id }, *pf;
+	void *res;
+
+	res = tfind(&key, &proc_files_tree, cmp_proc_files);
+	if (res)
+		return *(struct proc_files **) res;
+
+	pf = xcalloc(1, sizeof(*pf));
+	pf->pid = id;
+	pf->cmdname = get_cmdname(id);
+	read_proc_files(pf);
+
+	if (!tsearch(pf, &proc_files_tree, cmp_proc_files))
+		err(EXIT_FAILURE, _("failed to allocate memory"));
+	return pf;
+}
+
+static void free_proc_files(void *data)
+{
+	struct proc_files *pf = data;
+	size_t i;
+
+	for (i = 0; i < pf->nfiles; i++)
+		free(pf->files[i].path);
+	free(pf->files);
+	free(pf->cmdname);
+	free(pf);
+}
+
+/*
+ * Return the open file with the given inode number. The device number is
+ * preferred, but it does not have to match (e.g. btrfs subvolumes have
+ * a different st_dev than the device number in /proc/locks).
+ */
+static struct proc_file *find_proc_file(struct proc_files *pf,
+					dev_t dev, ino_t inode)
+{
+	struct proc_file key = { .inode = inode }, *f, *first, *end;
+
+	if (!pf->nfiles)
+		return NULL;
+
+	f = bsearch(&key, pf->files, pf->nfiles, sizeof(struct proc_file),
+		    cmp_proc_file);
+	if (!f)
+		return NULL;
+
+	/* go to the first file with the inode number */
+	while (f > pf->files && (f - 1)->inode == inode)
+		f--;
+
+	first = f;
+	end = pf->files + pf->nfiles;
+	for (; f < end && f->inode == inode; f++) {
+		if (f->dev == dev)
+			return f;
+	}
+	return first;
 }
 
 /*
@@ -229,9 +350,10 @@ static int get_local_locks(struct list_head *locks)
 	int i;
 	ino_t inode = 0;
 	FILE *fp;
-	char buf[PATH_MAX], *szstr = NULL, *tok = NULL;
-	size_t sz;
+	char buf[PATH_MAX], *tok = NULL;
 	struct lock *l;
+	struct proc_files *pf;
+	struct proc_file *f;
 	dev_t dev = 0;
 
 	if (!(fp = fopen(_PATH_PROC_LOCKS, "r")))
@@ -269,9 +391,6 @@ static int get_local_locks(struct list_head *locks)
 				 * to the list, no need to worry now.
 				 */
 				l->pid = strtos32_or_err(tok, _("failed to parse pid"));
-				l->cmdname = get_cmdname(l->pid);
-				if (!l->cmdname)
-					l->cmdname = xstrdup(_("(unknown)"));
 				break;
 
 			case 5: /* device major:minor and inode number */
@@ -292,16 +411,6 @@ static int get_local_locks(struct list_head *locks)
 			default:
 				break;
 			}
-
-			l->path = get_filename_sz(inode, l->pid, &sz);
-			if (!l->path)
-				/* probably no permission to peek into l->pid's path */
-				l->path = get_fallback_filename(dev);
-
-			/* avoid leaking */
-			szstr = size_to_human_string(SIZE_SUFFIX_1LETTER, sz);
-			l->size = xstrdup(szstr);
-			free(szstr);
 		}
 
 		if (pid && pid != l->pid) {
@@ -310,16 +419,26 @@ static int get_local_locks(struct list_head *locks)
 			 * it should be added to the list - otherwise just
 			 * get rid of stored data
 			 */
-			free(l->path);
-			free(l->size);
 			free(l->mode);
-			free(l->cmdname);
 			free(l->type);
 			free(l);
 
 			continue;
 		}
 
+		pf = get_proc_files(l->pid);
+		l->cmdname = xstrdup(pf->cmdname ? pf->cmdname : _("(unknown)"));
+
+		f = find_proc_file(pf, dev, inode);
+		if (f)
+			l->path = xstrdup(f->path);
+		else
+			/* probably no permission to peek into l->pid's path */
+			l->path = get_fallback_filename(dev);
+
+		l->size = size_to_human_string(SIZE_SUFFIX_1LETTER,
+					       f ? f->size : 0);
+
 		list_add(&l->locks, locks);
 	}
 
@@ -327,6 +446,20 @@ static int get_local_locks(struct list_head *locks)
 	return 0;
 }
 
+static void free_caches(void)
+{
+	size_t i;
+
+	tdestroy(proc_files_tree, free_proc_files);
+	proc_files_tree = NULL;
+
+	for (i = 0; i < nmnt_targets; i++)
+		free(mnt_targets[i].target);
+	free(mnt_targets);
+	mnt_targets = NULL;
+	nmnt_targets = 0;
+}
+
 static int column_name_to_id(const char *name, size_t namesz)
 {
 	size_t i;
@@ -566,6 +699,7 @@ int main(int argc, char *argv[])
 	}
 
 	rc = get_local_locks(&locks);
+	free_caches();
 
 	if (!rc && !list_empty(&locks))
 		rc = show_locks(&locks, tt_flags);
@@ -134,6 +134,39 @@ static char sflag = 1, bflag = 1, mflag = 1, uflag;
 static char **Sflag, **Bflag, **Mflag, **pathdir, **pathdir_p;
 static int Scnt, Bcnt, Mcnt, count, print;
 
+/*
+ * The directories are read only once, all names are looked up in the
+ * in-memory index. The entries are hashed by key (see name_key()), the
+ * hash chains keep readdir() order.
+ */
+struct wh_node {
+	struct wh_node	*next;		/* next in the hash chain */
+	const char	*name;		/* directory entry name */
+	size_t		keyoff;		/* key within name */
+	size_t		keylen;
+};
+
+struct wh_dir {
+	char		*path;
+	struct wh_node	**hash;
+	size_t		hashsz;		/* power of 2 */
+	struct wh_node	*nodes;
+	char		**names;
+	size_t		nnames;
+	struct wh_dir	*next;
+};
+
+/* wildcard directory (e.g. from mandirs[]) and the matching directories */
+struct wh_glob {
+	char		*pattern;
+	char		**dirs;
+	size_t		ndirs;
+	struct wh_glob	*next;
+};
+
+static struct wh_dir *dircache;
+static struct wh_glob *globcache;
+
 static void __attribute__ ((__noreturn__)) usage(FILE * out)
 {
 	fputs(_("\nUsage:\n"), out);
@@ -185,8 +218,117 @@ itsit(char *cp, char *dp)
 	return 0;
 }
 
+/*
+ * Returns the part of @name which has to be the same for all names matched
+ * by itsit(), that is the name up to the first '.' without trailing digits.
+ */
+static size_t
+name_key(const char *name)
+{
+	size_t len = strcspn(name, ".");
+
+	while (len > 0 && isdigit((unsigned char) name[len - 1]))
+		len--;
+	return len;
+}
+
+static size_t
+key_hash(const char *key, size_t len)
+{
+	size_t h = 5381;
+
+	while (len--)
+		h = (h << 5) + h + (unsigned char) *key++;
+	return h;
+}
+
 static void
-findin(char *dir, char *cp)
+add_node(struct wh_dir *d, size_t *nnodes, const char *name, size_t keyoff)
+{
+	struct wh_node *n = &d->nodes[(*nnodes)++];
+	struct wh_node **tail;
+
+	n->name = name;
+	n->keyoff = keyoff;
+	n->keylen = name_key(name + keyoff);
+	n->next = NULL;
+
+	/* append to keep readdir() order */
+	tail = &d->hash[key_hash(name + keyoff, n->keylen) & (d->hashsz - 1)];
+	while (*tail)
+		tail = &(*tail)->next;
+	*tail = n;
+}
+
+static void
+index_dir(struct wh_dir *d)
+{
+	size_t i, nnodes = 0, max = 0;
+
+	for (i = 0; i < d->nnames; i++) {
+		const char *p = d->names[i];
+
+		/* itsit() matches "s.<name>" also as <name> */
+		for (max++; p[0] == 's' && p[1] == '.'; p += 2)
+			max++;
+	}
+
+	for (d->hashsz = 16; d->hashsz < max; d->hashsz <<= 1)
+		;
+	d->hash = xcalloc(d->hashsz, sizeof(struct wh_node *));
+	d->nodes = xcalloc(max ? max : 1, sizeof(struct wh_node));
+
+	for (i = 0; i < d->nnames; i++) {
+		const char *name = d->names[i];
+		size_t off = 0, keylen = name_key(name);
+
+		add_node(d, &nnodes, name, 0);
+
+		while (name[off] == 's' && name[off + 1] == '.') {
+			off += 2;
+			/* don't add the same name twice for the same key */
+			if (name_key(name + off) == keylen &&
+			    !strncmp(name + off, name, keylen))
+				continue;
+			add_node(d, &nnodes, name, off);
+		}
+	}
+}
+
+static struct wh_dir *
+read_dir(const char *path)
+{
+	struct wh_dir *d;
+	DIR *dirp;
+	struct dirent *dp;
+	size_t sz = 0;
+
+	for (d = dircache; d; d = d->next)
+		if (!strcmp(d->path, path))
+			return d;
+
+	d = xcalloc(1, sizeof(*d));
+	d->path = xstrdup(path);
+	d->next = dircache;
+	dircache = d;
+
+	dirp = opendir(path);
+	if (dirp) {
+		while ((dp = readdir(dirp)) != NULL) {
+			if (d->nnames == sz) {
+				sz = sz ? sz * 2 : 64;
+				d->names = xrealloc(d->names, sz * sizeof(char *));
+			}
+			d->names[d->nnames++] = xstrdup(dp->d_name);
+		}
+		closedir(dirp);
+	}
+	index_dir(d);
+	return d;
+}
+
+static void
+expand_glob(struct wh_glob *g, const char *dir)
 {
 	DIR *dirp;
 	struct dirent *dp;
@@ -197,17 +339,8 @@ findin(char *dir, char *cp)
 
 	dd = strchr(dir, '*');
 	if (!dd) {
-		dirp = opendir(dir);
-		if (dirp == NULL)
-			return;
-		while ((dp = readdir(dirp)) != NULL) {
-			if (itsit(cp, dp->d_name)) {
-				count++;
-				if (print)
-					printf(" %s/%s", dir, dp->d_name);
-			}
-		}
-		closedir(dirp);
+		g->dirs = xrealloc(g->dirs, (g->ndirs + 1) * sizeof(char *));
+		g->dirs[g->ndirs++] = xstrdup(dir);
 		return;
 	}
 
@@ -233,12 +366,90 @@ findin(char *dir, char *cp)
 			if (!S_ISDIR(statbuf.st_mode))
 				continue;
 			strcat(d, dd + 1);
-			findin(dirbuf, cp);
+			expand_glob(g, dirbuf);
 		}
 		closedir(dirp);
 	}
-	return;
+}
+
+static struct wh_glob *
+read_glob(const char *pattern)
+{
+	struct wh_glob *g;
+
+	for (g = globcache; g; g = g->next)
+		if (!strcmp(g->pattern, pattern))
+			return g;
+
+	g = xcalloc(1, sizeof(*g));
+	g->pattern = xstrdup(pattern);
+	g->next = globcache;
+	globcache = g;
+
+	expand_glob(g, pattern);
+	return g;
+}
+
+static void
+findin_dir(struct wh_dir *d, char *cp)
+{
+	size_t keylen = name_key(cp);
+	struct wh_node *n;
+
+	n = d->hash[key_hash(cp, keylen) & (d->hashsz - 1)];
+
+	for (; n; n = n->next) {
+		if (n->keylen != keylen ||
+		    strncmp(n->name + n->keyoff, cp, keylen))
+			continue;
+		if (itsit(cp, (char *) n->name)) {
+			count++;
+			if (print)
+				printf(" %s/%s", d->path, n->name);
+		}
+	}
+}
 
+static void
+findin(char *dir, char *cp)
+{
+	if (strchr(dir, '*')) {
+		struct wh_glob *g = read_glob(dir);
+		size_t i;
+
+		for (i = 0; i < g->ndirs; i++)
+			findin_dir(read_dir(g->dirs[i]), cp);
+	} else
+		findin_dir(read_dir(dir), cp);
+}
+
+static void
+free_caches(void)
+{
+	while (dircache) {
+		struct wh_dir *d = dircache;
+		size_t i;
+
+		dircache = d->next;
+		for (i = 0; i < d->nnames; i++)
+			free(d->names[i]);
+		free(d->names);
+		free(d->nodes);
+		free(d->hash);
+		free(d->path);
+		free(d);
+	}
+	while (globcache) {
+		struct wh_glob *g = globcache;
+		size_t i;
+
+		globcache = g->next;
+		for (i = 0; i < g->ndirs; i++)
+			free(g->dirs[i]);
+		free(g->dirs);
+		free(g->pattern);
+		free(g);
+	}
 }
 
 static int inpath(const char *str)
@@ -482,5 +693,6 @@ main(int argc, char **argv)
 	while (--argc > 0);
 
 	freepath();
+	free_caches();
 	return EXIT_SUCCESS;
 }
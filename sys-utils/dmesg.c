@@ -21,6 +21,7 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <poll.h>
 
 #include "c.h"
 #include "colors.h"
@@ -122,6 +123,14 @@ struct dmesg_control {
 	struct tm	lasttm;		/* last localtime */
 	time_t		boot_time;	/* system boot time */
 
+	/* record_localtime() and record_ctime() caches */
+	time_t		cache_time;	/* time of cache_tm */
+	struct tm	cache_tm;
+	time_t		cache_ctime_time; /* time of cache_ctime */
+	char		cache_ctime[64];
+
+	uint64_t	resume_seqnum;	/* --resume, skip records <= seqnum */
+
 	int		action;		/* SYSLOG_ACTION_* */
 	int		method;		/* DMESG_METHOD_* */
 
@@ -149,7 +158,9 @@ struct dmesg_control {
 			delta:1,	/* show time deltas */
 			reltime:1,	/* show human readable relative times */
 			ctime:1,	/* show human readable time */
-			color:1;	/* colorize messages */
+			color:1,	/* colorize messages */
+			resume:1,	/* resume_seqnum is set */
+			seqnum:1;	/* print sequence numbers */
 };
 
 struct dmesg_record {
@@ -159,6 +170,7 @@ struct dmesg_record {
 	int		level;
 	int		facility;
 	struct timeval  tv;
+	uint64_t	seqnum;		/* /dev/kmsg only */
 
 	const char	*next;		/* buffer with next unparsed record */
 	size_t		next_size;	/* size of the next buffer */
@@ -171,6 +183,7 @@ struct dmesg_record {
 		(_r)->level = -1; \
 		(_r)->tv.tv_sec = 0; \
 		(_r)->tv.tv_usec = 0; \
+		(_r)->seqnum = 0; \
 	} while (0)
 
 static int read_kmsg(struct dmesg_control *ctl);
@@ -217,6 +230,8 @@ static void __attribute__((__noreturn__)) usage(FILE *out)
 		" -l, --level <list>          restrict output to defined levels\n"
 		" -n, --console-level <level> set level of messages printed to console\n"
 		" -r, --raw                   print the raw message buffer\n"
+		"     --resume <seqnum>       print only messages after the sequence number\n"
+		"     --seqnum                print message sequence numbers\n"
 		" -S, --syslog                force to use syslog(2) rather than /dev/kmsg\n"
 		" -s, --buffer-size <size>    buffer size to query the kernel ring buffer\n"
 		" -T, --ctime                 show human readable timestamp (could be \n"
@@ -733,12 +748,27 @@ static void raw_print(struct dmesg_control *ctl, const char *buf, size_t size)
 		putchar('\n');
 }
 
+/*
+ * The messages usually come in bursts, so the last localtime_r() result is
+ * reused for all records within the same minute.
+ */
 static struct tm *record_localtime(struct dmesg_control *ctl,
 				   struct dmesg_record *rec,
 				   struct tm *tm)
 {
 	time_t t = ctl->boot_time + rec->tv.tv_sec;
-	return localtime_r(&t, tm);
+	time_t min = ctl->cache_time - ctl->cache_tm.tm_sec;
+
+	if (ctl->cache_time && t >= min && t < min + 60) {
+		*tm = ctl->cache_tm;
+		tm->tm_sec = t - min;
+		return tm;
+	}
+	if (!localtime_r(&t, tm))
+		return NULL;
+	ctl->cache_time = t;
+	ctl->cache_tm = *tm;
+	return tm;
 }
 
 static char *record_ctime(struct dmesg_control *ctl,
@@ -746,11 +776,18 @@ static char *record_ctime(struct dmesg_control *ctl,
 			  char *buf, size_t bufsiz)
 {
 	struct tm tm;
+	time_t t = ctl->boot_time + rec->tv.tv_sec;
 
-	record_localtime(ctl, rec, &tm);
+	if (!ctl->cache_ctime_time || ctl->cache_ctime_time != t) {
+		record_localtime(ctl, rec, &tm);
 
-	if (strftime(buf, bufsiz, "%a %b %e %H:%M:%S %Y", &tm) == 0)
-		*buf = '\0';
+		if (strftime(ctl->cache_ctime, sizeof(ctl->cache_ctime),
+			     "%a %b %e %H:%M:%S %Y", &tm) == 0)
+			*ctl->cache_ctime = '\0';
+		ctl->cache_ctime_time = t;
+	}
+
+	xstrncpy(buf, ctl->cache_ctime, bufsiz);
 	return buf;
 }
 
@@ -787,6 +824,9 @@ static void print_record(struct dmesg_control *ctl,
 		return;
 	}
 
+	if (ctl->seqnum)
+		printf("%ju ", (uintmax_t) rec->seqnum);
+
 	/*
 	 * compose syslog(2) compatible raw output -- used for /dev/kmsg for
 	 * backward compatibility with syslog(2) buffers only
@@ -907,12 +947,11 @@ static ssize_t read_kmsg_one(struct dmesg_control *ctl)
 
 static int init_kmsg(struct dmesg_control *ctl)
 {
-	int mode = O_RDONLY;
-
-	if (!ctl->follow)
-		mode |= O_NONBLOCK;
-
-	ctl->kmsg = open("/dev/kmsg", mode);
+	/*
+	 * The device is always non-blocking, read_kmsg() reads all
+	 * available records and then waits in poll() for --follow.
+	 */
+	ctl->kmsg = open("/dev/kmsg", O_RDONLY | O_NONBLOCK);
 	if (ctl->kmsg < 0)
 		return -1;
 
@@ -932,6 +971,8 @@ static int init_kmsg(struct dmesg_control *ctl)
 	 * read_kmsg().
 	 */
 	ctl->kmsg_first_read = read_kmsg_one(ctl);
+	if (ctl->kmsg_first_read < 0 && errno == EAGAIN)
+		ctl->kmsg_first_read = 0;	/* empty buffer */
 	if (ctl->kmsg_first_read < 0) {
 		close(ctl->kmsg);
 		ctl->kmsg = -1;
@@ -976,10 +1017,24 @@ static int parse_kmsg_record(struct dmesg_control *ctl,
 		p = parse_faclev(p, &rec->facility, &rec->level);
 	else
 		p = skip_item(p, end, ",");
+
+	/* the filters are applied before the rest of the record is parsed */
+	if ((ctl->fltr_lev || ctl->fltr_fac) && !accept_record(ctl, rec))
+		return 1;
 	if (LAST_KMSG_FIELD(p))
 		goto mesg;
 
 	/* B) sequence number */
+	if (ctl->resume || ctl->seqnum) {
+		char *x = NULL;
+
+		errno = 0;
+		rec->seqnum = strtoumax(p, &x, 10);
+		if (errno || !x || x == p)
+			return -1;
+		if (ctl->resume && rec->seqnum <= ctl->resume_seqnum)
+			return 1;
+	}
 	p = skip_item(p, end, ",;");
 	if (LAST_KMSG_FIELD(p))
 		goto mesg;
@@ -1026,11 +1081,15 @@ mesg:
  * So this function does not compose one huge buffer (like read_syslog_buffer())
  * and print_buffer() is unnecessary. All is done in this function.
  *
+ * The records are read by non-blocking read() until the buffer is drained;
+ * for --follow the output is flushed and we wait in poll() for more data.
+ *
  * Returns 0 on success, -1 on error.
  */
 static int read_kmsg(struct dmesg_control *ctl)
 {
 	struct dmesg_record rec;
+	struct pollfd pfd = { .fd = ctl->kmsg, .events = POLLIN };
 	ssize_t sz;
 
 	if (ctl->method != DMESG_METHOD_KMSG || ctl->kmsg < 0)
@@ -1043,15 +1102,25 @@ static int read_kmsg(struct dmesg_control *ctl)
 	 */
 	sz = ctl->kmsg_first_read;
 
-	while (sz > 0) {
-		*(ctl->kmsg_buf + sz) = '\0';	/* for debug messages */
+	do {
+		while (sz > 0) {
+			*(ctl->kmsg_buf + sz) = '\0';	/* for debug messages */
+
+			if (parse_kmsg_record(ctl, &rec,
+					      ctl->kmsg_buf, (size_t) sz) == 0)
+				print_record(ctl, &rec);
 
-		if (parse_kmsg_record(ctl, &rec,
-				      ctl->kmsg_buf, (size_t) sz) == 0)
-			print_record(ctl, &rec);
+			sz = read_kmsg_one(ctl);
+		}
+		if (!ctl->follow || (sz < 0 && errno != EAGAIN))
+			break;
 
+		/* all available records printed, wait for the next one */
+		fflush(stdout);
+		if (poll(&pfd, 1, -1) < 0 && errno != EINTR)
+			break;
 		sz = read_kmsg_one(ctl);
-	}
+	} while (1);
 
 	return 0;
 }
@@ -1073,6 +1142,11 @@ int main(int argc, char *argv[])
 		.kmsg = -1,
 	};
 
+	enum {
+		OPT_RESUME = CHAR_MAX + 1,
+		OPT_SEQNUM
+	};
+
 	static const struct option longopts[] = {
 		{ "buffer-size",   required_argument, NULL, 's' },
 		{ "clear",         no_argument,	      NULL, 'C' },
@@ -1090,6 +1164,8 @@ int main(int argc, char *argv[])
 		{ "syslog",        no_argument,       NULL, 'S' },
 		{ "raw",           no_argument,       NULL, 'r' },
 		{ "read-clear",    no_argument,	      NULL, 'c' },
+		{ "resume",        required_argument, NULL, OPT_RESUME },
+		{ "seqnum",        no_argument,       NULL, OPT_SEQNUM },
 		{ "reltime",       no_argument,       NULL, 'e' },
 		{ "show-delta",    no_argument,	      NULL, 'd' },
 		{ "ctime",         no_argument,       NULL, 'T' },
@@ -1203,6 +1279,14 @@ int main(int argc, char *argv[])
 		case 'x':
 			ctl.decode = 1;
 			break;
+		case OPT_RESUME:
+			ctl.resume_seqnum = strtou64_or_err(optarg,
+					_("invalid sequence number argument"));
+			ctl.resume = 1;
+			break;
+		case OPT_SEQNUM:
+			ctl.seqnum = 1;
+			break;
 		case '?':
 		default:
 			usage(stderr);
@@ -1229,6 +1313,10 @@ int main(int argc, char *argv[])
 	case SYSLOG_ACTION_READ_CLEAR:
 		if (ctl.method == DMESG_METHOD_KMSG && init_kmsg(&ctl) != 0)
 			ctl.method = DMESG_METHOD_SYSLOG;
+		if ((ctl.resume || ctl.seqnum) &&
+		    ctl.method != DMESG_METHOD_KMSG)
+			errx(EXIT_FAILURE, _("--resume and --seqnum are "
+				"supported for /dev/kmsg only"));
 
 		n = read_buffer(&ctl, &buf);
 		if (n > 0)
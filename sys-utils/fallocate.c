@@ -31,6 +31,7 @@
 #include <unistd.h>
 #include <getopt.h>
 #include <limits.h>
+#include <string.h>
 
 #ifndef HAVE_FALLOCATE
 # include <sys/syscall.h>
@@ -52,6 +53,13 @@
 #include "strutils.h"
 #include "c.h"
 #include "closestream.h"
+#include "xalloc.h"
+
+/* buffer size used to scan the file for zero blocks in --dig-holes mode */
+#define DIG_BUFSZ	(1024 * 1024)
+
+static int verbose;
+static char *filename;
 
 static void __attribute__((__noreturn__)) usage(FILE *out)
 {
@@ -59,10 +67,12 @@ static void __attribute__((__noreturn__)) usage(FILE *out)
 	fprintf(out,
 	      _(" %s [options] <filename>\n"), program_invocation_short_name);
 	fputs(USAGE_OPTIONS, out);
-	fputs(_(" -n, --keep-size     don't modify the length of the file\n"
+	fputs(_(" -d, --dig-holes     detect and dig holes\n"
+		" -n, --keep-size     don't modify the length of the file\n"
 		" -p, --punch-hole    punch holes in the file\n"
 		" -o, --offset <num>  offset of the allocation, in bytes\n"
-		" -l, --length <num>  length of the allocation, in bytes\n"), out);
+		" -l, --length <num>  length of the allocation, in bytes\n"
+		" -v, --verbose       verbose mode\n"), out);
 	fputs(USAGE_SEPARATOR, out);
 	fputs(USAGE_HELP, out);
 	fputs(USAGE_VERSION, out);
@@ -81,13 +91,178 @@ static loff_t cvtnum(char *s)
 	return x;
 }
 
+static void xfallocate(int fd, int mode, off_t offset, off_t length)
+{
+	int error;
+
+#ifdef HAVE_FALLOCATE
+	error = fallocate(fd, mode, offset, length);
+#else
+	error = syscall(SYS_fallocate, fd, mode, offset, length);
+#endif
+	/*
+	 * EOPNOTSUPP: The FALLOC_FL_KEEP_SIZE is unsupported
+	 * ENOSYS: The filesystem does not support sys_fallocate
+	 */
+	if (error < 0) {
+		if ((mode & FALLOC_FL_KEEP_SIZE) && errno == EOPNOTSUPP)
+			errx(EXIT_FAILURE,
+				_("keep size mode (-n option) unsupported"));
+		err(EXIT_FAILURE, _("%s: fallocate failed"), filename);
+	}
+}
+
+/*
+ * Returns 1 if the buffer contains zeros only. The first bytes are checked
+ * one by one, and the rest of the buffer is compared against itself shifted
+ * by that prefix. This way memcmp() does the work with its word-sized (or
+ * vectorized) loop and no zero-filled reference buffer is necessary.
+ */
+static int is_nul(const void *buf, size_t bufsz)
+{
+	const unsigned char *p = buf;
+	size_t n = min(bufsz, (size_t) 16);
+
+	while (n--) {
+		if (*p++)
+			return 0;
+	}
+	return bufsz <= 16 || memcmp(buf, p, bufsz - 16) == 0;
+}
+
+/*
+ * Returns the end of the data area (the start of the next hole) for the data
+ * area at @off, or @end if SEEK_DATA/SEEK_HOLE are not supported. Sets @off
+ * to the start of the data or returns -1 if there is no more data.
+ */
+static off_t next_data(int fd, off_t *off, off_t end)
+{
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+	off_t data, hole;
+
+	data = lseek(fd, *off, SEEK_DATA);
+	if (data < 0) {
+		if (errno == ENXIO)
+			return -1;		/* no more data */
+		if (errno == EINVAL)
+			return end;		/* unsupported */
+		err(EXIT_FAILURE, _("%s: seek failed"), filename);
+	}
+	if (data >= end)
+		return -1;
+
+	hole = lseek(fd, data, SEEK_HOLE);
+	if (hole < 0)
+		err(EXIT_FAILURE, _("%s: seek failed"), filename);
+
+	*off = data;
+	return min(hole, end);
+#else
+	return *off < end ? end : -1;
+#endif
+}
+
+/*
+ * Scans the file for blocks that contain zeros only and punches them out,
+ * the already existing holes are skipped.
+ */
+static void dig_holes(int fd, off_t off, off_t len)
+{
+	struct stat st;
+	off_t end, hole_start = 0, hole_sz = 0;
+	blkcnt_t blocks;
+	size_t blksz, bufsz;
+	char *buf;
+
+	if (fstat(fd, &st) != 0)
+		err(EXIT_FAILURE, _("stat failed %s"), filename);
+
+	blksz = st.st_blksize > 0 ? st.st_blksize : 4096;
+	bufsz = DIG_BUFSZ > blksz ? DIG_BUFSZ - DIG_BUFSZ % blksz : blksz;
+	blocks = st.st_blocks;
+
+	end = len ? off + len : st.st_size;
+	if (end > st.st_size)
+		end = st.st_size;
+
+	/* holes are dug in whole blocks only */
+	off = (off + blksz - 1) / blksz * blksz;
+
+	buf = xmalloc(bufsz);
+
+#if defined(POSIX_FADV_SEQUENTIAL) && defined(HAVE_POSIX_FADVISE)
+	posix_fadvise(fd, off, end - off, POSIX_FADV_SEQUENTIAL);
+#endif
+	while (off < end) {
+		off_t data_end = next_data(fd, &off, end);
+
+		if (data_end < 0)
+			break;
+
+		while (off < data_end) {
+			size_t i, rsz = min((off_t) bufsz, data_end - off);
+			ssize_t rc;
+
+			rc = pread(fd, buf, rsz, off);
+			if (rc < 0)
+				err(EXIT_FAILURE, _("%s: read failed"), filename);
+			if (rc == 0)
+				break;
+
+			for (i = 0; i < (size_t) rc; i += blksz) {
+				size_t sz = min(blksz, (size_t) rc - i);
+
+				if (is_nul(buf + i, sz)) {
+					if (!hole_sz)
+						hole_start = off + i;
+					hole_sz += sz;
+				} else if (hole_sz) {
+					xfallocate(fd, FALLOC_FL_PUNCH_HOLE |
+						   FALLOC_FL_KEEP_SIZE,
+						   hole_start, hole_sz);
+					hole_sz = 0;
+				}
+			}
+#if defined(POSIX_FADV_DONTNEED) && defined(HAVE_POSIX_FADVISE)
+			/* don't pollute the page cache with the scanned data */
+			posix_fadvise(fd, off, rc, POSIX_FADV_DONTNEED);
+#endif
+			off += rc;
+		}
+
+		/* the rest of the area is an existing hole */
+		if (hole_sz) {
+			xfallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+				   hole_start, hole_sz);
+			hole_sz = 0;
+		}
+	}
+
+	free(buf);
+
+	if (verbose) {
+		uintmax_t freed = 0;
+		char *str;
+
+		if (fstat(fd, &st) != 0)
+			err(EXIT_FAILURE, _("stat failed %s"), filename);
+		if (st.st_blocks < blocks)
+			freed = (uintmax_t) (blocks - st.st_blocks) * 512;
+
+		str = size_to_human_string(SIZE_SUFFIX_3LETTER |
+					   SIZE_SUFFIX_SPACE, freed);
+		printf(_("%s: %s (%ju bytes) converted to sparse holes.\n"),
+				filename, str, freed);
+		free(str);
+	}
+}
+
 int main(int argc, char **argv)
 {
-	char	*fname;
 	int	c;
-	int	error;
 	int	fd;
 	int	mode = 0;
+	int	dig = 0;
 	loff_t	length = -2LL;
 	loff_t	offset = 0;
 
@@ -96,8 +271,10 @@ int main(int argc, char **argv)
 	    { "version",   0, 0, 'V' },
 	    { "keep-size", 0, 0, 'n' },
 	    { "punch-hole", 0, 0, 'p' },
+	    { "dig-holes", 0, 0, 'd' },
 	    { "offset",    1, 0, 'o' },
 	    { "length",    1, 0, 'l' },
+	    { "verbose",   0, 0, 'v' },
 	    { NULL,        0, 0, 0 }
 	};
 
@@ -106,7 +283,7 @@ int main(int argc, char **argv)
 	textdomain(PACKAGE);
 	atexit(close_stdout);
 
-	while ((c = getopt_long(argc, argv, "hVnpl:o:", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "hVnpdl:o:v", longopts, NULL)) != -1) {
 		switch(c) {
 		case 'h':
 			usage(stdout);
@@ -120,6 +297,12 @@ int main(int argc, char **argv)
 		case 'n':
 			mode |= FALLOC_FL_KEEP_SIZE;
 			break;
+		case 'd':
+			dig = 1;
+			break;
+		case 'v':
+			verbose++;
+			break;
 		case 'l':
 			length = cvtnum(optarg);
 			break;
@@ -132,41 +315,43 @@ int main(int argc, char **argv)
 		}
 	}
 
-	if (length == -2LL)
-		errx(EXIT_FAILURE, _("no length argument specified"));
-	if (length <= 0)
-		errx(EXIT_FAILURE, _("invalid length value specified"));
+	if (dig) {
+		if (mode)
+			errx(EXIT_FAILURE, _("--dig-holes cannot be combined "
+					     "with --keep-size or --punch-hole"));
+		if (length == -2LL)
+			length = 0;	/* to the end of the file */
+		else if (length <= 0)
+			errx(EXIT_FAILURE, _("invalid length value specified"));
+	} else {
+		if (length == -2LL)
+			errx(EXIT_FAILURE, _("no length argument specified"));
+		if (length <= 0)
+			errx(EXIT_FAILURE, _("invalid length value specified"));
+	}
 	if (offset < 0)
 		errx(EXIT_FAILURE, _("invalid offset value specified"));
 	if (optind == argc)
 		errx(EXIT_FAILURE, _("no filename specified."));
 
-	fname = argv[optind++];
+	filename = argv[optind++];
 
 	if (optind != argc) {
 		warnx(_("unexpected number of arguments"));
 		usage(stderr);
 	}
 
-	fd = open(fname, O_WRONLY|O_CREAT, 0644);
+	if (dig)
+		fd = open(filename, O_RDWR);
+	else
+		fd = open(filename, O_WRONLY|O_CREAT, 0644);
 	if (fd < 0)
-		err(EXIT_FAILURE, _("cannot open %s"), fname);
+		err(EXIT_FAILURE, _("cannot open %s"), filename);
 
-#ifdef HAVE_FALLOCATE
-	error = fallocate(fd, mode, offset, length);
-#else
-	error = syscall(SYS_fallocate, fd, mode, offset, length);
-#endif
-	/*
-	 * EOPNOTSUPP: The FALLOC_FL_KEEP_SIZE is unsupported
-	 * ENOSYS: The filesystem does not support sys_fallocate
-	 */
-	if (error < 0) {
-		if ((mode & FALLOC_FL_KEEP_SIZE) && errno == EOPNOTSUPP)
-			errx(EXIT_FAILURE,
-				_("keep size mode (-n option) unsupported"));
-		err(EXIT_FAILURE, _("%s: fallocate failed"), fname);
-	}
+	if (dig)
+		dig_holes(fd, offset, length);
+	else
+		xfallocate(fd, mode, offset, length);
 
 	close(fd);
 	return EXIT_SUCCESS;
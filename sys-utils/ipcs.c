@@ -20,6 +20,7 @@
 #include <getopt.h>
 #include <grp.h>
 #include <pwd.h>
+#include <stdarg.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -33,72 +34,10 @@
 
 #include "c.h"
 #include "nls.h"
+#include "xalloc.h"
 #include "closestream.h"
-
-/*
- * SHM_DEST and SHM_LOCKED are defined in kernel headers, but inside
- * #ifdef __KERNEL__ ... #endif
- */
-#ifndef SHM_DEST
-  /* shm_mode upper byte flags */
-# define SHM_DEST	01000	/* segment will be destroyed on last detach */
-# define SHM_LOCKED	02000	/* segment will not be swapped */
-#endif
-
-/* For older kernels the same holds for the defines below */
-#ifndef MSG_STAT
-# define MSG_STAT	11
-# define MSG_INFO	12
-#endif
-
-#ifndef SHM_STAT
-# define SHM_STAT	13
-# define SHM_INFO	14
-struct shm_info {
-	int used_ids;
-	ulong shm_tot;		/* total allocated shm */
-	ulong shm_rss;		/* total resident shm */
-	ulong shm_swp;		/* total swapped shm */
-	ulong swap_attempts;
-	ulong swap_successes;
-};
-#endif
-
-#ifndef SEM_STAT
-# define SEM_STAT	18
-# define SEM_INFO	19
-#endif
-
-/* Some versions of libc only define IPC_INFO when __USE_GNU is defined. */
-#ifndef IPC_INFO
-# define IPC_INFO	3
-#endif
-
-/*
- * The last arg of semctl is a union semun, but where is it defined? X/OPEN
- * tells us to define it ourselves, but until recently Linux include files
- * would also define it.
- */
-#ifndef HAVE_UNION_SEMUN
-/* according to X/OPEN we have to define it ourselves */
-union semun {
-	int val;
-	struct semid_ds *buf;
-	unsigned short int *array;
-	struct seminfo *__buf;
-};
-#endif
-
-/*
- * X/OPEN (Jan 1987) does not define fields key, seq in struct ipc_perm;
- *	glibc-1.09 has no support for sysv ipc.
- *	glibc 2 uses __key, __seq
- */
-#if defined (__GLIBC__) && __GLIBC__ >= 2
-# define KEY __key
-#else
-# define KEY key
-#endif
+#include "tt.h"
+#include "ipcutils.h"
 
 #define LIMITS 1
 #define STATUS 2
@@ -106,6 +45,9 @@ union semun {
 #define TIME 4
 #define PID 5
 
+/* --raw and --pairs output */
+static int tt_flags;
+
 void do_shm (char format);
 void do_sem (char format);
 void do_msg (char format);
@@ -113,6 +55,10 @@ void print_shm (int id);
 void print_msg (int id);
 void print_sem (int id);
 
+static void do_shm_tt (void);
+static void do_sem_tt (void);
+static void do_msg_tt (void);
+
 static void __attribute__ ((__noreturn__)) usage(FILE * out)
 {
 	fprintf(out, USAGE_HEADER);
@@ -135,6 +81,9 @@ static void __attribute__ ((__noreturn__)) usage(FILE * out)
 	fputs(_(" -c, --creator     show creator and owner\n"), out);
 	fputs(_(" -l, --limits      show resource limits\n"), out);
 	fputs(_(" -u, --summary     show status summary\n"), out);
+	fputs(_("\n"), out);
+	fputs(_(" -P, --pairs       use key=\"value\" output format\n"), out);
+	fputs(_(" -r, --raw         use raw output format\n"), out);
 	fprintf(out, USAGE_MAN_TAIL("ipcs(1)"));
 	exit(out == stderr ? EXIT_FAILURE : EXIT_SUCCESS);
 }
@@ -154,11 +103,13 @@ int main (int argc, char **argv)
 		{"creator", no_argument, NULL, 'c'},
 		{"limits", no_argument, NULL, 'l'},
 		{"summary", no_argument, NULL, 'u'},
+		{"pairs", no_argument, NULL, 'P'},
+		{"raw", no_argument, NULL, 'r'},
 		{"version", no_argument, NULL, 'V'},
 		{"help", no_argument, NULL, 'h'},
 		{NULL, 0, NULL, 0}
 	};
-	char options[] = "i:mqsatpcluVh";
+	char options[] = "i:mqsatpcluPrVh";
 
 	setlocale(LC_ALL, "");
 	bindtextdomain(PACKAGE, LOCALEDIR);
@@ -198,6 +149,12 @@ int main (int argc, char **argv)
 		case 'u':
 			format = STATUS;
 			break;
+		case 'P':
+			tt_flags |= TT_FL_EXPORT;
+			break;
+		case 'r':
+			tt_flags |= TT_FL_RAW;
+			break;
 		case 'h':
 			usage(stdout);
 		case 'V':
@@ -208,6 +165,10 @@ int main (int argc, char **argv)
 		}
 	}
 
+	if (tt_flags && (format || print))
+		errx(EXIT_FAILURE, _("--raw and --pairs cannot be combined "
+				     "with --id or output format options"));
+
 	if  (print) {
 		if (shm)
 			print_shm (id);
@@ -217,6 +178,15 @@ int main (int argc, char **argv)
 			print_msg (id);
 		if (!shm && !sem && !msg )
 			usage (stderr);
+	} else if (tt_flags) {
+		if ( !shm && !msg && !sem)
+			msg = sem = shm = 1;
+		if (shm)
+			do_shm_tt ();
+		if (sem)
+			do_sem_tt ();
+		if (msg)
+			do_msg_tt ();
 	} else {
 		if ( !shm && !msg && !sem)
 			msg = sem = shm = 1;
@@ -238,40 +208,221 @@ int main (int argc, char **argv)
 	return EXIT_SUCCESS;
 }
 
-static void print_perms (int id, struct ipc_perm *ipcp)
+static void print_perms (struct ipc_stat *ipcp)
 {
-	struct passwd *pw;
-	struct group *gr;
+	const char *name;
 
-	printf ("%-10d %-10o", id, ipcp->mode & 0777);
+	printf ("%-10d %-10o", ipcp->id, ipcp->mode & 0777);
 
-	if ((pw = getpwuid(ipcp->cuid)))
-		printf(" %-10s", pw->pw_name);
+	if ((name = ipc_get_username(ipcp->cuid)))
+		printf(" %-10s", name);
 	else
 		printf(" %-10u", ipcp->cuid);
-	if ((gr = getgrgid(ipcp->cgid)))
-		printf(" %-10s", gr->gr_name);
+	if ((name = ipc_get_groupname(ipcp->cgid)))
+		printf(" %-10s", name);
 	else
 		printf(" %-10u", ipcp->cgid);
 
-	if ((pw = getpwuid(ipcp->uid)))
-		printf(" %-10s", pw->pw_name);
+	if ((name = ipc_get_username(ipcp->uid)))
+		printf(" %-10s", name);
 	else
 		printf(" %-10u", ipcp->uid);
-	if ((gr = getgrgid(ipcp->gid)))
-		printf(" %-10s\n", gr->gr_name);
+	if ((name = ipc_get_groupname(ipcp->gid)))
+		printf(" %-10s\n", name);
 	else
 		printf(" %-10u\n", ipcp->gid);
 }
 
+static void print_owner (int width, struct ipc_stat *ipcp)
+{
+	const char *name = ipc_get_username(ipcp->uid);
+
+	if (name)
+		printf ("%-*d %-10.10s", width, ipcp->id, name);
+	else
+		printf ("%-*d %-10u", width, ipcp->id, ipcp->uid);
+}
+
+/* ctime() for int64_t, ctime uses static buffer: use separate calls */
+static char *ipc_ctime (int64_t t)
+{
+	time_t x = (time_t) t;
+
+	return ctime (&x);
+}
+
+/*
+ * --raw and --pairs output; one table per resource with all the columns,
+ * times are in seconds since the Epoch.
+ */
+static struct tt *new_ipc_table (const char **names, size_t n)
+{
+	struct tt *tt;
+	size_t i;
+
+	tt = tt_new_table(tt_flags);
+	if (!tt)
+		errx(EXIT_FAILURE, _("failed to initialize output table"));
+
+	for (i = 0; i < n; i++)
+		if (!tt_define_column(tt, names[i], 1, 0))
+			errx(EXIT_FAILURE, _("failed to initialize output column"));
+	return tt;
+}
+
+static void set_cell (struct tt_line *ln, int col, const char *fmt, ...)
+{
+	va_list ap;
+	char *str;
+	int rc;
+
+	va_start(ap, fmt);
+	rc = vasprintf(&str, fmt, ap);
+	va_end(ap);
+	if (rc < 0)
+		err(EXIT_FAILURE, _("cannot allocate memory"));
+
+	tt_line_set_data(ln, col, str);
+}
+
+/* KEY ID OWNER PERMS ... CUID CGID UID GID */
+static struct tt_line *add_ipc_line (struct tt *tt, struct ipc_stat *ipcp,
+				     int *col)
+{
+	struct tt_line *ln = tt_add_line(tt, NULL);
+	const char *name = ipc_get_username(ipcp->uid);
+
+	if (!ln)
+		errx(EXIT_FAILURE, _("failed to initialize output line"));
+
+	set_cell(ln, 0, "0x%08x", ipcp->key);
+	set_cell(ln, 1, "%d", ipcp->id);
+	if (name)
+		set_cell(ln, 2, "%s", name);
+	else
+		set_cell(ln, 2, "%u", ipcp->uid);
+	set_cell(ln, 3, "%o", ipcp->mode & 0777);
+	*col = 4;
+	return ln;
+}
+
+static void set_ids (struct tt_line *ln, struct ipc_stat *ipcp, int *col)
+{
+	set_cell(ln, (*col)++, "%u", ipcp->cuid);
+	set_cell(ln, (*col)++, "%u", ipcp->cgid);
+	set_cell(ln, (*col)++, "%u", ipcp->uid);
+	set_cell(ln, (*col)++, "%u", ipcp->gid);
+}
+
+static void print_ipc_table (struct tt *tt)
+{
+	tt_print_table(tt);
+	tt_free_table(tt);
+}
+
+static void do_shm_tt (void)
+{
+	static const char *names[] = {
+		"KEY", "ID", "OWNER", "PERMS", "SIZE", "NATTCH", "STATUS",
+		"CUID", "CGID", "UID", "GID", "CPID", "LPID",
+		"ATIME", "DTIME", "CTIME"
+	};
+	struct shm_data *shmds, *p;
+	struct tt *tt = new_ipc_table(names, ARRAY_SIZE(names));
+	struct shm_info shm_info;
+
+	ipc_shm_get_info(shmctl(0, SHM_INFO, (struct shmid_ds *) (void *) &shm_info),
+			 &shmds);
+
+	for (p = shmds; p; p = p->next) {
+		int col;
+		struct tt_line *ln = add_ipc_line(tt, &p->shm_perm, &col);
+		unsigned int mode = p->shm_perm.mode;
+
+		set_cell(ln, col++, "%ju", p->shm_segsz);
+		set_cell(ln, col++, "%ju", p->shm_nattch);
+		set_cell(ln, col++, "%s%s%s",
+			 mode & SHM_DEST ? "dest" : "",
+			 (mode & SHM_DEST) && (mode & SHM_LOCKED) ? "," : "",
+			 mode & SHM_LOCKED ? "locked" : "");
+		set_ids(ln, &p->shm_perm, &col);
+		set_cell(ln, col++, "%d", p->shm_cprid);
+		set_cell(ln, col++, "%d", p->shm_lprid);
+		set_cell(ln, col++, "%jd", p->shm_atim);
+		set_cell(ln, col++, "%jd", p->shm_dtim);
+		set_cell(ln, col++, "%jd", p->shm_ctim);
+	}
+
+	print_ipc_table(tt);
+	ipc_shm_free_info(shmds);
+}
+
+static void do_sem_tt (void)
+{
+	static const char *names[] = {
+		"KEY", "ID", "OWNER", "PERMS", "NSEMS",
+		"CUID", "CGID", "UID", "GID", "OTIME", "CTIME"
+	};
+	struct sem_data *semds, *p;
+	struct tt *tt = new_ipc_table(names, ARRAY_SIZE(names));
+	struct seminfo seminfo;
+	union semun arg;
+
+	arg.array = (ushort *) (void *) &seminfo;
+	ipc_sem_get_info(semctl(0, 0, SEM_INFO, arg), &semds);
+
+	for (p = semds; p; p = p->next) {
+		int col;
+		struct tt_line *ln = add_ipc_line(tt, &p->sem_perm, &col);
+
+		set_cell(ln, col++, "%ju", p->sem_nsems);
+		set_ids(ln, &p->sem_perm, &col);
+		set_cell(ln, col++, "%jd", p->sem_otime);
+		set_cell(ln, col++, "%jd", p->sem_ctime);
+	}
+
+	print_ipc_table(tt);
+	ipc_sem_free_info(semds);
+}
+
+static void do_msg_tt (void)
+{
+	static const char *names[] = {
+		"KEY", "ID", "OWNER", "PERMS", "USEDBYTES", "MESSAGES",
+		"CUID", "CGID", "UID", "GID", "LSPID", "LRPID",
+		"STIME", "RTIME", "CTIME"
+	};
+	struct msg_data *msgds, *p;
+	struct tt *tt = new_ipc_table(names, ARRAY_SIZE(names));
+	struct msginfo msginfo;
+
+	ipc_msg_get_info(msgctl(0, MSG_INFO, (struct msqid_ds *) (void *) &msginfo),
+			 &msgds);
+
+	for (p = msgds; p; p = p->next) {
+		int col;
+		struct tt_line *ln = add_ipc_line(tt, &p->msg_perm, &col);
+
+		set_cell(ln, col++, "%ju", p->q_cbytes);
+		set_cell(ln, col++, "%ju", p->q_qnum);
+		set_ids(ln, &p->msg_perm, &col);
+		set_cell(ln, col++, "%d", p->q_lspid);
+		set_cell(ln, col++, "%d", p->q_lrpid);
+		set_cell(ln, col++, "%jd", p->q_stime);
+		set_cell(ln, col++, "%jd", p->q_rtime);
+		set_cell(ln, col++, "%jd", p->q_ctime);
+	}
+
+	print_ipc_table(tt);
+	ipc_msg_free_info(msgds);
+}
+
 void do_shm (char format)
 {
-	int maxid, shmid, id;
-	struct shmid_ds shmseg;
+	int maxid;
+	struct shm_data *shmds, *shmdsp;
 	struct shm_info shm_info;
 	struct shminfo shminfo;
-	struct ipc_perm *ipcp = &shmseg.shm_perm;
-	struct passwd *pw;
 
 	maxid = shmctl (0, SHM_INFO, (struct shmid_ds *) (void *) &shm_info);
 	if (maxid < 0) {
@@ -350,70 +501,53 @@ void do_shm (char format)
 		break;
 	}
 
-	for (id = 0; id <= maxid; id++) {
-		shmid = shmctl (id, SHM_STAT, &shmseg);
-		if (shmid < 0)
-			continue;
+	ipc_shm_get_info(maxid, &shmds);
+
+	for (shmdsp = shmds; shmdsp; shmdsp = shmdsp->next) {
+		struct ipc_stat *ipcp = &shmdsp->shm_perm;
+
 		if (format == CREATOR)  {
-			print_perms (shmid, ipcp);
+			print_perms (ipcp);
 			continue;
 		}
-		pw = getpwuid(ipcp->uid);
 		switch (format) {
 		case TIME:
-			if (pw)
-				printf ("%-10d %-10.10s", shmid, pw->pw_name);
-			else
-				printf ("%-10d %-10u", shmid, ipcp->uid);
-			/* ctime uses static buffer: use separate calls */
-			printf(" %-20.16s", shmseg.shm_atime
-			       ? ctime(&shmseg.shm_atime) + 4 : _("Not set"));
-			printf(" %-20.16s", shmseg.shm_dtime
-			       ? ctime(&shmseg.shm_dtime) + 4 : _("Not set"));
-			printf(" %-20.16s\n", shmseg.shm_ctime
-			       ? ctime(&shmseg.shm_ctime) + 4 : _("Not set"));
+			print_owner (10, ipcp);
+			printf(" %-20.16s", shmdsp->shm_atim
+			       ? ipc_ctime(shmdsp->shm_atim) + 4 : _("Not set"));
+			printf(" %-20.16s", shmdsp->shm_dtim
+			       ? ipc_ctime(shmdsp->shm_dtim) + 4 : _("Not set"));
+			printf(" %-20.16s\n", shmdsp->shm_ctim
+			       ? ipc_ctime(shmdsp->shm_ctim) + 4 : _("Not set"));
 			break;
 		case PID:
-			if (pw)
-				printf ("%-10d %-10.10s", shmid, pw->pw_name);
-			else
-				printf ("%-10d %-10u", shmid, ipcp->uid);
+			print_owner (10, ipcp);
 			printf (" %-10d %-10d\n",
-				shmseg.shm_cpid, shmseg.shm_lpid);
+				shmdsp->shm_cprid, shmdsp->shm_lprid);
 			break;
 
 		default:
-			printf("0x%08x ",ipcp->KEY );
-			if (pw)
-				printf ("%-10d %-10.10s", shmid, pw->pw_name);
-			else
-				printf ("%-10d %-10u", shmid, ipcp->uid);
-			printf (" %-10o %-10lu %-10ld %-6s %-6s\n",
+			printf("0x%08x ", ipcp->key);
+			print_owner (10, ipcp);
+			printf (" %-10o %-10ju %-10ju %-6s %-6s\n",
 				ipcp->mode & 0777,
-				/*
-				 * earlier: int, Austin has size_t
-				 */
-				(unsigned long) shmseg.shm_segsz,
-				/*
-				 * glibc-2.1.3 and earlier has unsigned short;
-				 * Austin has shmatt_t
-				 */
-				(long) shmseg.shm_nattch,
+				shmdsp->shm_segsz,
+				shmdsp->shm_nattch,
 				ipcp->mode & SHM_DEST ? _("dest") : " ",
 				ipcp->mode & SHM_LOCKED ? _("locked") : " ");
 			break;
 		}
 	}
+
+	ipc_shm_free_info(shmds);
 	return;
 }
 
 void do_sem (char format)
 {
-	int maxid, semid, id;
-	struct semid_ds semary;
+	int maxid;
+	struct sem_data *semds, *semdsp;
 	struct seminfo seminfo;
-	struct ipc_perm *ipcp = &semary.sem_perm;
-	struct passwd *pw;
 	union semun arg;
 
 	arg.array = (ushort *)  (void *) &seminfo;
@@ -464,57 +598,46 @@ void do_sem (char format)
 		break;
 	}
 
-	for (id = 0; id <= maxid; id++) {
-		arg.buf = (struct semid_ds *) &semary;
-		semid = semctl (id, 0, SEM_STAT, arg);
-		if (semid < 0)
-			continue;
+	/* nothing to print for PID format */
+	if (format == PID)
+		return;
+
+	ipc_sem_get_info(maxid, &semds);
+
+	for (semdsp = semds; semdsp; semdsp = semdsp->next) {
+		struct ipc_stat *ipcp = &semdsp->sem_perm;
+
 		if (format == CREATOR)  {
-			print_perms (semid, ipcp);
+			print_perms (ipcp);
 			continue;
 		}
-		pw = getpwuid(ipcp->uid);
 		switch (format) {
 		case TIME:
-			if (pw)
-				printf ("%-8d %-10.10s", semid, pw->pw_name);
-			else
-				printf ("%-8d %-10u", semid, ipcp->uid);
-			printf ("  %-26.24s", semary.sem_otime
-				? ctime(&semary.sem_otime) : _("Not set"));
-			printf (" %-26.24s\n", semary.sem_ctime
-				? ctime(&semary.sem_ctime) : _("Not set"));
-			break;
-		case PID:
+			print_owner (8, ipcp);
+			printf ("  %-26.24s", semdsp->sem_otime
+				? ipc_ctime(semdsp->sem_otime) : _("Not set"));
+			printf (" %-26.24s\n", semdsp->sem_ctime
+				? ipc_ctime(semdsp->sem_ctime) : _("Not set"));
 			break;
 
 		default:
-			printf("0x%08x ", ipcp->KEY);
-			if (pw)
-				printf ("%-10d %-10.10s", semid, pw->pw_name);
-			else
-				printf ("%-10d %-10u", semid, ipcp->uid);
-			printf (" %-10o %-10ld\n",
+			printf("0x%08x ", ipcp->key);
+			print_owner (10, ipcp);
+			printf (" %-10o %-10ju\n",
 				ipcp->mode & 0777,
-				/*
-				 * glibc-2.1.3 and earlier has unsigned
-				 * short. glibc-2.1.91 has variation between
-				 * unsigned short and unsigned long. Austin
-				 * prescribes unsigned short.
-				 */
-				(long) semary.sem_nsems);
+				semdsp->sem_nsems);
 			break;
 		}
 	}
+
+	ipc_sem_free_info(semds);
 }
 
 void do_msg (char format)
 {
-	int maxid, msqid, id;
-	struct msqid_ds msgque;
+	int maxid;
+	struct msg_data *msgds, *msgdsp;
 	struct msginfo msginfo;
-	struct ipc_perm *ipcp = &msgque.msg_perm;
-	struct passwd *pw;
 
 	maxid = msgctl (0, MSG_INFO, (struct msqid_ds *) (void *) &msginfo);
 	if (maxid < 0) {
@@ -565,56 +688,43 @@ void do_msg (char format)
 		break;
 	}
 
-	for (id = 0; id <= maxid; id++) {
-		msqid = msgctl (id, MSG_STAT, &msgque);
-		if (msqid < 0)
-			continue;
+	ipc_msg_get_info(maxid, &msgds);
+
+	for (msgdsp = msgds; msgdsp; msgdsp = msgdsp->next) {
+		struct ipc_stat *ipcp = &msgdsp->msg_perm;
+
 		if (format == CREATOR)  {
-			print_perms (msqid, ipcp);
+			print_perms (ipcp);
 			continue;
 		}
-		pw = getpwuid(ipcp->uid);
 		switch (format) {
 		case TIME:
-			if (pw)
-				printf ("%-8d %-10.10s", msqid, pw->pw_name);
-			else
-				printf ("%-8d %-10u", msqid, ipcp->uid);
-			printf (" %-20.16s", msgque.msg_stime
-				? ctime(&msgque.msg_stime) + 4 : _("Not set"));
-			printf (" %-20.16s", msgque.msg_rtime
-				? ctime(&msgque.msg_rtime) + 4 : _("Not set"));
-			printf (" %-20.16s\n", msgque.msg_ctime
-				? ctime(&msgque.msg_ctime) + 4 : _("Not set"));
+			print_owner (8, ipcp);
+			printf (" %-20.16s", msgdsp->q_stime
+				? ipc_ctime(msgdsp->q_stime) + 4 : _("Not set"));
+			printf (" %-20.16s", msgdsp->q_rtime
+				? ipc_ctime(msgdsp->q_rtime) + 4 : _("Not set"));
+			printf (" %-20.16s\n", msgdsp->q_ctime
+				? ipc_ctime(msgdsp->q_ctime) + 4 : _("Not set"));
 			break;
 		case PID:
-			if (pw)
-				printf ("%-8d %-10.10s", msqid, pw->pw_name);
-			else
-				printf ("%-8d %-10u", msqid, ipcp->uid);
+			print_owner (8, ipcp);
 			printf ("  %5d     %5d\n",
-				msgque.msg_lspid, msgque.msg_lrpid);
+				msgdsp->q_lspid, msgdsp->q_lrpid);
 			break;
 
 		default:
-			printf( "0x%08x ",ipcp->KEY );
-			if (pw)
-				printf ("%-10d %-10.10s", msqid, pw->pw_name);
-			else
-				printf ("%-10d %-10u", msqid, ipcp->uid);
-			printf (" %-10o %-12ld %-12ld\n",
+			printf( "0x%08x ", ipcp->key);
+			print_owner (10, ipcp);
+			printf (" %-10o %-12ju %-12ju\n",
 				ipcp->mode & 0777,
-				/*
-				 * glibc-2.1.3 and earlier has unsigned
-				 * short. glibc-2.1.91 has variation between
-				 * unsigned short, unsigned long. Austin has
-				 * msgqnum_t
-				 */
-				(long) msgque.msg_cbytes,
-				(long) msgque.msg_qnum);
+				msgdsp->q_cbytes,
+				msgdsp->q_qnum);
 			break;
 		}
 	}
+
+	ipc_msg_free_info(msgds);
 	return;
 }
 
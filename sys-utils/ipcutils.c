@@ -0,0 +1,457 @@
+/*
+ * Helpers to get information about System V IPC objects.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <grp.h>
+#include <pwd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "c.h"
+#include "xalloc.h"
+#include "ipcutils.h"
+
+/*
+ * /proc/sysvipc/<type> columns, the first line of the file is header with
+ * the column names. The columns are addressed by names to be independent
+ * on the kernel version.
+ */
+enum {
+	IPC_COL_UNKNOWN = 0,
+	IPC_COL_KEY,
+	IPC_COL_ID,
+	IPC_COL_PERMS,
+	IPC_COL_UID,
+	IPC_COL_GID,
+	IPC_COL_CUID,
+	IPC_COL_CGID,
+
+	IPC_COL_SIZE,		/* shm */
+	IPC_COL_CPID,
+	IPC_COL_LPID,
+	IPC_COL_NATTCH,
+	IPC_COL_ATIME,
+	IPC_COL_DTIME,
+
+	IPC_COL_NSEMS,		/* sem */
+	IPC_COL_OTIME,
+
+	IPC_COL_CBYTES,		/* msg */
+	IPC_COL_QNUM,
+	IPC_COL_LSPID,
+	IPC_COL_LRPID,
+	IPC_COL_STIME,
+	IPC_COL_RTIME,
+
+	IPC_COL_CTIME,		/* all */
+
+	IPC_NCOLS
+};
+
+static const char *ipc_colnames[] = {
+	[IPC_COL_KEY]	= "key",
+	[IPC_COL_PERMS]	= "perms",
+	[IPC_COL_UID]	= "uid",
+	[IPC_COL_GID]	= "gid",
+	[IPC_COL_CUID]	= "cuid",
+	[IPC_COL_CGID]	= "cgid",
+	[IPC_COL_SIZE]	= "size",
+	[IPC_COL_CPID]	= "cpid",
+	[IPC_COL_LPID]	= "lpid",
+	[IPC_COL_NATTCH]= "nattch",
+	[IPC_COL_ATIME]	= "atime",
+	[IPC_COL_DTIME]	= "dtime",
+	[IPC_COL_NSEMS]	= "nsems",
+	[IPC_COL_OTIME]	= "otime",
+	[IPC_COL_CBYTES]= "cbytes",
+	[IPC_COL_QNUM]	= "qnum",
+	[IPC_COL_LSPID]	= "lspid",
+	[IPC_COL_LRPID]	= "lrpid",
+	[IPC_COL_STIME]	= "stime",
+	[IPC_COL_RTIME]	= "rtime",
+	[IPC_COL_CTIME]	= "ctime"
+};
+
+static int ipc_colname_to_id(const char *name)
+{
+	size_t i;
+
+	if (!strcmp(name, "shmid") || !strcmp(name, "semid") ||
+	    !strcmp(name, "msqid"))
+		return IPC_COL_ID;
+
+	for (i = 0; i < ARRAY_SIZE(ipc_colnames); i++) {
+		if (ipc_colnames[i] && !strcmp(name, ipc_colnames[i]))
+			return i;
+	}
+	return IPC_COL_UNKNOWN;
+}
+
+/*
+ * Reads whole file to the buffer. The /proc/sysvipc files are generated
+ * by kernel for each read(), so it's better to use large buffer than
+ * stdio.
+ */
+static char *ipc_read_proc(const char *path)
+{
+	size_t sz = 0, len = 0;
+	char *buf = NULL;
+	int fd;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return NULL;
+
+	do {
+		ssize_t ret;
+
+		if (sz - len < BUFSIZ) {
+			sz = sz ? sz * 2 : 64 * 1024;
+			buf = xrealloc(buf, sz + 1);
+		}
+		ret = read(fd, buf + len, sz - len);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret < 0) {
+			free(buf);
+			buf = NULL;
+			break;
+		}
+		if (ret == 0)
+			break;
+		len += ret;
+	} while (1);
+
+	close(fd);
+	if (buf)
+		buf[len] = '\0';
+	return buf;
+}
+
+/*
+ * Calls @fn for each line of the /proc/sysvipc/<type> file, the
+ * @vals are indexed by IPC_COL_*. Returns -1 if the file is not
+ * readable, otherwise number of the lines.
+ */
+static int ipc_parse_proc(const char *type,
+			  void (*fn)(int64_t *vals, void *data), void *data)
+{
+	int cols[64], ncols = 0, nlines = 0;
+	char path[PATH_MAX];
+	const char *dir = getenv(ENV_PROC_SYSV);
+	char *buf, *line, *next, *tok, *save = NULL;
+
+	snprintf(path, sizeof(path), "%s/%s", dir ? dir : PATH_PROC_SYSV, type);
+	buf = ipc_read_proc(path);
+	if (!buf)
+		return -1;
+
+	next = strchr(buf, '\n');
+	if (!next) {
+		free(buf);
+		return -1;
+	}
+	*next++ = '\0';
+
+	for (tok = strtok_r(buf, " \t", &save); tok && ncols < (int) ARRAY_SIZE(cols);
+	     tok = strtok_r(NULL, " \t", &save))
+		cols[ncols++] = ipc_colname_to_id(tok);
+
+	for (line = next; line && *line; line = next) {
+		int64_t vals[IPC_NCOLS];
+		char *p = line, *end;
+		int i;
+
+		next = strchr(line, '\n');
+		if (next)
+			*next++ = '\0';
+
+		memset(vals, 0, sizeof(vals));
+		for (i = 0; i < ncols; i++) {
+			/* the numbers are large unsigned or negative keys */
+			errno = 0;
+			vals[cols[i]] = *p == '-' ? strtoll(p, &end, 10) :
+				(int64_t) strtoull(p, &end, cols[i] == IPC_COL_PERMS ? 8 : 10);
+			if (errno || end == p)
+				break;
+			p = end;
+		}
+		if (i < ncols)
+			continue;	/* incomplete line */
+
+		fn(vals, data);
+		nlines++;
+	}
+
+	free(buf);
+	return nlines;
+}
+
+static void ipc_fill_perm(struct ipc_stat *st, int64_t *vals)
+{
+	st->id = vals[IPC_COL_ID];
+	st->key = vals[IPC_COL_KEY];
+	st->mode = vals[IPC_COL_PERMS];
+	st->uid = vals[IPC_COL_UID];
+	st->gid = vals[IPC_COL_GID];
+	st->cuid = vals[IPC_COL_CUID];
+	st->cgid = vals[IPC_COL_CGID];
+}
+
+static void ipc_copy_perm(struct ipc_stat *st, int id, struct ipc_perm *p)
+{
+	st->id = id;
+	st->key = p->KEY;
+	st->mode = p->mode;
+	st->uid = p->uid;
+	st->gid = p->gid;
+	st->cuid = p->cuid;
+	st->cgid = p->cgid;
+}
+
+/* the lists are appended to keep the kernel order */
+#define IPC_LIST_APPEND(_tail, _x)	do { **(_tail) = (_x); *(_tail) = &(_x)->next; } while(0)
+
+static void shm_add_proc(int64_t *vals, void *data)
+{
+	struct shm_data *x = xcalloc(1, sizeof(*x));
+
+	ipc_fill_perm(&x->shm_perm, vals);
+	x->shm_segsz = vals[IPC_COL_SIZE];
+	x->shm_cprid = vals[IPC_COL_CPID];
+	x->shm_lprid = vals[IPC_COL_LPID];
+	x->shm_nattch = vals[IPC_COL_NATTCH];
+	x->shm_atim = vals[IPC_COL_ATIME];
+	x->shm_dtim = vals[IPC_COL_DTIME];
+	x->shm_ctim = vals[IPC_COL_CTIME];
+
+	IPC_LIST_APPEND((struct shm_data ***) data, x);
+}
+
+int ipc_shm_get_info(int maxid, struct shm_data **shmds)
+{
+	struct shm_data **tail = shmds;
+	int id, n;
+
+	*shmds = NULL;
+
+	n = ipc_parse_proc("shm", shm_add_proc, &tail);
+	if (n >= 0)
+		return n;
+
+	for (n = 0, id = 0; id <= maxid; id++) {
+		struct shmid_ds shmseg;
+		struct shm_data *x;
+		int shmid = shmctl(id, SHM_STAT, &shmseg);
+
+		if (shmid < 0)
+			continue;
+
+		x = xcalloc(1, sizeof(*x));
+		ipc_copy_perm(&x->shm_perm, shmid, &shmseg.shm_perm);
+		x->shm_segsz = shmseg.shm_segsz;
+		x->shm_cprid = shmseg.shm_cpid;
+		x->shm_lprid = shmseg.shm_lpid;
+		x->shm_nattch = shmseg.shm_nattch;
+		x->shm_atim = shmseg.shm_atime;
+		x->shm_dtim = shmseg.shm_dtime;
+		x->shm_ctim = shmseg.shm_ctime;
+
+		IPC_LIST_APPEND(&tail, x);
+		n++;
+	}
+	return n;
+}
+
+void ipc_shm_free_info(struct shm_data *shmds)
+{
+	while (shmds) {
+		struct shm_data *next = shmds->next;
+		free(shmds);
+		shmds = next;
+	}
+}
+
+static void sem_add_proc(int64_t *vals, void *data)
+{
+	struct sem_data *x = xcalloc(1, sizeof(*x));
+
+	ipc_fill_perm(&x->sem_perm, vals);
+	x->sem_nsems = vals[IPC_COL_NSEMS];
+	x->sem_otime = vals[IPC_COL_OTIME];
+	x->sem_ctime = vals[IPC_COL_CTIME];
+
+	IPC_LIST_APPEND((struct sem_data ***) data, x);
+}
+
+int ipc_sem_get_info(int maxid, struct sem_data **semds)
+{
+	struct sem_data **tail = semds;
+	int id, n;
+
+	*semds = NULL;
+
+	n = ipc_parse_proc("sem", sem_add_proc, &tail);
+	if (n >= 0)
+		return n;
+
+	for (n = 0, id = 0; id <= maxid; id++) {
+		struct semid_ds semseg;
+		struct sem_data *x;
+		union semun arg;
+		int semid;
+
+		arg.buf = &semseg;
+		semid = semctl(id, 0, SEM_STAT, arg);
+		if (semid < 0)
+			continue;
+
+		x = xcalloc(1, sizeof(*x));
+		ipc_copy_perm(&x->sem_perm, semid, &semseg.sem_perm);
+		x->sem_nsems = semseg.sem_nsems;
+		x->sem_otime = semseg.sem_otime;
+		x->sem_ctime = semseg.sem_ctime;
+
+		IPC_LIST_APPEND(&tail, x);
+		n++;
+	}
+	return n;
+}
+
+void ipc_sem_free_info(struct sem_data *semds)
+{
+	while (semds) {
+		struct sem_data *next = semds->next;
+		free(semds);
+		semds = next;
+	}
+}
+
+static void msg_add_proc(int64_t *vals, void *data)
+{
+	struct msg_data *x = xcalloc(1, sizeof(*x));
+
+	ipc_fill_perm(&x->msg_perm, vals);
+	x->q_cbytes = vals[IPC_COL_CBYTES];
+	x->q_qnum = vals[IPC_COL_QNUM];
+	x->q_lspid = vals[IPC_COL_LSPID];
+	x->q_lrpid = vals[IPC_COL_LRPID];
+	x->q_stime = vals[IPC_COL_STIME];
+	x->q_rtime = vals[IPC_COL_RTIME];
+	x->q_ctime = vals[IPC_COL_CTIME];
+
+	IPC_LIST_APPEND((struct msg_data ***) data, x);
+}
+
+int ipc_msg_get_info(int maxid, struct msg_data **msgds)
+{
+	struct msg_data **tail = msgds;
+	int id, n;
+
+	*msgds = NULL;
+
+	n = ipc_parse_proc("msg", msg_add_proc, &tail);
+	if (n >= 0)
+		return n;
+
+	for (n = 0, id = 0; id <= maxid; id++) {
+		struct msqid_ds msgseg;
+		struct msg_data *x;
+		int msqid = msgctl(id, MSG_STAT, &msgseg);
+
+		if (msqid < 0)
+			continue;
+
+		x = xcalloc(1, sizeof(*x));
+		ipc_copy_perm(&x->msg_perm, msqid, &msgseg.msg_perm);
+		x->q_cbytes = msgseg.msg_cbytes;
+		x->q_qnum = msgseg.msg_qnum;
+		x->q_lspid = msgseg.msg_lspid;
+		x->q_lrpid = msgseg.msg_lrpid;
+		x->q_stime = msgseg.msg_stime;
+		x->q_rtime = msgseg.msg_rtime;
+		x->q_ctime = msgseg.msg_ctime;
+
+		IPC_LIST_APPEND(&tail, x);
+		n++;
+	}
+	return n;
+}
+
+void ipc_msg_free_info(struct msg_data *msgds)
+{
+	while (msgds) {
+		struct msg_data *next = msgds->next;
+		free(msgds);
+		msgds = next;
+	}
+}
+
+/*
+ * Cache for user and group names, there is usually a few owners for many
+ * IPC objects. NULL is cached for unknown IDs too.
+ */
+struct ipc_idname {
+	unsigned long		id;
+	char			*name;
+	struct ipc_idname	*next;
+};
+
+#define IPC_IDCACHE_SIZE	64
+
+static struct ipc_idname *usercache[IPC_IDCACHE_SIZE];
+static struct ipc_idname *groupcache[IPC_IDCACHE_SIZE];
+
+static struct ipc_idname *ipc_idcache_find(struct ipc_idname **cache,
+					   unsigned long id)
+{
+	struct ipc_idname *x;
+
+	for (x = cache[id % IPC_IDCACHE_SIZE]; x; x = x->next) {
+		if (x->id == id)
+			return x;
+	}
+	return NULL;
+}
+
+static struct ipc_idname *ipc_idcache_add(struct ipc_idname **cache,
+					  unsigned long id, const char *name)
+{
+	struct ipc_idname *x = xcalloc(1, sizeof(*x));
+
+	x->id = id;
+	x->name = name ? xstrdup(name) : NULL;
+	x->next = cache[id % IPC_IDCACHE_SIZE];
+	cache[id % IPC_IDCACHE_SIZE] = x;
+	return x;
+}
+
+const char *ipc_get_username(uid_t uid)
+{
+	struct ipc_idname *x = ipc_idcache_find(usercache, uid);
+
+	if (!x) {
+		struct passwd *pw = getpwuid(uid);
+		x = ipc_idcache_add(usercache, uid, pw ? pw->pw_name : NULL);
+	}
+	return x->name;
+}
+
+const char *ipc_get_groupname(gid_t gid)
+{
+	struct ipc_idname *x = ipc_idcache_find(groupcache, gid);
+
+	if (!x) {
+		struct group *gr = getgrgid(gid);
+		x = ipc_idcache_add(groupcache, gid, gr ? gr->gr_name : NULL);
+	}
+	return x->name;
+}
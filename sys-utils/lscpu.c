@@ -91,6 +91,12 @@ enum {
 	MODE_64BIT	= (1 << 2)
 };
 
+/* hash index of the unique cpu sets, see add_cpuset_to_array() */
+struct cpuset_hash {
+	size_t		size;		/* number of slots (power of 2) */
+	int		*slots;		/* array index + 1, 0 for empty slot */
+};
+
 /* cache(s) description */
 struct cpu_cache {
 	char		*name;
@@ -98,6 +104,7 @@ struct cpu_cache {
 
 	int		nsharedmaps;
 	cpu_set_t	**sharedmaps;
+	struct cpuset_hash sharedhash;
 };
 
 /* dispatching modes */
@@ -160,16 +167,19 @@ struct lscpu_desc {
 	 * hardware threads within the same book */
 	int		nbooks;		/* number of all online books */
 	cpu_set_t	**bookmaps;	/* unique book_siblings */
+	struct cpuset_hash bookhash;
 
 	/* sockets -- based on core_siblings (internal kernel map of cpuX's
 	 * hardware threads within the same physical_package_id (socket)) */
 	int		nsockets;	/* number of all online sockets */
 	cpu_set_t	**socketmaps;	/* unique core_siblings */
+	struct cpuset_hash sockethash;
 
 	/* cores -- based on thread_siblings (internel kernel map of cpuX's
 	 * hardware threads within the same core as cpuX) */
 	int		ncores;		/* number of all online cores */
 	cpu_set_t	**coremaps;	/* unique thread_siblings */
+	struct cpuset_hash corehash;
 
 	int		nthreads;	/* number of online threads */
 
@@ -334,6 +344,7 @@ read_basicinfo(struct lscpu_desc *desc, struct lscpu_modifier *mod)
 	FILE *fp = path_fopen("r", 1, _PATH_PROC_CPUINFO);
 	char buf[BUFSIZ];
 	struct utsname utsbuf;
+	int dir;
 
 	/* architecture */
 	if (uname(&utsbuf) == -1)
@@ -341,8 +352,12 @@ read_basicinfo(struct lscpu_desc *desc, struct lscpu_modifier *mod)
 	desc->arch = xstrdup(utsbuf.machine);
 
 	/* count CPU(s) */
-	while(path_exist(_PATH_SYS_SYSTEM "/cpu/cpu%d", desc->ncpus))
-		desc->ncpus++;
+	dir = path_opendir(_PATH_SYS_CPU);
+	if (dir >= 0) {
+		while (path_exist_at(dir, "cpu%d", desc->ncpus))
+			desc->ncpus++;
+		close(dir);
+	}
 
 	/* details */
 	while (fgets(buf, sizeof(buf), fp) != NULL) {
@@ -563,44 +578,68 @@ read_hypervisor(struct lscpu_desc *desc)
 	}
 }
 
-/* add @set to the @ary, unnecessary set is deallocated. */
-static int add_cpuset_to_array(cpu_set_t **ary, int *items, cpu_set_t *set)
+static size_t cpuset_hashval(cpu_set_t *set, size_t setsize)
+{
+	const unsigned long *p = (const unsigned long *) set;
+	size_t i, h = 0;
+
+	for (i = 0; i < setsize / sizeof(unsigned long); i++)
+		h = (h ^ p[i]) * 0x9e3779b1 + (h >> 7);
+	return h;
+}
+
+/*
+ * add @set to the @ary, unnecessary set is deallocated. The @hash is index of
+ * the sets in @ary, the @ary is big enough for desc->ncpus items.
+ */
+static int add_cpuset_to_array(struct lscpu_desc *desc,
+			       cpu_set_t **ary, int *items,
+			       struct cpuset_hash *hash, cpu_set_t *set)
 {
-	int i;
 	size_t setsize = CPU_ALLOC_SIZE(maxcpus);
+	size_t i;
 
 	if (!ary)
 		return -1;
 
-	for (i = 0; i < *items; i++) {
-		if (CPU_EQUAL_S(setsize, set, ary[i]))
-			break;
+	if (!hash->slots) {
+		for (hash->size = 16; hash->size < (size_t) desc->ncpus * 2; )
+			hash->size <<= 1;
+		hash->slots = xcalloc(hash->size, sizeof(int));
 	}
-	if (i == *items) {
-		ary[*items] = set;
-		++*items;
-		return 0;
+
+	for (i = cpuset_hashval(set, setsize) & (hash->size - 1);
+	     hash->slots[i];
+	     i = (i + 1) & (hash->size - 1)) {
+
+		if (CPU_EQUAL_S(setsize, set, ary[hash->slots[i] - 1])) {
+			CPU_FREE(set);
+			return 1;
+		}
 	}
-	CPU_FREE(set);
-	return 1;
+
+	ary[*items] = set;
+	++*items;
+	hash->slots[i] = *items;
+	return 0;
 }
 
 static void
-read_topology(struct lscpu_desc *desc, int num)
+read_topology(struct lscpu_desc *desc, int dir)
 {
 	cpu_set_t *thread_siblings, *core_siblings, *book_siblings;
 
-	if (!path_exist(_PATH_SYS_CPU "/cpu%d/topology/thread_siblings", num))
+	if (!path_exist_at(dir, "topology/thread_siblings"))
 		return;
 
-	thread_siblings = path_cpuset(maxcpus, _PATH_SYS_CPU
-					"/cpu%d/topology/thread_siblings", num);
-	core_siblings = path_cpuset(maxcpus, _PATH_SYS_CPU
-					"/cpu%d/topology/core_siblings", num);
+	thread_siblings = path_cpuset_at(maxcpus, dir,
+					"topology/thread_siblings");
+	core_siblings = path_cpuset_at(maxcpus, dir,
+					"topology/core_siblings");
 	book_siblings = NULL;
-	if (path_exist(_PATH_SYS_CPU "/cpu%d/topology/book_siblings", num)) {
-		book_siblings = path_cpuset(maxcpus, _PATH_SYS_CPU
-					    "/cpu%d/topology/book_siblings", num);
+	if (path_exist_at(dir, "topology/book_siblings")) {
+		book_siblings = path_cpuset_at(maxcpus, dir,
+					"topology/book_siblings");
 	}
 
 	if (!desc->coremaps) {
@@ -638,23 +677,26 @@ read_topology(struct lscpu_desc *desc, int num)
 			desc->bookmaps = xcalloc(desc->ncpus, sizeof(cpu_set_t *));
 	}
 
-	add_cpuset_to_array(desc->socketmaps, &desc->nsockets, core_siblings);
-	add_cpuset_to_array(desc->coremaps, &desc->ncores, thread_siblings);
+	add_cpuset_to_array(desc, desc->socketmaps, &desc->nsockets,
+			    &desc->sockethash, core_siblings);
+	add_cpuset_to_array(desc, desc->coremaps, &desc->ncores,
+			    &desc->corehash, thread_siblings);
 	if (book_siblings)
-		add_cpuset_to_array(desc->bookmaps, &desc->nbooks, book_siblings);
+		add_cpuset_to_array(desc, desc->bookmaps, &desc->nbooks,
+				    &desc->bookhash, book_siblings);
 }
 static void
-read_polarization(struct lscpu_desc *desc, int num)
+read_polarization(struct lscpu_desc *desc, int num, int dir)
 {
 	char mode[64];
 
 	if (desc->dispatching < 0)
 		return;
-	if (!path_exist(_PATH_SYS_CPU "/cpu%d/polarization", num))
+	if (!path_exist_at(dir, "polarization"))
 		return;
 	if (!desc->polarization)
 		desc->polarization = xcalloc(desc->ncpus, sizeof(int));
-	path_getstr(mode, sizeof(mode), _PATH_SYS_CPU "/cpu%d/polarization", num);
+	path_getstr_at(mode, sizeof(mode), dir, "polarization");
 	if (strncmp(mode, "vertical:low", sizeof(mode)) == 0)
 		desc->polarization[num] = POLAR_VLOW;
 	else if (strncmp(mode, "vertical:medium", sizeof(mode)) == 0)
@@ -668,23 +710,23 @@ read_polarization(struct lscpu_desc *desc, int num)
 }
 
 static void
-read_address(struct lscpu_desc *desc, int num)
+read_address(struct lscpu_desc *desc, int num, int dir)
 {
-	if (!path_exist(_PATH_SYS_CPU "/cpu%d/address", num))
+	if (!path_exist_at(dir, "address"))
 		return;
 	if (!desc->addresses)
 		desc->addresses = xcalloc(desc->ncpus, sizeof(int));
-	desc->addresses[num] = path_getnum(_PATH_SYS_CPU "/cpu%d/address", num);
+	desc->addresses[num] = path_getnum_at(dir, "address");
 }
 
 static void
-read_configured(struct lscpu_desc *desc, int num)
+read_configured(struct lscpu_desc *desc, int num, int dir)
 {
-	if (!path_exist(_PATH_SYS_CPU "/cpu%d/configure", num))
+	if (!path_exist_at(dir, "configure"))
 		return;
 	if (!desc->configured)
 		desc->configured = xcalloc(desc->ncpus, sizeof(int));
-	desc->configured[num] = path_getnum(_PATH_SYS_CPU "/cpu%d/configure", num);
+	desc->configured[num] = path_getnum_at(dir, "configure");
 }
 
 static int
@@ -697,14 +739,13 @@ cachecmp(const void *a, const void *b)
 }
 
 static void
-read_cache(struct lscpu_desc *desc, int num)
+read_cache(struct lscpu_desc *desc, int dir)
 {
 	char buf[256];
 	int i;
 
 	if (!desc->ncaches) {
-		while(path_exist(_PATH_SYS_SYSTEM "/cpu/cpu%d/cache/index%d",
-					num, desc->ncaches))
+		while(path_exist_at(dir, "cache/index%d", desc->ncaches))
 			desc->ncaches++;
 
 		if (!desc->ncaches)
@@ -716,16 +757,14 @@ read_cache(struct lscpu_desc *desc, int num)
 		struct cpu_cache *ca = &desc->caches[i];
 		cpu_set_t *map;
 
-		if (!path_exist(_PATH_SYS_SYSTEM "/cpu/cpu%d/cache/index%d",
-				num, i))
+		if (!path_exist_at(dir, "cache/index%d", i))
 			continue;
 		if (!ca->name) {
 			int type, level;
 
 			/* cache type */
-			path_getstr(buf, sizeof(buf),
-					_PATH_SYS_CPU "/cpu%d/cache/index%d/type",
-					num, i);
+			path_getstr_at(buf, sizeof(buf), dir,
+					"cache/index%d/type", i);
 			if (!strcmp(buf, "Data"))
 				type = 'd';
 			else if (!strcmp(buf, "Instruction"))
@@ -734,8 +773,7 @@ read_cache(struct lscpu_desc *desc, int num)
 				type = 0;
 
 			/* cache level */
-			level = path_getnum(_PATH_SYS_CPU "/cpu%d/cache/index%d/level",
-					num, i);
+			level = path_getnum_at(dir, "cache/index%d/level", i);
 			if (type)
 				snprintf(buf, sizeof(buf), "L%d%c", level, type);
 			else
@@ -744,42 +782,44 @@ read_cache(struct lscpu_desc *desc, int num)
 			ca->name = xstrdup(buf);
 
 			/* cache size */
-			path_getstr(buf, sizeof(buf),
-					_PATH_SYS_CPU "/cpu%d/cache/index%d/size",
-					num, i);
+			path_getstr_at(buf, sizeof(buf), dir,
+					"cache/index%d/size", i);
 			ca->size = xstrdup(buf);
 		}
 
 		/* information about how CPUs share different caches */
-		map = path_cpuset(maxcpus,
-				  _PATH_SYS_CPU "/cpu%d/cache/index%d/shared_cpu_map",
-				  num, i);
+		map = path_cpuset_at(maxcpus, dir,
+				  "cache/index%d/shared_cpu_map", i);
 
 		if (!ca->sharedmaps)
 			ca->sharedmaps = xcalloc(desc->ncpus, sizeof(cpu_set_t *));
-		add_cpuset_to_array(ca->sharedmaps, &ca->nsharedmaps, map);
+		add_cpuset_to_array(desc, ca->sharedmaps, &ca->nsharedmaps,
+				    &ca->sharedhash, map);
 	}
 }
 
 static void
 read_nodes(struct lscpu_desc *desc)
 {
-	int i;
+	int i, dir;
+
+	dir = path_opendir(_PATH_SYS_SYSTEM "/node");
+	if (dir < 0)
+		return;
 
 	/* number of NUMA node */
-	while (path_exist(_PATH_SYS_SYSTEM "/node/node%d", desc->nnodes))
+	while (path_exist_at(dir, "node%d", desc->nnodes))
 		desc->nnodes++;
 
-	if (!desc->nnodes)
-		return;
-
-	desc->nodemaps = xcalloc(desc->nnodes, sizeof(cpu_set_t *));
+	if (desc->nnodes) {
+		desc->nodemaps = xcalloc(desc->nnodes, sizeof(cpu_set_t *));
 
-	/* information about how nodes share different CPUs */
-	for (i = 0; i < desc->nnodes; i++)
-		desc->nodemaps[i] = path_cpuset(maxcpus,
-					_PATH_SYS_SYSTEM "/node/node%d/cpumap",
-					i);
+		/* information about how nodes share different CPUs */
+		for (i = 0; i < desc->nnodes; i++)
+			desc->nodemaps[i] = path_cpuset_at(maxcpus, dir,
+						"node%d/cpumap", i);
+	}
+	close(dir);
 }
 
 static char *
@@ -1340,11 +1380,17 @@ int main(int argc, char *argv[])
 	read_basicinfo(desc, mod);
 
 	for (i = 0; i < desc->ncpus; i++) {
-		read_topology(desc, i);
-		read_cache(desc, i);
-		read_polarization(desc, i);
-		read_address(desc, i);
-		read_configured(desc, i);
+		/* all the per-CPU attributes are read relatively to cpuN/ */
+		int dir = path_opendir(_PATH_SYS_CPU "/cpu%d", i);
+
+		if (dir < 0)
+			continue;
+		read_topology(desc, dir);
+		read_cache(desc, dir);
+		read_polarization(desc, i, dir);
+		read_address(desc, i, dir);
+		read_configured(desc, i, dir);
+		close(dir);
 	}
 
 	if (desc->caches)
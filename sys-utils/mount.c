@@ -119,21 +119,61 @@ static void safe_fputs(const char *data)
 	}
 }
 
+/* reads labels of all listed devices at once, see mnt_cache_read_tags_set() */
+static void prefetch_labels(struct libmnt_table *tb, struct libmnt_iter *itr,
+			    struct libmnt_cache *cache, struct libmnt_pattern *pat)
+{
+	struct libmnt_fs *fs;
+	const char **devs;
+	size_t ndevs = 0;
+	long ncpus;
+
+	if (!cache)
+		return;
+
+	devs = xcalloc(mnt_table_get_nents(tb), sizeof(char *));
+
+	while (mnt_table_next_fs(tb, itr, &fs) == 0) {
+		const char *type = mnt_fs_get_fstype(fs);
+		const char *src = mnt_fs_get_source(fs);
+
+		if (type && pat && !mnt_pattern_match(pat, type))
+			continue;
+		if (src && *src == '/' && !mnt_fs_is_pseudofs(fs)
+		    && !mnt_fs_is_netfs(fs))
+			devs[ndevs++] = src;
+	}
+	mnt_reset_iter(itr, -1);
+
+	ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	mnt_cache_read_tags_set(cache, devs, ndevs, ncpus > 0 ? ncpus : 1);
+	free(devs);
+}
+
 static void print_all(struct libmnt_context *cxt, char *pattern, int show_label)
 {
 	struct libmnt_table *tb;
 	struct libmnt_iter *itr = NULL;
 	struct libmnt_fs *fs;
 	struct libmnt_cache *cache = NULL;
+	struct libmnt_pattern *pat = NULL;
 
 	if (mnt_context_get_mtab(cxt, &tb))
 		err(MOUNT_EX_SYSERR, _("failed to read mtab"));
 
+	if (pattern) {
+		pat = mnt_new_pattern(MNT_PATTERN_FSTYPE, pattern);
+		if (!pat)
+			err(MOUNT_EX_SYSERR, _("failed to compile pattern"));
+	}
+
 	itr = mnt_new_iter(MNT_ITER_FORWARD);
 	if (!itr)
 		err(MOUNT_EX_SYSERR, _("failed to initialize libmount iterator"));
-	if (show_label)
+	if (show_label) {
 		cache = mnt_new_cache();
+		prefetch_labels(tb, itr, cache, pat);
+	}
 
 	while (mnt_table_next_fs(tb, itr, &fs) == 0) {
 		const char *type = mnt_fs_get_fstype(fs);
@@ -141,7 +181,7 @@ static void print_all(struct libmnt_context *cxt, char *pattern, int show_label)
 		const char *optstr = mnt_fs_get_options(fs);
 		char *xsrc = NULL;
 
-		if (type && pattern && !mnt_match_fstype(type, pattern))
+		if (type && pat && !mnt_pattern_match(pat, type))
 			continue;
 
 		if (!mnt_fs_is_pseudofs(fs))
@@ -162,6 +202,7 @@ static void print_all(struct libmnt_context *cxt, char *pattern, int show_label)
 		free(xsrc);
 	}
 
+	mnt_free_pattern(pat);
 	mnt_free_cache(cache);
 	mnt_free_iter(itr);
 }
@@ -230,6 +271,58 @@ static int mount_all(struct libmnt_context *cxt)
 	return rc;
 }
 
+/* mount -a --parallel */
+static int set_nsucc, set_nerrs;
+
+static int mount_set_worker(struct libmnt_context *cxt,
+			    struct libmnt_fs *fs __attribute__((__unused__)),
+			    int mntrc)
+{
+	return mk_exit_code(cxt, mntrc);	/* to print warnings */
+}
+
+static void mount_set_done(struct libmnt_context *cxt, struct libmnt_fs *fs,
+			   int ignored, int status, unsigned long usec)
+{
+	const char *tgt = mnt_fs_get_target(fs);
+
+	if (ignored) {
+		if (mnt_context_is_verbose(cxt))
+			printf(ignored == 1 ? _("%-25s: ignored\n") :
+					      _("%-25s: already mounted\n"),
+					tgt);
+	} else if (status == MOUNT_EX_SUCCESS) {
+		set_nsucc++;
+		if (mnt_context_is_verbose(cxt))
+			printf(_("%-25s: successfully mounted [%lu.%06lu s]\n"),
+					tgt, usec / 1000000, usec % 1000000);
+	} else {
+		set_nerrs++;
+		if (status < 0)
+			warnx(_("%s: mount process failed"), tgt);
+	}
+}
+
+static int mount_all_parallel(struct libmnt_context *cxt, int nworkers)
+{
+	int rc;
+
+	rc = mnt_context_mount_set(cxt, nworkers,
+				   mount_set_worker, mount_set_done);
+	if (rc) {
+		errno = -rc;
+		warn(_("failed to mount filesystems"));
+		return MOUNT_EX_SYSERR;
+	}
+
+	if (set_nerrs == 0)
+		return MOUNT_EX_SUCCESS;	/* all success */
+	else if (set_nsucc == 0)
+		return MOUNT_EX_FAIL;		/* all failed */
+
+	return MOUNT_EX_SOMEOK;			/* some success, some failed */
+}
+
 static void success_message(struct libmnt_context *cxt)
 {
 	unsigned long mflags = 0;
@@ -620,6 +713,7 @@ static void __attribute__((__noreturn__)) usage(FILE *out)
 	" -c, --no-canonicalize   don't canonicalize paths\n"
 	" -f, --fake              dry run; skip the mount(2) syscall\n"
 	" -F, --fork              fork off for each device (use with -a)\n"
+	"     --parallel <num>    mount up to <num> devices at once (use with -a)\n"
 	" -T, --fstab <path>      alternative file to /etc/fstab\n"));
 	fprintf(out, _(
 	" -h, --help              display this help text and exit\n"
@@ -680,7 +774,7 @@ static void __attribute__((__noreturn__)) usage(FILE *out)
 
 int main(int argc, char **argv)
 {
-	int c, rc = MOUNT_EX_SUCCESS, all = 0, show_labels = 0;
+	int c, rc = MOUNT_EX_SUCCESS, all = 0, show_labels = 0, nworkers = 0;
 	struct libmnt_context *cxt;
 	struct libmnt_table *fstab = NULL;
 	char *srcbuf = NULL;
@@ -697,7 +791,8 @@ int main(int argc, char **argv)
 		MOUNT_OPT_RPRIVATE,
 		MOUNT_OPT_RUNBINDABLE,
 		MOUNT_OPT_TARGET,
-		MOUNT_OPT_SOURCE
+		MOUNT_OPT_SOURCE,
+		MOUNT_OPT_PARALLEL
 	};
 
 	static const struct option longopts[] = {
@@ -705,6 +800,7 @@ int main(int argc, char **argv)
 		{ "fake", 0, 0, 'f' },
 		{ "fstab", 1, 0, 'T' },
 		{ "fork", 0, 0, 'F' },
+		{ "parallel", 1, 0, MOUNT_OPT_PARALLEL },
 		{ "help", 0, 0, 'h' },
 		{ "no-mtab", 0, 0, 'n' },
 		{ "read-only", 0, 0, 'r' },
@@ -745,6 +841,7 @@ int main(int argc, char **argv)
 		   MOUNT_OPT_RSHARED,  MOUNT_OPT_RSLAVE,
 		   MOUNT_OPT_RPRIVATE, MOUNT_OPT_RUNBINDABLE },
 
+		{ 'F', MOUNT_OPT_PARALLEL },	/* fork,parallel */
 		{ 'L','U', MOUNT_OPT_SOURCE },	/* label,uuid,source */
 		{ 0 }
 	};
@@ -885,6 +982,13 @@ int main(int argc, char **argv)
 			mnt_context_disable_swapmatch(cxt, 1);
 			mnt_context_set_target(cxt, optarg);
 			break;
+		case MOUNT_OPT_PARALLEL:
+			nworkers = strtou32_or_err(optarg,
+					_("failed to parse number of workers"));
+			if (nworkers < 1)
+				errx(MOUNT_EX_USAGE, _("the number of workers "
+						"must be greater than zero"));
+			break;
 		case MOUNT_OPT_SOURCE:
 			mnt_context_disable_swapmatch(cxt, 1);
 			mnt_context_set_source(cxt, optarg);
@@ -921,7 +1025,10 @@ int main(int argc, char **argv)
 		/*
 		 * A) Mount all
 		 */
-		rc = mount_all(cxt);
+		if (nworkers)
+			rc = mount_all_parallel(cxt, nworkers);
+		else
+			rc = mount_all(cxt);
 		goto done;
 
 	} else if (argc == 0 && (mnt_context_get_source(cxt) ||
@@ -5,6 +5,7 @@
 #include <string.h>
 #include <errno.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/wait.h>
@@ -75,7 +76,9 @@ static int discard;
 /* If true, don't complain if the device/file doesn't exist */
 static int ifexists;
 static int fixpgsz;
+static int fake;	/* --fake, don't call swapon(2) */
 static int verbose;
+static unsigned int nworkers;	/* --parallel */
 
 /* column names */
 struct colinfo {
@@ -544,25 +547,12 @@ err:
 	return -1;
 }
 
-static int do_swapon(const char *orig_special, int prio,
-		     int fl_discard, int canonic)
+static int swapon_device(const char *special, const char *orig_special,
+			 int prio, int fl_discard)
 {
 	int status;
-	const char *special = orig_special;
 	int flags = 0;
 
-	if (verbose)
-		printf(_("swapon %s\n"), orig_special);
-
-	if (!canonic) {
-		special = mnt_resolve_spec(orig_special, mntcache);
-		if (!special)
-			return cannot_find(orig_special);
-	}
-
-	if (swapon_checks(special))
-		return -1;
-
 #ifdef SWAP_FLAG_PREFER
 	if (prio >= 0) {
 		if (prio > SWAP_FLAG_PRIO_MASK)
@@ -575,13 +565,33 @@ static int do_swapon(const char *orig_special, int prio,
 	if (fl_discard)
 		flags |= SWAP_FLAG_DISCARD;
 
-	status = swapon(special, flags);
+	status = fake ? 0 : swapon(special, flags);
 	if (status < 0)
 		warn(_("%s: swapon failed"), orig_special);
 
 	return status;
 }
 
+static int do_swapon(const char *orig_special, int prio,
+		     int fl_discard, int canonic)
+{
+	const char *special = orig_special;
+
+	if (verbose)
+		printf(_("swapon %s\n"), orig_special);
+
+	if (!canonic) {
+		special = mnt_resolve_spec(orig_special, mntcache);
+		if (!special)
+			return cannot_find(orig_special);
+	}
+
+	if (swapon_checks(special))
+		return -1;
+
+	return swapon_device(special, orig_special, prio, fl_discard);
+}
+
 static int swapon_by_label(const char *label, int prio, int dsc)
 {
 	const char *special = mnt_resolve_tag("LABEL", label, mntcache);
@@ -596,11 +606,119 @@ static int swapon_by_uuid(const char *uuid, int prio, int dsc)
 			 cannot_find(uuid);
 }
 
+/*
+ * swapon --all --parallel
+ */
+struct swap_entry {
+	const char	*special;	/* resolved by mntcache */
+	int		prio;
+	int		discard;
+	size_t		idx;		/* fstab order */
+
+	pid_t		pid;		/* checking process */
+	int		checked;	/* swapon_checks() succeeded */
+	struct timeval	start;
+	unsigned long	usec;		/* time spent in swapon_checks() */
+};
+
+static int cmp_swap_entries(const void *a, const void *b)
+{
+	const struct swap_entry *x = a, *y = b;
+
+	/* higher priority first, the fstab order for the same priority */
+	if (x->prio != y->prio)
+		return x->prio > y->prio ? -1 : 1;
+	return x->idx < y->idx ? -1 : 1;
+}
+
+static void start_check(struct swap_entry *ent)
+{
+	gettimeofday(&ent->start, NULL);
+	fflush(stdout);
+	fflush(stderr);
+
+	ent->pid = fork();
+	if (ent->pid == 0)
+		_exit(swapon_checks(ent->special) ? EXIT_FAILURE : EXIT_SUCCESS);
+	if (ent->pid < 0)
+		warn(_("fork failed"));
+}
+
+/*
+ * Checks (and fixes) the swap headers of all the devices by up to @nworkers
+ * processes, then calls swapon(2) in the priority order.
+ */
+static int swapon_all_parallel(struct swap_entry *ents, size_t nents)
+{
+	size_t next = 0, running = 0, i;
+	int status = 0;
+
+	while (next < nents || running) {
+		struct timeval now;
+		pid_t pid;
+		int st;
+
+		if (next < nents && running < nworkers) {
+			start_check(&ents[next]);
+			if (ents[next].pid > 0)
+				running++;
+			else
+				status |= -1;
+			next++;
+			continue;
+		}
+
+		pid = waitpid(-1, &st, 0);
+		if (pid < 0) {
+			if (errno == EINTR)
+				continue;
+			warn(_("waitpid failed"));
+			status |= -1;
+			break;
+		}
+		gettimeofday(&now, NULL);
+
+		for (i = 0; i < next; i++) {
+			struct swap_entry *ent = &ents[i];
+
+			if (ent->pid != pid)
+				continue;
+			ent->pid = 0;
+			ent->usec = (now.tv_sec - ent->start.tv_sec) * 1000000UL
+				    + now.tv_usec - ent->start.tv_usec;
+			ent->checked = WIFEXITED(st) &&
+				       WEXITSTATUS(st) == EXIT_SUCCESS;
+			if (!ent->checked)
+				status |= -1;
+			running--;
+			break;
+		}
+	}
+
+	qsort(ents, nents, sizeof(struct swap_entry), cmp_swap_entries);
+
+	for (i = 0; i < nents; i++) {
+		struct swap_entry *ent = &ents[i];
+
+		if (!ent->checked)
+			continue;
+		if (verbose)
+			printf(_("swapon %s [checked in %lu.%06lu s]\n"),
+					ent->special, ent->usec / 1000000,
+					ent->usec % 1000000);
+		status |= swapon_device(ent->special, ent->special,
+					ent->prio, ent->discard);
+	}
+	return status;
+}
+
 static int swapon_all(void)
 {
 	struct libmnt_table *tb = get_fstab();
 	struct libmnt_iter *itr;
 	struct libmnt_fs *fs;
+	struct swap_entry *ents = NULL;
+	size_t nents = 0;
 	int status = 0;
 
 	if (!tb)
@@ -631,11 +749,27 @@ static int swapon_all(void)
 			continue;
 		}
 
-		if (!is_active_swap(src) &&
-		    (!nofail || !access(src, R_OK)))
+		if (is_active_swap(src) || (nofail && access(src, R_OK)))
+			continue;
+
+		if (nworkers) {
+			struct swap_entry *ent;
+
+			ents = xrealloc(ents, (nents + 1) * sizeof(*ents));
+			ent = &ents[nents];
+			memset(ent, 0, sizeof(*ent));
+			ent->special = src;
+			ent->prio = pri;
+			ent->discard = dsc;
+			ent->idx = nents++;
+		} else
 			status |= do_swapon(src, pri, dsc, CANONIC);
 	}
 
+	if (nents)
+		status |= swapon_all_parallel(ents, nents);
+
+	free(ents);
 	mnt_free_iter(itr);
 	return status;
 }
@@ -651,8 +785,10 @@ static void __attribute__ ((__noreturn__)) usage(FILE * out)
 	fputs(_(" -a, --all              enable all swaps from /etc/fstab\n"
 		" -d, --discard          discard freed pages before they are reused\n"
 		" -e, --ifexists         silently skip devices that do not exist\n"
+		"     --fake             dry run; skip the swapon(2) syscall\n"
 		" -f, --fixpgsz          reinitialize the swap space if necessary\n"
 		" -p, --priority <prio>  specify the priority of the swap device\n"
+		"     --parallel <num>   check up to <num> devices at once, use with --all\n"
 		" -s, --summary          display summary about used swap devices\n"
 		"     --show[=<columns>] display summary in definable table\n"
 		"     --noheadings       don't print headings, use with --show\n"
@@ -693,7 +829,9 @@ int main(int argc, char *argv[])
 		SHOW_OPTION = CHAR_MAX + 1,
 		RAW_OPTION,
 		NOHEADINGS_OPTION,
-		BYTES_OPTION
+		BYTES_OPTION,
+		PARALLEL_OPTION,
+		FAKE_OPTION
 	};
 
 	static const struct option long_opts[] = {
@@ -710,6 +848,8 @@ int main(int argc, char *argv[])
 		{ "noheadings", 0, 0, NOHEADINGS_OPTION },
 		{ "raw",      0, 0, RAW_OPTION },
 		{ "bytes",    0, 0, BYTES_OPTION },
+		{ "parallel", 1, 0, PARALLEL_OPTION },
+		{ "fake",     0, 0, FAKE_OPTION },
 		{ NULL, 0, 0, 0 }
 	};
 
@@ -775,6 +915,16 @@ int main(int argc, char *argv[])
 		case BYTES_OPTION:
 			bytes = 1;
 			break;
+		case PARALLEL_OPTION:
+			nworkers = strtou32_or_err(optarg,
+					_("failed to parse number of workers"));
+			if (nworkers < 1)
+				errx(EXIT_FAILURE, _("the number of workers "
+						"must be greater than zero"));
+			break;
+		case FAKE_OPTION:
+			fake = 1;
+			break;
 		case 'V':		/* version */
 			printf(UTIL_LINUX_VERSION);
 			return EXIT_SUCCESS;
@@ -803,7 +953,7 @@ int main(int argc, char *argv[])
 	if (!all && !numof_labels() && !numof_uuids() && *argv == NULL)
 		usage(stderr);
 
-	if (ifexists && !all)
+	if ((ifexists || nworkers) && !all)
 		usage(stderr);
 
 	if (all)
@@ -33,6 +33,7 @@
 #include "c.h"
 #include "env.h"
 #include "optutils.h"
+#include "strutils.h"
 #include "exitcodes.h"
 #include "closestream.h"
 
@@ -88,6 +89,8 @@ static void __attribute__((__noreturn__)) usage(FILE *out)
 	" -l, --lazy              detach the filesystem now, and cleanup all later\n"));
 	fprintf(out, _(
 	" -O, --test-opts <list>  limit the set of filesystems (use with -a)\n"
+	"     --parallel <num>    umount up to <num> filesystems at once (use with -a)\n"
+	" -R, --recursive         umount the filesystem and all filesystems below it\n"
 	" -r, --read-only         In case unmounting fails, try to remount read-only\n"
 	" -t, --types <list>      limit the set of filesystem types\n"
 	" -v, --verbose           say what is being done\n"));
@@ -280,6 +283,51 @@ static int umount_all(struct libmnt_context *cxt)
 	return rc;
 }
 
+/* umount -a --parallel */
+static int umount_set_worker(struct libmnt_context *cxt,
+			     struct libmnt_fs *fs __attribute__((__unused__)),
+			     int mntrc)
+{
+	return mk_exit_code(cxt, mntrc);	/* to print warnings */
+}
+
+static int set_rc;
+
+static void umount_set_done(struct libmnt_context *cxt, struct libmnt_fs *fs,
+			    int ignored, int status, unsigned long usec)
+{
+	const char *tgt = mnt_fs_get_target(fs);
+
+	if (ignored) {
+		if (mnt_context_is_verbose(cxt))
+			printf(_("%-25s: ignored\n"), tgt);
+		return;
+	}
+	if (status < 0) {
+		warnx(_("%s: umount process failed"), tgt);
+		status = MOUNT_EX_SYSERR;
+	}
+	set_rc |= status;
+
+	if (mnt_context_is_verbose(cxt) && status == MOUNT_EX_SUCCESS)
+		printf(_("%-25s: successfully umounted [%lu.%06lu s]\n"),
+				tgt, usec / 1000000, usec % 1000000);
+}
+
+static int umount_all_parallel(struct libmnt_context *cxt, int nworkers)
+{
+	int rc;
+
+	rc = mnt_context_umount_set(cxt, nworkers,
+				    umount_set_worker, umount_set_done);
+	if (rc) {
+		errno = -rc;
+		warn(_("failed to umount filesystems"));
+		return MOUNT_EX_SYSERR;
+	}
+	return set_rc;
+}
+
 static int umount_one(struct libmnt_context *cxt, const char *spec)
 {
 	int rc;
@@ -300,14 +348,40 @@ static int umount_one(struct libmnt_context *cxt, const char *spec)
 	return rc;
 }
 
+/* umount --recursive */
+static void umount_recursive_done(struct libmnt_context *cxt,
+				  struct libmnt_fs *fs __attribute__((__unused__)))
+{
+	success_message(cxt);
+}
+
+static int umount_recursive(struct libmnt_context *cxt, const char *spec)
+{
+	int rc;
+
+	if (!spec)
+		return -EINVAL;
+
+	if (mnt_context_set_target(cxt, spec))
+		err(MOUNT_EX_SYSERR, _("failed to set umount target"));
+
+	rc = mnt_context_umount_recursive(cxt, mnt_context_is_verbose(cxt) ?
+					       umount_recursive_done : NULL);
+	rc = mk_exit_code(cxt, rc);
+
+	mnt_reset_context(cxt);
+	return rc;
+}
+
 int main(int argc, char **argv)
 {
-	int c, rc = 0, all = 0;
+	int c, rc = 0, all = 0, recursive = 0, nworkers = 0;
 	struct libmnt_context *cxt;
 	char *types = NULL;
 
 	enum {
 		UMOUNT_OPT_FAKE = CHAR_MAX + 1,
+		UMOUNT_OPT_PARALLEL
 	};
 
 	static const struct option longopts[] = {
@@ -320,7 +394,9 @@ int main(int argc, char **argv)
 		{ "lazy", 0, 0, 'l' },
 		{ "no-canonicalize", 0, 0, 'c' },
 		{ "no-mtab", 0, 0, 'n' },
+		{ "parallel", 1, 0, UMOUNT_OPT_PARALLEL },
 		{ "read-only", 0, 0, 'r' },
+		{ "recursive", 0, 0, 'R' },
 		{ "test-opts", 1, 0, 'O' },
 		{ "types", 1, 0, 't' },
 		{ "verbose", 0, 0, 'v' },
@@ -341,7 +417,7 @@ int main(int argc, char **argv)
 
 	mnt_context_set_tables_errcb(cxt, table_parser_errcb);
 
-	while ((c = getopt_long(argc, argv, "acdfhilnrO:t:vV",
+	while ((c = getopt_long(argc, argv, "acdfhilnRrO:t:vV",
 					longopts, NULL)) != -1) {
 
 
@@ -377,6 +453,16 @@ int main(int argc, char **argv)
 		case 'n':
 			mnt_context_disable_mtab(cxt, TRUE);
 			break;
+		case UMOUNT_OPT_PARALLEL:
+			nworkers = strtou32_or_err(optarg,
+					_("failed to parse number of workers"));
+			if (nworkers < 1)
+				errx(MOUNT_EX_USAGE, _("the number of workers "
+						"must be greater than zero"));
+			break;
+		case 'R':
+			recursive = 1;
+			break;
 		case 'r':
 			mnt_context_enable_rdonly_umount(cxt, TRUE);
 			break;
@@ -407,11 +493,16 @@ int main(int argc, char **argv)
 			types = "noproc,nodevfs,nodevpts,nosysfs,norpc_pipefs,nonfsd";
 
 		mnt_context_set_fstype_pattern(cxt, types);
-		rc = umount_all(cxt);
+		rc = nworkers ? umount_all_parallel(cxt, nworkers) :
+				umount_all(cxt);
 
 	} else if (argc < 1) {
 		usage(stderr);
 
+	} else if (recursive) {
+		while (argc--)
+			rc += umount_recursive(cxt, *argv++);
+
 	} else while (argc--)
 		rc += umount_one(cxt, *argv++);
 
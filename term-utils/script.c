@@ -58,10 +58,15 @@
 #include <limits.h>
 #include <locale.h>
 #include <stddef.h>
+#include <poll.h>
+#include <sys/wait.h>
 
 #include "closestream.h"
 #include "nls.h"
 #include "c.h"
+#include "all-io.h"
+#include "strutils.h"
+#include "xalloc.h"
 
 #if defined(HAVE_LIBUTIL) && defined(HAVE_PTY_H)
 # include <pty.h>
@@ -73,6 +78,9 @@
 
 #define DEFAULT_OUTPUT "typescript"
 
+/* size of the I/O buffers, and of the typescript and timing stdio buffers */
+#define SCRIPT_BUFSIZ	(64 * 1024)
+
 void finish(int);
 void done(void);
 void fail(void);
@@ -80,8 +88,7 @@ void resize(int);
 void fixtty(void);
 void getmaster(void);
 void getslave(void);
-void doinput(void);
-void dooutput(FILE *timingfd);
+void doio(FILE *timingfd);
 void doshell(void);
 
 char	*shell;
@@ -89,7 +96,6 @@ FILE	*fscript;
 int	master = -1;
 int	slave;
 pid_t	child;
-pid_t	subchild;
 int	childstatus;
 char	*fname;
 
@@ -107,6 +113,7 @@ int	fflg = 0;
 int	qflg = 0;
 int	tflg = 0;
 int	forceflg = 0;
+int	flush_interval = 0;	/* msec, 0 means flush when buffers are full */
 
 int die;
 int resized;
@@ -136,6 +143,8 @@ usage(FILE *out)
 		" -c, --command <command> run command rather than interactive shell\n"
 		" -e, --return            return exit code of the child process\n"
 		" -f, --flush             run flush after each write\n"
+		"     --flush-interval <msec>\n"
+		"                         flush output at most every <msec>\n"
 		"     --force             use output file even when it is a link\n"
 		" -q, --quiet             be quiet\n"
 		" -t, --timing[=<file>]   output timing data to stderr (or to FILE)\n"
@@ -161,13 +170,17 @@ main(int argc, char **argv) {
 	int ch;
 	FILE *timingfd = stderr;
 
-	enum { FORCE_OPTION = CHAR_MAX + 1 };
+	enum {
+		FORCE_OPTION = CHAR_MAX + 1,
+		FLUSH_INTERVAL_OPTION
+	};
 
 	static const struct option longopts[] = {
 		{ "append",	no_argument,	   NULL, 'a' },
 		{ "command",	required_argument, NULL, 'c' },
 		{ "return",	no_argument,	   NULL, 'e' },
 		{ "flush",	no_argument,	   NULL, 'f' },
+		{ "flush-interval", required_argument, NULL, FLUSH_INTERVAL_OPTION },
 		{ "force",	no_argument,	   NULL, FORCE_OPTION, },
 		{ "quiet",	no_argument,	   NULL, 'q' },
 		{ "timing",	optional_argument, NULL, 't' },
@@ -199,6 +212,12 @@ main(int argc, char **argv) {
 		case FORCE_OPTION:
 			forceflg = 1;
 			break;
+		case FLUSH_INTERVAL_OPTION:
+			flush_interval = strtos32_or_err(optarg,
+					_("failed to parse flush interval"));
+			if (flush_interval < 0)
+				errx(EXIT_FAILURE, _("invalid flush interval"));
+			break;
 		case 'q':
 			qflg = 1;
 			break;
@@ -264,58 +283,16 @@ main(int argc, char **argv) {
 		warn(_("fork failed"));
 		fail();
 	}
-	if (child == 0) {
-
-		sigprocmask(SIG_SETMASK, &block_mask, NULL);
-		subchild = child = fork();
-		sigprocmask(SIG_SETMASK, &unblock_mask, NULL);
+	if (child == 0)
+		doshell();
 
-		if (child < 0) {
-			warn(_("fork failed"));
-			fail();
-		}
-		if (child)
-			dooutput(timingfd);
-		else
-			doshell();
-	} else {
-		sa.sa_handler = resize;
-		sigaction(SIGWINCH, &sa, NULL);
-	}
-	doinput();
+	sa.sa_handler = resize;
+	sigaction(SIGWINCH, &sa, NULL);
 
-	if (close_stream(timingfd) != 0)
-		errx(EXIT_FAILURE, _("write error"));
+	doio(timingfd);
 	return EXIT_SUCCESS;
 }
 
-void __attribute__((__noreturn__))
-doinput(void) {
-	ssize_t cc;
-	char ibuf[BUFSIZ];
-
-	if (close_stream(fscript) != 0)
-		errx(EXIT_FAILURE, _("write error"));
-
-	while (die == 0) {
-		if ((cc = read(STDIN_FILENO, ibuf, BUFSIZ)) > 0) {
-			ssize_t wrt = write(master, ibuf, cc);
-			if (wrt < 0) {
-				warn (_("write failed"));
-				fail();
-			}
-		}
-		else if (cc < 0 && errno == EINTR && resized)
-			resized = 0;
-		else
-			break;
-	}
-
-	done();
-}
-
-#include <sys/wait.h>
-
 void
 finish(int dummy __attribute__ ((__unused__))) {
 	int status;
@@ -331,9 +308,6 @@ finish(int dummy __attribute__ ((__unused__))) {
 void
 resize(int dummy __attribute__ ((__unused__))) {
 	resized = 1;
-	/* transmit window change information to the child */
-	ioctl(STDIN_FILENO, TIOCGWINSZ, (char *)&win);
-	ioctl(slave, TIOCSWINSZ, (char *)&win);
 }
 
 /*
@@ -345,69 +319,191 @@ my_strftime(char *buf, size_t len, const char *fmt, const struct tm *tm) {
 	strftime(buf, len, fmt, tm);
 }
 
-void __attribute__((__noreturn__))
-dooutput(FILE *timingfd) {
+static long long
+now_msec(struct timeval *tv) {
+	gettimeofday(tv, NULL);
+	return (long long) tv->tv_sec * 1000 + tv->tv_usec / 1000;
+}
+
+static void
+flush_output(FILE *timingfd) {
+	if (fflush(fscript) != 0) {
+		warn (_("cannot write script file"));
+		fail();
+	}
+	if (tflg)
+		fflush(timingfd);
+}
+
+/*
+ * Copy the pty output to stdout and to the typescript.  Returns the number
+ * of bytes read from the pty master, 0 on EOF or error.
+ */
+static ssize_t
+copy_output(char *buf, size_t bufsz, FILE *timingfd, double *oldtime) {
+	struct timeval tv;
 	ssize_t cc;
-	time_t tvec;
-	char obuf[BUFSIZ];
+
+	cc = read(master, buf, bufsz);
+	if (cc <= 0)
+		return cc;
+
+	if (tflg) {
+		double newtime;
+
+		gettimeofday(&tv, NULL);
+		newtime = tv.tv_sec + (double) tv.tv_usec / 1000000;
+		fprintf(timingfd, "%f %zd\n", newtime - *oldtime, cc);
+		*oldtime = newtime;
+	}
+	if (write_all(STDOUT_FILENO, buf, cc)) {
+		warn (_("write failed"));
+		fail();
+	}
+	if (fwrite_all(buf, 1, cc, fscript)) {
+		warn (_("cannot write script file"));
+		fail();
+	}
+	return cc;
+}
+
+/*
+ * The main loop, copies stdin to the pty master and the pty output to
+ * stdout and to the typescript.  The typescript and the timing data are
+ * buffered and flushed when the buffers are full, after each write with
+ * --flush, or at most every --flush-interval milliseconds.
+ */
+void __attribute__((__noreturn__))
+doio(FILE *timingfd) {
+	struct pollfd pfd[2];
 	struct timeval tv;
-	double oldtime=time(NULL), newtime;
-	int flgs = 0;
-	ssize_t wrt;
-	ssize_t fwrt;
+	sigset_t block_mask, unblock_mask;
+	time_t tvec;
+	char *buf;
+	double oldtime = time(NULL);
+	long long last_flush = 0;
+	int dirty = 0, flgs;
+	ssize_t cc;
+
+	buf = xmalloc(SCRIPT_BUFSIZ);
 
-	close(STDIN_FILENO);
 #ifdef HAVE_LIBUTIL
 	close(slave);
 #endif
+	setvbuf(fscript, NULL, _IOFBF, SCRIPT_BUFSIZ);
+	if (tflg)
+		setvbuf(timingfd, NULL, _IOFBF, SCRIPT_BUFSIZ);
+
 	tvec = time((time_t *)NULL);
-	my_strftime(obuf, sizeof obuf, "%c\n", localtime(&tvec));
-	fprintf(fscript, _("Script started on %s"), obuf);
-
-	do {
-		if (die && flgs == 0) {
-			/* ..child is dead, but it doesn't mean that there is
-			 * nothing in buffers.
-			 */
-			flgs = fcntl(master, F_GETFL, 0);
-			if (fcntl(master, F_SETFL, (flgs | O_NONBLOCK)) == -1)
-				break;
-		}
-		if (tflg)
-			gettimeofday(&tv, NULL);
-
-		errno = 0;
-		cc = read(master, obuf, sizeof (obuf));
-
-		if (die && errno == EINTR && cc <= 0)
-			/* read() has been interrupted by SIGCHLD, try it again
-			 * with O_NONBLOCK
-			 */
-			continue;
-		if (cc <= 0)
-			break;
-		if (tflg) {
-			newtime = tv.tv_sec + (double) tv.tv_usec / 1000000;
-			fprintf(timingfd, "%f %zd\n", newtime - oldtime, cc);
-			oldtime = newtime;
+	my_strftime(buf, SCRIPT_BUFSIZ, "%c\n", localtime(&tvec));
+	fprintf(fscript, _("Script started on %s"), buf);
+
+	/* SIGCHLD and SIGWINCH are delivered only when waiting in ppoll() */
+	sigemptyset(&block_mask);
+	sigaddset(&block_mask, SIGCHLD);
+	sigaddset(&block_mask, SIGWINCH);
+	sigprocmask(SIG_BLOCK, &block_mask, &unblock_mask);
+
+	pfd[0].fd = master;
+	pfd[0].events = POLLIN;
+	pfd[1].fd = STDIN_FILENO;
+	pfd[1].events = POLLIN;
+
+	while (die == 0) {
+		struct timespec ts, *timeout = NULL;
+		int rc;
+
+		if (dirty && flush_interval) {
+			long long left = last_flush + flush_interval - now_msec(&tv);
+
+			if (left <= 0) {
+				flush_output(timingfd);
+				dirty = 0;
+				last_flush = now_msec(&tv);
+			} else {
+				ts.tv_sec = left / 1000;
+				ts.tv_nsec = (left % 1000) * 1000000;
+				timeout = &ts;
+			}
 		}
-		wrt = write(STDOUT_FILENO, obuf, cc);
-		if (wrt < 0) {
-			warn (_("write failed"));
+
+		rc = ppoll(pfd, 2, timeout, &unblock_mask);
+		if (rc < 0) {
+			if (errno == EINTR) {
+				if (resized) {
+					resized = 0;
+					/* transmit window change information
+					 * to the child, the slave is no more
+					 * open in this process */
+					ioctl(STDIN_FILENO, TIOCGWINSZ, (char *)&win);
+					if (ioctl(master, TIOCSWINSZ, (char *)&win) < 0)
+						warn(_("failed to set window size"));
+				}
+				continue;
+			}
+			warn(_("poll failed"));
 			fail();
 		}
-		fwrt = fwrite(obuf, 1, cc, fscript);
-		if (fwrt < cc) {
-			warn (_("cannot write script file"));
-			fail();
+		if (rc == 0)
+			continue;	/* flush timeout */
+
+		if (pfd[1].revents) {
+			cc = read(STDIN_FILENO, buf, SCRIPT_BUFSIZ);
+			if (cc > 0) {
+				if (write_all(master, buf, cc)) {
+					warn (_("write failed"));
+					fail();
+				}
+			} else if (cc < 0 && errno == EINTR)
+				;
+			else {
+				/* EOF, pass it to the shell and stop reading */
+				struct termios mtt;
+				char eof = 4;		/* ^D */
+
+				if (tcgetattr(master, &mtt) == 0 &&
+				    mtt.c_cc[VEOF] != _POSIX_VDISABLE)
+					eof = mtt.c_cc[VEOF];
+				if (write(master, &eof, 1) != 1)
+					break;
+				pfd[1].fd = -1;
+			}
+		}
+
+		if (pfd[0].revents) {
+			cc = copy_output(buf, SCRIPT_BUFSIZ, timingfd, &oldtime);
+			if (cc < 0 && errno == EINTR)
+				continue;
+			if (cc <= 0)
+				break;
+			if (fflg)
+				flush_output(timingfd);
+			else if (!dirty) {
+				dirty = 1;
+				if (flush_interval && !last_flush)
+					last_flush = now_msec(&tv);
+			}
 		}
-		if (fflg)
-			fflush(fscript);
-	} while(1);
+	}
 
-	if (flgs)
+	/* ..child is dead, but it doesn't mean that there is nothing in
+	 * buffers. */
+	flgs = fcntl(master, F_GETFL, 0);
+	if (flgs != -1 && fcntl(master, F_SETFL, flgs | O_NONBLOCK) == 0) {
+		while (copy_output(buf, SCRIPT_BUFSIZ, timingfd, &oldtime) > 0)
+			;
 		fcntl(master, F_SETFL, flgs);
-	if (close_stream(timingfd) != 0)
+	}
+
+	/* the pty has been closed, wait for the shell to get its status */
+	if (!die && waitpid(child, &childstatus, 0) == child)
+		die = 1;
+
+	sigprocmask(SIG_SETMASK, &unblock_mask, NULL);
+	free(buf);
+
+	/* stderr is closed by close_stdout() at exit */
+	if (timingfd != stderr && close_stream(timingfd) != 0)
 		errx(EXIT_FAILURE, _("write error"));
 	done();
 }
@@ -473,27 +569,28 @@ void __attribute__((__noreturn__))
 done(void) {
 	time_t tvec;
 
-	if (subchild) {
-		if (!qflg) {
-			char buf[BUFSIZ];
-			tvec = time((time_t *)NULL);
-			my_strftime(buf, sizeof buf, "%c\n", localtime(&tvec));
-			fprintf(fscript, _("\nScript done on %s"), buf);
-		}
-		if (close_stream(fscript) != 0)
-			errx(EXIT_FAILURE, _("write error"));
-		close(master);
-
-		master = -1;
-	} else {
-		tcsetattr(STDIN_FILENO, TCSADRAIN, &tt);
-		if (!qflg)
-			printf(_("Script done, file is %s\n"), fname);
+	if (child == 0)
+		/* the shell process (failed exec) */
+		exit(EXIT_FAILURE);
+
+	if (!qflg) {
+		char buf[BUFSIZ];
+		tvec = time((time_t *)NULL);
+		my_strftime(buf, sizeof buf, "%c\n", localtime(&tvec));
+		fprintf(fscript, _("\nScript done on %s"), buf);
+	}
+	if (close_stream(fscript) != 0)
+		errx(EXIT_FAILURE, _("write error"));
+
+	tcsetattr(STDIN_FILENO, TCSADRAIN, &tt);
+	if (!qflg)
+		printf(_("Script done, file is %s\n"), fname);
 #ifdef HAVE_LIBUTEMPTER
-		if (master >= 0)
-			utempter_remove_record(master);
+	if (master >= 0)
+		utempter_remove_record(master);
 #endif
-	}
+	close(master);
+	master = -1;
 
 	if(eflg) {
 		if (WIFSIGNALED(childstatus))
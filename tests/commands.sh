@@ -6,6 +6,7 @@ TS_HELPER_SYSINFO="$top_builddir/test_sysinfo"
 TS_HELPER_PATHS="$top_builddir/test_pathnames"
 TS_HELPER_BYTESWAP="$top_builddir/test_byteswap"
 TS_HELPER_MD5="$top_builddir/test_md5"
+TS_HELPER_CRC32="$top_builddir/test_crc32"
 
 TS_HELPER_ISMOUNTED="$top_builddir/test_ismounted"
 TS_HELPER_STRUTILS="$top_builddir/test_strutils"
@@ -19,12 +20,14 @@ TS_HELPER_LIBMOUNT_LOCK="$top_builddir/test_mount_lock"
 TS_HELPER_LIBMOUNT_UPDATE="$top_builddir/test_mount_tab_update"
 TS_HELPER_LIBMOUNT_CONTEXT="$top_builddir/test_mount_context"
 TS_HELPER_LIBMOUNT_TABDIFF="$top_builddir/test_mount_tab_diff"
+TS_HELPER_LIBMOUNT_CACHE="$top_builddir/test_mount_cache"
 
 TS_HELPER_ISLOCAL="$top_builddir/test_islocal"
 TS_HELPER_LOGINDEFS="$top_builddir/test_logindefs"
 
 # TODO: use partx
 TS_HELPER_PARTITIONS="$top_builddir/sample-partitions"
+TS_HELPER_BLKID_BENCHMARK="$top_builddir/sample-benchmark"
 
 # paths to commands
 TS_CMD_MOUNT=${TS_CMD_MOUNT:-"$top_builddir/mount"}